@@ -122,6 +122,465 @@ int stress_set_cpu_affinity(const char *arg)
 	return 0;
 }
 
+#define SYS_CPU_PREFIX		"/sys/devices/system/cpu"
+
+/*
+ *  Instance placement policies for --pin
+ */
+typedef enum {
+	PIN_NONE = 0,		/* no placement, leave it to the scheduler */
+	PIN_COMPACT,		/* fill SMT siblings, cores then LLCs in turn */
+	PIN_SCATTER,		/* spread across nodes, LLCs, cores then SMT */
+	PIN_SMT_OFF,		/* one instance per core, skip SMT siblings */
+	PIN_LLC,		/* confine instances to an LLC domain each */
+	PIN_NUMA,		/* confine instances to a NUMA node each */
+} stress_pin_policy_t;
+
+typedef struct {
+	const char *name;		/* policy name */
+	const stress_pin_policy_t policy;
+} stress_pin_method_t;
+
+typedef struct {
+	int32_t cpu;		/* CPU number */
+	int32_t node;		/* NUMA node */
+	int32_t package;	/* physical package */
+	int32_t llc;		/* lowest CPU sharing the last level cache */
+	int32_t core;		/* lowest SMT sibling CPU of the core */
+	int32_t thread;		/* rank of the CPU in its core */
+	int32_t core_rank;	/* rank of the core in its LLC */
+	int32_t llc_rank;	/* rank of the LLC in its NUMA node */
+} stress_pin_cpu_t;
+
+static const stress_pin_method_t pin_methods[] = {
+	{ "compact",	PIN_COMPACT },
+	{ "scatter",	PIN_SCATTER },
+	{ "smt-off",	PIN_SMT_OFF },
+	{ "llc",	PIN_LLC },
+	{ "numa",	PIN_NUMA },
+};
+
+static stress_pin_policy_t pin_policy = PIN_NONE;
+static const char *pin_name;
+static cpu_set_t *pin_sets;	/* CPUs of each placement slot */
+static size_t pin_sets_num;
+
+/*
+ *  stress_set_pin()
+ *	set the instance placement policy
+ */
+int stress_set_pin(const char *arg)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(pin_methods); i++) {
+		if (!strcmp(pin_methods[i].name, arg)) {
+			pin_policy = pin_methods[i].policy;
+			pin_name = pin_methods[i].name;
+			return 0;
+		}
+	}
+
+	(void)fprintf(stderr, "pin must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(pin_methods); i++)
+		(void)fprintf(stderr, " %s", pin_methods[i].name);
+	(void)fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_pin_cpu_list()
+ *	parse a sysfs CPU list such as 0-3,8-11 into a CPU set
+ */
+static int stress_pin_cpu_list(const char *path, cpu_set_t *set)
+{
+	char buf[4096];
+	char *ptr = buf;
+
+	CPU_ZERO(set);
+	if (system_read(path, buf, sizeof(buf) - 1) < 0)
+		return -1;
+
+	while (*ptr) {
+		char *end;
+		long lo, hi;
+
+		lo = strtol(ptr, &end, 10);
+		if (end == ptr)
+			break;
+		hi = lo;
+		if (*end == '-') {
+			ptr = end + 1;
+			hi = strtol(ptr, &end, 10);
+			if (end == ptr)
+				break;
+		}
+		for (; lo <= hi; lo++) {
+			if ((lo >= 0) && (lo < CPU_SETSIZE))
+				CPU_SET((int)lo, set);
+		}
+		if (*end != ',')
+			break;
+		ptr = end + 1;
+	}
+	return CPU_COUNT(set) ? 0 : -1;
+}
+
+/*
+ *  stress_pin_cpu_first()
+ *	lowest CPU in a CPU set
+ */
+static int32_t stress_pin_cpu_first(const cpu_set_t *set)
+{
+	int32_t cpu;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, set))
+			return cpu;
+	}
+	return -1;
+}
+
+/*
+ *  stress_pin_read_int()
+ *	read an integer from a sysfs file, def if it can't be read
+ */
+static int32_t stress_pin_read_int(const char *path, const int32_t def)
+{
+	char buf[64];
+	int val;
+
+	if (system_read(path, buf, sizeof(buf) - 1) < 0)
+		return def;
+	if (sscanf(buf, "%d", &val) != 1)
+		return def;
+	return (int32_t)val;
+}
+
+/*
+ *  stress_pin_cpu_info()
+ *	gather the NUMA node, package, last level cache and
+ *	core that a CPU belongs to; if the topology is not
+ *	available each CPU is treated as a core of its own
+ *	on node 0
+ */
+static void stress_pin_cpu_info(const int32_t cpu, stress_pin_cpu_t *info)
+{
+	char path[PATH_MAX];
+	cpu_set_t set;
+	DIR *dir;
+	struct dirent *entry;
+	int32_t i, llc_level = -1;
+
+	info->cpu = cpu;
+	info->node = 0;
+	info->core = cpu;
+
+	(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32
+		"/topology/physical_package_id", SYS_CPU_PREFIX, cpu);
+	info->package = stress_pin_read_int(path, 0);
+	info->llc = info->package;
+
+	(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32
+		"/topology/thread_siblings_list", SYS_CPU_PREFIX, cpu);
+	if (stress_pin_cpu_list(path, &set) == 0)
+		info->core = stress_pin_cpu_first(&set);
+
+	/* The cache index with the highest level is the LLC */
+	for (i = 0; i < 16; i++) {
+		int32_t level;
+
+		(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32
+			"/cache/index%" PRId32 "/level", SYS_CPU_PREFIX, cpu, i);
+		level = stress_pin_read_int(path, -1);
+		if (level <= llc_level)
+			continue;
+		(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32
+			"/cache/index%" PRId32 "/shared_cpu_list",
+			SYS_CPU_PREFIX, cpu, i);
+		if (stress_pin_cpu_list(path, &set) == 0) {
+			info->llc = stress_pin_cpu_first(&set);
+			llc_level = level;
+		}
+	}
+
+	(void)snprintf(path, sizeof(path), "%s/cpu%" PRId32, SYS_CPU_PREFIX, cpu);
+	dir = opendir(path);
+	if (!dir)
+		return;
+	while ((entry = readdir(dir)) != NULL) {
+		int node;
+
+		if (sscanf(entry->d_name, "node%d", &node) == 1) {
+			info->node = (int32_t)node;
+			break;
+		}
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  stress_pin_rank()
+ *	rank the SMT threads within each core, the cores within
+ *	each LLC and the LLCs within each NUMA node. Ranks are
+ *	over the CPUs that stress-ng is allowed to run on so
+ *	that --taskset restricted runs are placed sensibly.
+ */
+static void stress_pin_rank(stress_pin_cpu_t *cpus, const size_t n)
+{
+	size_t i, j;
+
+	for (i = 0; i < n; i++) {
+		cpus[i].thread = 0;
+		for (j = 0; j < n; j++) {
+			if ((cpus[j].core == cpus[i].core) &&
+			    (cpus[j].cpu < cpus[i].cpu))
+				cpus[i].thread++;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		cpus[i].core_rank = 0;
+		for (j = 0; j < n; j++) {
+			if ((cpus[j].thread == 0) &&
+			    (cpus[j].node == cpus[i].node) &&
+			    (cpus[j].llc == cpus[i].llc) &&
+			    (cpus[j].core < cpus[i].core))
+				cpus[i].core_rank++;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		cpus[i].llc_rank = 0;
+		for (j = 0; j < n; j++) {
+			if ((cpus[j].thread == 0) &&
+			    (cpus[j].core_rank == 0) &&
+			    (cpus[j].node == cpus[i].node) &&
+			    (cpus[j].llc < cpus[i].llc))
+				cpus[i].llc_rank++;
+		}
+	}
+}
+
+/*
+ *  stress_pin_cmp_compact()
+ *	order CPUs so that neighbouring CPUs share as much
+ *	of the topology as possible
+ */
+static int stress_pin_cmp_compact(const void *p1, const void *p2)
+{
+	const stress_pin_cpu_t *c1 = (const stress_pin_cpu_t *)p1;
+	const stress_pin_cpu_t *c2 = (const stress_pin_cpu_t *)p2;
+
+	if (c1->node != c2->node)
+		return c1->node - c2->node;
+	if (c1->package != c2->package)
+		return c1->package - c2->package;
+	if (c1->llc != c2->llc)
+		return c1->llc - c2->llc;
+	if (c1->core != c2->core)
+		return c1->core - c2->core;
+	return c1->cpu - c2->cpu;
+}
+
+/*
+ *  stress_pin_cmp_scatter()
+ *	order CPUs so that neighbouring CPUs share as little
+ *	of the topology as possible
+ */
+static int stress_pin_cmp_scatter(const void *p1, const void *p2)
+{
+	const stress_pin_cpu_t *c1 = (const stress_pin_cpu_t *)p1;
+	const stress_pin_cpu_t *c2 = (const stress_pin_cpu_t *)p2;
+
+	if (c1->thread != c2->thread)
+		return c1->thread - c2->thread;
+	if (c1->core_rank != c2->core_rank)
+		return c1->core_rank - c2->core_rank;
+	if (c1->llc_rank != c2->llc_rank)
+		return c1->llc_rank - c2->llc_rank;
+	if (c1->node != c2->node)
+		return c1->node - c2->node;
+	return c1->cpu - c2->cpu;
+}
+
+/*
+ *  stress_pin_slot()
+ *	return true if a CPU starts a new placement slot
+ */
+static bool stress_pin_slot(const stress_pin_cpu_t *c)
+{
+	switch (pin_policy) {
+	case PIN_SMT_OFF:
+		return c->thread == 0;
+	case PIN_LLC:
+		return (c->thread == 0) && (c->core_rank == 0);
+	case PIN_NUMA:
+		return (c->thread == 0) && (c->core_rank == 0) &&
+		       (c->llc_rank == 0);
+	default:
+		break;
+	}
+	return true;
+}
+
+/*
+ *  stress_pin_same_slot()
+ *	return true if CPU c2 belongs to the slot started by CPU c1
+ */
+static bool stress_pin_same_slot(const stress_pin_cpu_t *c1, const stress_pin_cpu_t *c2)
+{
+	switch (pin_policy) {
+	case PIN_LLC:
+		return (c1->node == c2->node) && (c1->llc == c2->llc);
+	case PIN_NUMA:
+		return c1->node == c2->node;
+	default:
+		break;
+	}
+	return c1->cpu == c2->cpu;
+}
+
+/*
+ *  stress_pin_set_str()
+ *	turn a CPU set into a CPU list string such as 0-3,8
+ */
+static void stress_pin_set_str(const cpu_set_t *set, char *buf, const size_t len)
+{
+	int32_t cpu;
+	size_t n = 0;
+
+	*buf = '\0';
+	for (cpu = 0; (cpu < CPU_SETSIZE) && (n < len); cpu++) {
+		int32_t last = cpu;
+		int ret;
+
+		if (!CPU_ISSET(cpu, set))
+			continue;
+		while ((last + 1 < CPU_SETSIZE) && CPU_ISSET(last + 1, set))
+			last++;
+		if (last == cpu)
+			ret = snprintf(buf + n, len - n, "%s%" PRId32,
+				n ? "," : "", cpu);
+		else
+			ret = snprintf(buf + n, len - n, "%s%" PRId32 "-%" PRId32,
+				n ? "," : "", cpu, last);
+		if (ret < 0)
+			break;
+		n += (size_t)ret;
+		cpu = last;
+	}
+}
+
+/*
+ *  stress_pin_init()
+ *	work out the placement slots of the --pin policy from the
+ *	CPU topology, instance j of each stressor is later pinned
+ *	to slot j modulo the number of slots
+ */
+int stress_pin_init(void)
+{
+	cpu_set_t allowed;
+	stress_pin_cpu_t *cpus;
+	size_t i, j, n = 0, count;
+	int32_t cpu;
+
+	if (pin_policy == PIN_NONE)
+		return 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf("pin: cannot get CPU affinity, errno=%d (%s), "
+			"instance placement disabled\n",
+			errno, strerror(errno));
+		return -1;
+	}
+	count = (size_t)CPU_COUNT(&allowed);
+	if (!count)
+		return -1;
+
+	cpus = calloc(count, sizeof(*cpus));
+	if (!cpus) {
+		pr_inf("pin: cannot allocate CPU topology, "
+			"instance placement disabled\n");
+		return -1;
+	}
+	pin_sets = calloc(count, sizeof(*pin_sets));
+	if (!pin_sets) {
+		pr_inf("pin: cannot allocate CPU placement slots, "
+			"instance placement disabled\n");
+		free(cpus);
+		return -1;
+	}
+
+	for (cpu = 0; (cpu < CPU_SETSIZE) && (n < count); cpu++) {
+		if (CPU_ISSET(cpu, &allowed))
+			stress_pin_cpu_info(cpu, &cpus[n++]);
+	}
+	stress_pin_rank(cpus, n);
+	qsort(cpus, n, sizeof(*cpus),
+		((pin_policy == PIN_COMPACT) || (pin_policy == PIN_SMT_OFF)) ?
+		stress_pin_cmp_compact : stress_pin_cmp_scatter);
+
+	for (pin_sets_num = 0, i = 0; i < n; i++) {
+		cpu_set_t *set = &pin_sets[pin_sets_num];
+
+		if (!stress_pin_slot(&cpus[i]))
+			continue;
+		CPU_ZERO(set);
+		for (j = 0; j < n; j++) {
+			if (stress_pin_same_slot(&cpus[i], &cpus[j]))
+				CPU_SET(cpus[j].cpu, set);
+		}
+		pin_sets_num++;
+	}
+	free(cpus);
+
+	pr_inf("pin: %s placement over %zu CPU%s in %zu slot%s\n",
+		pin_name, n, n == 1 ? "" : "s",
+		pin_sets_num, pin_sets_num == 1 ? "" : "s");
+	for (i = 0; i < pin_sets_num; i++) {
+		char buf[256];
+
+		stress_pin_set_str(&pin_sets[i], buf, sizeof(buf));
+		pr_dbg("pin: slot %zu: CPU %s\n", i, buf);
+	}
+	return 0;
+}
+
+/*
+ *  stress_pin_instance()
+ *	pin the calling stressor instance to its placement slot
+ */
+void stress_pin_instance(const char *name, const uint32_t instance)
+{
+	const cpu_set_t *set;
+	char buf[256];
+
+	if (!pin_sets_num)
+		return;
+
+	set = &pin_sets[instance % pin_sets_num];
+	stress_pin_set_str(set, buf, sizeof(buf));
+	if (sched_setaffinity(0, sizeof(*set), set) < 0) {
+		pr_dbg("%s: cannot pin instance %" PRIu32 " to CPU %s, "
+			"errno=%d (%s)\n", name, instance, buf,
+			errno, strerror(errno));
+		return;
+	}
+	pr_dbg("%s: pinned instance %" PRIu32 " to CPU %s\n",
+		name, instance, buf);
+}
+
+/*
+ *  stress_pin_free()
+ *	free the placement slots
+ */
+void stress_pin_free(void)
+{
+	free(pin_sets);
+	pin_sets = NULL;
+	pin_sets_num = 0;
+}
+
 #else
 int stress_set_cpu_affinity(const char *arg)
 {
@@ -130,4 +589,27 @@ int stress_set_cpu_affinity(const char *arg)
 	(void)fprintf(stderr, "%s: setting CPU affinity not supported\n", option);
 	_exit(EXIT_FAILURE);
 }
+
+int stress_set_pin(const char *arg)
+{
+	(void)arg;
+
+	(void)fprintf(stderr, "pin: setting CPU affinity not supported\n");
+	_exit(EXIT_FAILURE);
+}
+
+int stress_pin_init(void)
+{
+	return 0;
+}
+
+void stress_pin_instance(const char *name, const uint32_t instance)
+{
+	(void)name;
+	(void)instance;
+}
+
+void stress_pin_free(void)
+{
+}
 #endif
@@ -0,0 +1,508 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define CGROUP_RMDIR_RETRIES	(50)
+
+/* How a cgroup statistic is accumulated over repeated runs */
+#define CGROUP_SUM		(0)
+#define CGROUP_MAX		(1)
+
+/* A cgroup statistic read back at the end of each run */
+typedef struct {
+	const char *file;		/* cgroup file */
+	const char *key;		/* key in the file, NULL for a single value */
+	const char *label;		/* report label */
+	double scale;			/* scale to report units */
+	int mode;			/* CGROUP_SUM or CGROUP_MAX */
+} stress_cgroup_stat_t;
+
+static const stress_cgroup_stat_t cgroup_stats[] = {
+	{ "cpu.stat",	    "usage_usec",     "cpu-usage-seconds",	1.0E-6,	CGROUP_SUM },
+	{ "cpu.stat",	    "user_usec",      "cpu-user-seconds",	1.0E-6,	CGROUP_SUM },
+	{ "cpu.stat",	    "system_usec",    "cpu-system-seconds",	1.0E-6,	CGROUP_SUM },
+	{ "cpu.stat",	    "nr_periods",     "cpu-periods",		1.0,	CGROUP_SUM },
+	{ "cpu.stat",	    "nr_throttled",   "cpu-throttled-periods",	1.0,	CGROUP_SUM },
+	{ "cpu.stat",	    "throttled_usec", "cpu-throttled-seconds",	1.0E-6,	CGROUP_SUM },
+	{ "memory.peak",    NULL,	      "memory-peak-bytes",	1.0,	CGROUP_MAX },
+	{ "memory.stat",    "pgfault",	      "memory-page-faults",	1.0,	CGROUP_SUM },
+	{ "memory.stat",    "pgmajfault",     "memory-major-page-faults", 1.0, CGROUP_SUM },
+	{ "memory.stat",    "pgscan",	      "memory-pages-scanned",	1.0,	CGROUP_SUM },
+	{ "memory.stat",    "pgsteal",	      "memory-pages-reclaimed",	1.0,	CGROUP_SUM },
+	{ "memory.events",  "low",	      "memory-events-low",	1.0,	CGROUP_SUM },
+	{ "memory.events",  "high",	      "memory-events-high",	1.0,	CGROUP_SUM },
+	{ "memory.events",  "max",	      "memory-events-max",	1.0,	CGROUP_SUM },
+	{ "memory.events",  "oom",	      "memory-events-oom",	1.0,	CGROUP_SUM },
+	{ "memory.events",  "oom_kill",	      "memory-events-oom-kill",	1.0,	CGROUP_SUM },
+	{ "io.stat",	    "rbytes",	      "io-read-bytes",		1.0,	CGROUP_SUM },
+	{ "io.stat",	    "wbytes",	      "io-write-bytes",		1.0,	CGROUP_SUM },
+	{ "io.stat",	    "rios",	      "io-reads",		1.0,	CGROUP_SUM },
+	{ "io.stat",	    "wios",	      "io-writes",		1.0,	CGROUP_SUM },
+};
+
+/* The cgroup of a stressor and its statistics over all of its runs */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	char path[PATH_MAX - 64];	/* cgroup directory */
+	bool created;			/* cgroup exists for the current run */
+	bool seen[SIZEOF_ARRAY(cgroup_stats)];	/* statistic was read */
+	double stats[SIZEOF_ARRAY(cgroup_stats)]; /* statistics */
+} stress_cgroup_t;
+
+static const char * const cgroup_controllers[] = {
+	"cpu", "cpuset", "io", "memory",
+};
+
+static stress_cgroup_t *cgroups;
+static size_t cgroups_num;
+
+/*
+ *  stress_cgroup_write()
+ *	write a string to a cgroup file, returns -1 and
+ *	sets errno on failure
+ */
+static int stress_cgroup_write(const char *dir, const char *file, const char *str)
+{
+	char path[PATH_MAX];
+	int ret;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	ret = system_write(path, str, strlen(str));
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cgroup_commas()
+ *	copy a limit option into buf, turning the commas that
+ *	separate the fields into the spaces the kernel expects
+ */
+static void stress_cgroup_commas(char *buf, const size_t len, const char *str)
+{
+	char *ptr;
+
+	(void)shim_strlcpy(buf, str, len);
+	for (ptr = buf; *ptr; ptr++) {
+		if (*ptr == ',')
+			*ptr = ' ';
+	}
+}
+
+/*
+ *  stress_set_cgroup_cpu_max()
+ *	set the cpu.max limit, "max", "QUOTA" or "QUOTA,PERIOD"
+ *	in microseconds
+ */
+int stress_set_cgroup_cpu_max(const char *arg)
+{
+	uint64_t quota, period = 100000;
+	int n;
+
+	if (strcmp(arg, "max")) {
+		n = sscanf(arg, "%" SCNu64 ",%" SCNu64, &quota, &period);
+		if ((n < 1) || (quota < 1000) ||
+		    (period < 1000) || (period > 1000000)) {
+			(void)fprintf(stderr, "cgroup-cpu-max must be max, QUOTA or "
+				"QUOTA,PERIOD in microseconds, the quota must be "
+				"at least 1000 and the period 1000 to 1000000\n");
+			return -1;
+		}
+	}
+	return stress_set_setting("cgroup-cpu-max", TYPE_ID_STR, arg);
+}
+
+/*
+ *  stress_set_cgroup_io_max()
+ *	set the io.max limit, MAJ:MIN,KEY=VALUE[,KEY=VALUE..]
+ */
+int stress_set_cgroup_io_max(const char *arg)
+{
+	unsigned int major, minor;
+	int n = 0;
+
+	if ((sscanf(arg, "%u:%u%n", &major, &minor, &n) != 2) ||
+	    (arg[n] != ',') || !strchr(arg + n, '=')) {
+		(void)fprintf(stderr, "cgroup-io-max must be MAJ:MIN,KEY=VALUE,.. "
+			"where KEY is rbps, wbps, riops or wiops\n");
+		return -1;
+	}
+	return stress_set_setting("cgroup-io-max", TYPE_ID_STR, arg);
+}
+
+/*
+ *  stress_cgroup_init()
+ *	check the --cgroup parent is a cgroup v2 directory and
+ *	enable the controllers for the stressor cgroups in it,
+ *	returns -1 if it cannot be used
+ */
+int stress_cgroup_init(void)
+{
+	char *parent = NULL, path[PATH_MAX], buf[256];
+	size_t i;
+
+	if (!stress_get_setting("cgroup", &parent))
+		return 0;
+
+	(void)snprintf(path, sizeof(path), "%s/cgroup.controllers", parent);
+	if (system_read(path, buf, sizeof(buf)) < 0) {
+		pr_err("cgroup: %s is not a cgroup v2 directory\n", parent);
+		return -1;
+	}
+	for (i = 0; i < SIZEOF_ARRAY(cgroup_controllers); i++) {
+		char ctrl[32];
+
+		(void)snprintf(ctrl, sizeof(ctrl), "+%s", cgroup_controllers[i]);
+		if (stress_cgroup_write(parent, "cgroup.subtree_control", ctrl) < 0)
+			pr_dbg("cgroup: cannot enable %s controller in %s, errno=%d (%s)\n",
+				cgroup_controllers[i], parent, errno, strerror(errno));
+	}
+	return 0;
+}
+
+/*
+ *  stress_cgroup_limits()
+ *	apply the limits of the current stressor to a cgroup
+ */
+static int stress_cgroup_limits(const char *dir)
+{
+	char *cpu_max = NULL, *io_max = NULL, *cpuset = NULL;
+	uint64_t memory_max = 0, memory_high = 0;
+	char buf[256];
+
+	if (stress_get_setting("cgroup-cpuset", &cpuset) &&
+	    (stress_cgroup_write(dir, "cpuset.cpus", cpuset) < 0))
+		goto err;
+	if (stress_get_setting("cgroup-cpu-max", &cpu_max)) {
+		stress_cgroup_commas(buf, sizeof(buf), cpu_max);
+		if (stress_cgroup_write(dir, "cpu.max", buf) < 0)
+			goto err;
+	}
+	if (stress_get_setting("cgroup-memory-high", &memory_high)) {
+		(void)snprintf(buf, sizeof(buf), "%" PRIu64, memory_high);
+		if (stress_cgroup_write(dir, "memory.high", buf) < 0)
+			goto err;
+	}
+	if (stress_get_setting("cgroup-memory-max", &memory_max)) {
+		(void)snprintf(buf, sizeof(buf), "%" PRIu64, memory_max);
+		if (stress_cgroup_write(dir, "memory.max", buf) < 0)
+			goto err;
+	}
+	if (stress_get_setting("cgroup-io-max", &io_max)) {
+		stress_cgroup_commas(buf, sizeof(buf), io_max);
+		if (stress_cgroup_write(dir, "io.max", buf) < 0)
+			goto err;
+	}
+	return 0;
+err:
+	pr_err("cgroup: cannot set limits of %s, errno=%d (%s)\n",
+		dir, errno, strerror(errno));
+	return -1;
+}
+
+/*
+ *  stress_cgroup_find()
+ *	find the cgroup of a stressor, NULL if there is none
+ */
+static stress_cgroup_t *stress_cgroup_find(const stress_stressor_t *ss)
+{
+	size_t i;
+
+	for (i = 0; i < cgroups_num; i++) {
+		if (cgroups[i].ss == ss)
+			return &cgroups[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_cgroup_rmdir()
+ *	remove a cgroup, the reaped tasks may take a short
+ *	while to leave the cgroup
+ */
+static void stress_cgroup_rmdir(const char *path)
+{
+	int i;
+
+	for (i = 0; i < CGROUP_RMDIR_RETRIES; i++) {
+		if ((rmdir(path) == 0) || (errno == ENOENT))
+			return;
+		if (errno != EBUSY)
+			break;
+		(void)shim_usleep(10000);
+	}
+	pr_dbg("cgroup: cannot remove %s, errno=%d (%s)\n",
+		path, errno, strerror(errno));
+}
+
+/*
+ *  stress_cgroup_create()
+ *	create the cgroups of the stressors in stressors_list under
+ *	the --cgroup parent, the stressor limits are applied to them
+ *	unless each instance has its own cgroup, returns -1 and
+ *	removes the cgroups on failure
+ */
+int stress_cgroup_create(stress_stressor_t *stressors_list)
+{
+	char *parent = NULL;
+	stress_stressor_t *ss;
+
+	if (!stress_get_setting("cgroup", &parent))
+		return 0;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = stress_cgroup_find(ss);
+		size_t i;
+
+		if (!cg) {
+			cg = realloc(cgroups, (cgroups_num + 1) * sizeof(*cgroups));
+			if (!cg) {
+				pr_err("cannot allocate cgroup data\n");
+				goto err;
+			}
+			cgroups = cg;
+			cg = &cgroups[cgroups_num++];
+			(void)memset(cg, 0, sizeof(*cg));
+			cg->ss = ss;
+			(void)snprintf(cg->path, sizeof(cg->path), "%s/%s-%d-%s",
+				parent, g_app_name, (int)getpid(),
+				stress_munge_underscore(ss->stressor->name));
+		}
+
+		if ((mkdir(cg->path, S_IRWXU) < 0) && (errno != EEXIST)) {
+			pr_err("cgroup: cannot create %s, errno=%d (%s)\n",
+				cg->path, errno, strerror(errno));
+			goto err;
+		}
+		cg->created = true;
+
+		if (g_opt_flags & OPT_FLAGS_CGROUP_INSTANCE) {
+			for (i = 0; i < SIZEOF_ARRAY(cgroup_controllers); i++) {
+				char ctrl[32];
+
+				(void)snprintf(ctrl, sizeof(ctrl), "+%s", cgroup_controllers[i]);
+				(void)stress_cgroup_write(cg->path, "cgroup.subtree_control", ctrl);
+			}
+			continue;
+		}
+		g_stressor_current = ss;
+		if (stress_cgroup_limits(cg->path) < 0)
+			goto err;
+	}
+	return 0;
+err:
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = stress_cgroup_find(ss);
+
+		if (cg && cg->created) {
+			stress_cgroup_rmdir(cg->path);
+			cg->created = false;
+		}
+	}
+	return -1;
+}
+
+/*
+ *  stress_cgroup_join()
+ *	move the calling stressor instance into its cgroup, with
+ *	--cgroup-per-instance into a child cgroup with the limits
+ *	of the stressor, returns -1 on failure
+ */
+int stress_cgroup_join(const stress_stressor_t *ss, const int32_t instance)
+{
+	const stress_cgroup_t *cg = stress_cgroup_find(ss);
+	char path[PATH_MAX];
+
+	if (!cg || !cg->created)
+		return 0;
+
+	(void)shim_strlcpy(path, cg->path, sizeof(path));
+	if (g_opt_flags & OPT_FLAGS_CGROUP_INSTANCE) {
+		(void)snprintf(path, sizeof(path), "%s/instance-%" PRId32,
+			cg->path, instance);
+		if ((mkdir(path, S_IRWXU) < 0) && (errno != EEXIST)) {
+			pr_err("cgroup: cannot create %s, errno=%d (%s)\n",
+				path, errno, strerror(errno));
+			return -1;
+		}
+		if (stress_cgroup_limits(path) < 0)
+			return -1;
+	}
+	if (stress_cgroup_write(path, "cgroup.procs", "0") < 0) {
+		pr_err("cgroup: cannot move process into %s, errno=%d (%s)\n",
+			path, errno, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cgroup_read()
+ *	read a cgroup statistic, io.stat has a line of
+ *	key=value pairs per device that are totalled
+ */
+static bool stress_cgroup_read(
+	const char *dir,
+	const stress_cgroup_stat_t *stat,
+	uint64_t *value)
+{
+	FILE *fp;
+	char path[PATH_MAX], buf[512];
+	const size_t key_len = stat->key ? strlen(stat->key) : 0;
+	bool found = false;
+
+	*value = 0;
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, stat->file);
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *ptr;
+		uint64_t val;
+
+		if (!stat->key) {
+			found = (sscanf(buf, "%" SCNu64, value) == 1);
+			break;
+		}
+		for (ptr = buf; ptr; ptr = strpbrk(ptr, " \t")) {
+			while ((*ptr == ' ') || (*ptr == '\t'))
+				ptr++;
+			if (strncmp(ptr, stat->key, key_len) ||
+			    ((ptr[key_len] != ' ') && (ptr[key_len] != '=')))
+				continue;
+			if (sscanf(ptr + key_len + 1, "%" SCNu64, &val) == 1) {
+				*value += val;
+				found = true;
+			}
+		}
+	}
+	(void)fclose(fp);
+
+	return found;
+}
+
+/*
+ *  stress_cgroup_collect()
+ *	read back the statistics of the cgroups of the stressors
+ *	at the end of a run and remove the cgroups
+ */
+void stress_cgroup_collect(stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_cgroup_t *cg = stress_cgroup_find(ss);
+		int32_t j;
+		size_t i;
+
+		if (!cg || !cg->created)
+			continue;
+
+		for (i = 0; i < SIZEOF_ARRAY(cgroup_stats); i++) {
+			const stress_cgroup_stat_t *stat = &cgroup_stats[i];
+			uint64_t value;
+			double val;
+
+			if (!stress_cgroup_read(cg->path, stat, &value))
+				continue;
+			val = (double)value * stat->scale;
+			if (stat->mode == CGROUP_MAX)
+				cg->stats[i] = (val > cg->stats[i]) ? val : cg->stats[i];
+			else
+				cg->stats[i] += val;
+			cg->seen[i] = true;
+		}
+
+		if (g_opt_flags & OPT_FLAGS_CGROUP_INSTANCE) {
+			for (j = 0; j < ss->num_instances; j++) {
+				char path[PATH_MAX];
+
+				(void)snprintf(path, sizeof(path), "%s/instance-%" PRId32,
+					cg->path, j);
+				stress_cgroup_rmdir(path);
+			}
+		}
+		stress_cgroup_rmdir(cg->path);
+		cg->created = false;
+	}
+}
+
+/*
+ *  stress_cgroup_dump()
+ *	report the cgroup statistics of each stressor
+ */
+void stress_cgroup_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_cgroup_t *cg = stress_cgroup_find(ss);
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		bool seen = false;
+		size_t i;
+
+		if (!cg)
+			continue;
+		for (i = 0; i < SIZEOF_ARRAY(cgroup_stats); i++)
+			seen |= cg->seen[i];
+		if (!seen)
+			continue;
+		if (!heading) {
+			pr_inf("%-13s %-28s %16s\n", "stressor", "cgroup statistic", "value");
+			stress_report_list(yaml, "cgroup");
+			heading = true;
+		}
+		stress_report_item(yaml, "stressor", munged);
+		for (i = 0; i < SIZEOF_ARRAY(cgroup_stats); i++) {
+			if (!cg->seen[i])
+				continue;
+			pr_inf("%-13s %-28s %16.*f\n", munged, cgroup_stats[i].label,
+				cgroup_stats[i].scale < 1.0 ? 2 : 0, cg->stats[i]);
+			stress_report_double(yaml, cgroup_stats[i].label, cg->stats[i]);
+		}
+	}
+	if (heading)
+		stress_report_end(yaml);
+}
+
+/*
+ *  stress_cgroup_free()
+ *	remove any cgroups left behind by an aborted run
+ *	and free the cgroup data
+ */
+void stress_cgroup_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < cgroups_num; i++) {
+		if (cgroups[i].created)
+			stress_cgroup_rmdir(cgroups[i].path);
+	}
+	free(cgroups);
+	cgroups = NULL;
+	cgroups_num = 0;
+}
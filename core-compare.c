@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define COMPARE_NAME_LEN	(64)
+
+/* Baseline throughput of a stressor */
+typedef struct {
+	char name[COMPARE_NAME_LEN];	/* munged stressor name */
+	double mean;			/* mean bogo ops per second */
+	double stddev;			/* sample standard deviation */
+	uint32_t n;			/* number of runs */
+} stress_compare_baseline_t;
+
+static stress_compare_baseline_t *baselines;
+static size_t baselines_num;
+static const char *baseline_filename;
+static double compare_threshold = 5.0;	/* percent */
+
+/*
+ *  stress_set_compare_threshold()
+ *	set the throughput regression threshold in percent
+ */
+int stress_set_compare_threshold(const char *arg)
+{
+	char *end;
+	const double threshold = strtod(arg, &end);
+
+	if ((end == arg) || (*end && strcmp(end, "%")) ||
+	    (threshold < 0.0) || (threshold > 100.0)) {
+		(void)fprintf(stderr, "compare-threshold must be a percentage "
+			"in the range 0 to 100\n");
+		return -1;
+	}
+	compare_threshold = threshold;
+
+	return 0;
+}
+
+/*
+ *  stress_compare_baseline()
+ *	find or add a baseline entry for a stressor
+ */
+static stress_compare_baseline_t *stress_compare_baseline(const char *name)
+{
+	stress_compare_baseline_t *baseline;
+	size_t i;
+
+	for (i = 0; i < baselines_num; i++) {
+		if (!strcmp(baselines[i].name, name))
+			return &baselines[i];
+	}
+	baseline = realloc(baselines, (baselines_num + 1) * sizeof(*baselines));
+	if (!baseline)
+		return NULL;
+	baselines = baseline;
+	baseline = &baselines[baselines_num++];
+	(void)memset(baseline, 0, sizeof(*baseline));
+	(void)shim_strlcpy(baseline->name, name, sizeof(baseline->name));
+
+	return baseline;
+}
+
+/*
+ *  stress_compare_load()
+ *	parse the per stressor throughput from a previous YAML
+ *	report, the repeat-statistics are used in preference to
+ *	the single run metrics when the baseline has them
+ */
+int stress_compare_load(const char *filename)
+{
+	FILE *fp;
+	char buf[4096];
+	char section[64] = "";
+	stress_compare_baseline_t *baseline = NULL;
+	bool repeat = false;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		(void)fprintf(stderr, "compare: cannot open baseline YAML "
+			"file '%s', errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return -1;
+	}
+	baseline_filename = filename;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		char name[COMPARE_NAME_LEN], key[64];
+		double val;
+
+		buf[strcspn(buf, "\n")] = '\0';
+
+		/* Top level keys start a new section */
+		if (isalpha((int)buf[0])) {
+			(void)sscanf(buf, "%63[^:]", section);
+			baseline = NULL;
+			continue;
+		}
+		repeat = !strcmp(section, "repeat-statistics");
+		if (strcmp(section, "metrics") && !repeat)
+			continue;
+
+		if (sscanf(buf, " - stressor: %63s", name) == 1) {
+			baseline = stress_compare_baseline(name);
+			if (!baseline) {
+				(void)fprintf(stderr, "compare: cannot allocate "
+					"baseline data\n");
+				(void)fclose(fp);
+				return -1;
+			}
+			continue;
+		}
+		if (!baseline || (sscanf(buf, " %63[^:]: %lf", key, &val) != 2))
+			continue;
+
+		if (repeat) {
+			if (!strcmp(key, "runs"))
+				baseline->n = (uint32_t)val;
+			else if (!strcmp(key, "mean"))
+				baseline->mean = val;
+			else if (!strcmp(key, "stddev"))
+				baseline->stddev = val;
+		} else if (!strcmp(key, "bogo-ops-per-second-real-time") &&
+			   (baseline->n <= 1)) {
+			/* single run metrics, don't override repeat-statistics */
+			baseline->n = 1;
+			baseline->mean = val;
+			baseline->stddev = 0.0;
+		}
+	}
+	(void)fclose(fp);
+
+	if (!baselines_num) {
+		(void)fprintf(stderr, "compare: no stressor metrics found in "
+			"baseline YAML file '%s', was it generated with "
+			"--metrics and --yaml?\n", filename);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_compare_welch()
+ *	Welch's unequal variances t-test of two means, returns
+ *	true and the t statistic and Welch-Satterthwaite degrees
+ *	of freedom if there are enough runs to perform the test
+ */
+static bool stress_compare_welch(
+	const double mean1,
+	const double stddev1,
+	const uint32_t n1,
+	const double mean2,
+	const double stddev2,
+	const uint32_t n2,
+	double *t,
+	double *df)
+{
+	double v1, v2, se;
+
+	if ((n1 < 2) || (n2 < 2))
+		return false;
+
+	v1 = (stddev1 * stddev1) / (double)n1;
+	v2 = (stddev2 * stddev2) / (double)n2;
+	se = v1 + v2;
+	if (se <= 0.0)
+		return false;
+
+	*t = (mean2 - mean1) / sqrt(se);
+	*df = (se * se) /
+		(((v1 * v1) / (double)(n1 - 1)) + ((v2 * v2) / (double)(n2 - 1)));
+	return true;
+}
+
+/*
+ *  stress_compare_dump()
+ *	compare the throughput of each stressor against the
+ *	baseline, a stressor has regressed if it is slower by
+ *	more than the threshold and the difference is significant
+ *	at the 95% level. Stressors with fewer than two runs on
+ *	either side can't be tested for significance, these fall
+ *	back to the threshold check alone and are marked untested.
+ *	Returns false if any stressor regressed.
+ */
+bool stress_compare_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false, ok = true, untested = false;
+
+	if (!baselines_num)
+		return true;
+
+	pr_yaml(yaml, "comparison:\n");
+	pr_yaml(yaml, "      baseline: %s\n", baseline_filename);
+	pr_yaml(yaml, "      threshold-percent: %f\n", compare_threshold);
+	pr_yaml(yaml, "      stressors:\n");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		const stress_compare_baseline_t *baseline = NULL;
+		stress_repeat_stats_t stats;
+		double delta, t = 0.0, df = 0.0;
+		bool tested, significant, insufficient;
+		const char *result;
+		char t_str[32];
+		size_t i;
+
+		for (i = 0; i < baselines_num; i++) {
+			if (!strcmp(baselines[i].name, munged)) {
+				baseline = &baselines[i];
+				break;
+			}
+		}
+		if (!baseline || !ss->started_instances)
+			continue;
+
+		if (!stress_repeat_stats(ss, &stats)) {
+			stats.n = 1;
+			stats.mean = stress_repeat_rate(ss);
+			stats.stddev = 0.0;
+		}
+		delta = (baseline->mean > 0.0) ?
+			100.0 * (stats.mean - baseline->mean) / baseline->mean : 0.0;
+		insufficient = (baseline->n < 2) || (stats.n < 2);
+		tested = stress_compare_welch(baseline->mean, baseline->stddev,
+			baseline->n, stats.mean, stats.stddev, stats.n, &t, &df);
+		/*
+		 *  Too few runs or no variance at all, so only the
+		 *  threshold can be checked
+		 */
+		significant = !tested ||
+			(fabs(t) > stress_repeat_t_95((df < 1.0) ? 1 : (uint32_t)df));
+		if (insufficient)
+			untested = true;
+
+		if ((delta < -compare_threshold) && significant) {
+			result = "regressed";
+			ok = false;
+		} else if ((delta > compare_threshold) && significant) {
+			result = "improved";
+		} else {
+			result = "unchanged";
+		}
+
+		if (!heading) {
+			pr_inf("comparison with baseline %s (threshold %.2f%%):\n",
+				baseline_filename, compare_threshold);
+			pr_inf("%-13s %12s %12s %9s %8s %10s\n",
+				"stressor", "baseline", "bogo ops/s", "delta",
+				"t", "result");
+			heading = true;
+		}
+		if (tested)
+			(void)snprintf(t_str, sizeof(t_str), "%8.2f", t);
+		else if (insufficient)
+			(void)shim_strlcpy(t_str, "untested", sizeof(t_str));
+		else
+			(void)shim_strlcpy(t_str, "     n/a", sizeof(t_str));
+		pr_inf("%-13s %12.2f %12.2f %8.2f%% %s %10s\n",
+			munged, baseline->mean, stats.mean, delta, t_str, result);
+
+		pr_yaml(yaml, "        - stressor: %s\n", munged);
+		pr_yaml(yaml, "          baseline-mean: %f\n", baseline->mean);
+		pr_yaml(yaml, "          baseline-stddev: %f\n", baseline->stddev);
+		pr_yaml(yaml, "          baseline-runs: %" PRIu32 "\n", baseline->n);
+		pr_yaml(yaml, "          mean: %f\n", stats.mean);
+		pr_yaml(yaml, "          stddev: %f\n", stats.stddev);
+		pr_yaml(yaml, "          runs: %" PRIu32 "\n", stats.n);
+		pr_yaml(yaml, "          delta-percent: %f\n", delta);
+		if (tested) {
+			pr_yaml(yaml, "          welch-t: %f\n", t);
+			pr_yaml(yaml, "          degrees-of-freedom: %f\n", df);
+		}
+		pr_yaml(yaml, "          tested: %s\n",
+			insufficient ? "false" : "true");
+		pr_yaml(yaml, "          significant: %s\n",
+			tested ? (significant ? "true" : "false") : "unknown");
+		pr_yaml(yaml, "          result: %s\n", result);
+	}
+	pr_yaml(yaml, "\n");
+
+	if (!heading)
+		pr_inf("comparison: no stressors in common with baseline %s\n",
+			baseline_filename);
+	if (untested)
+		pr_inf("comparison: untested stressors have fewer than two runs "
+			"in the baseline or this run and are only checked against "
+			"the threshold, use --repeat to test the significance\n");
+	if (heading && !ok)
+		pr_fail("comparison: throughput regressed by more than "
+			"%.2f%% against baseline %s\n",
+			compare_threshold, baseline_filename);
+
+	return ok;
+}
+
+/*
+ *  stress_compare_free()
+ *	free the baseline data
+ */
+void stress_compare_free(void)
+{
+	free(baselines);
+	baselines = NULL;
+	baselines_num = 0;
+}
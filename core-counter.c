@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define COUNTER_CALIBRATE_LOOPS	(1000000)
+
+static double counter_update_ns;	/* cost of a shared counter update */
+static double counter_batch_ns;		/* cost of a batched counter inc */
+
+/*
+ *  stress_counter_batch_init()
+ *	initialize a locally batched bogo ops counter, when
+ *	--latency is enabled every op is flushed so that the
+ *	latency of each bogo op is recorded
+ */
+void stress_counter_batch_init(
+	const stress_args_t *args,
+	stress_counter_batch_t *batch)
+{
+	batch->pending = 0;
+	batch->batch = 1;
+	batch->flushes = 0;
+	batch->flush_time = stress_time_now();
+	(void)args;
+}
+
+/*
+ *  stress_counter_batch_flush()
+ *	add the pending batched bogo ops to the shared counter
+ *	and adjust the batch size so that the shared counter
+ *	is updated about every STRESS_COUNTER_BATCH_USEC usecs
+ */
+void stress_counter_batch_flush(
+	const stress_args_t *args,
+	stress_counter_batch_t *batch)
+{
+	const double now = stress_time_now();
+	const double usecs = (now - batch->flush_time) * 1000000.0;
+
+	if (batch->pending) {
+		add_counter(args, batch->pending);
+		batch->pending = 0;
+		batch->flushes++;
+		*args->counter_flushes = batch->flushes;
+	}
+	batch->flush_time = now;
+
+	if (UNLIKELY(args->latency != NULL))
+		return;
+	if ((usecs < (STRESS_COUNTER_BATCH_USEC / 2)) &&
+	    (batch->batch < STRESS_COUNTER_BATCH_MAX))
+		batch->batch <<= 1;
+	else if ((usecs > (STRESS_COUNTER_BATCH_USEC * 2)) &&
+		 (batch->batch > 1))
+		batch->batch >>= 1;
+}
+
+/*
+ *  stress_counter_overhead_calibrate()
+ *	measure the cost of a shared bogo ops counter update
+ *	and of a locally batched counter increment
+ */
+void stress_counter_overhead_calibrate(void)
+{
+	const size_t page_size = stress_get_pagesize();
+	stress_stats_t *stats;
+	stress_counter_batch_t batch;
+	double t;
+	int i;
+
+	stats = (stress_stats_t *)mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANON, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_inf("cannot mmap counter calibration page, errno=%d (%s)\n",
+			errno, strerror(errno));
+		return;
+	}
+
+	{
+		const stress_args_t args = {
+			.counter = &stats->counter,
+			.counter_ready = &stats->counter_ready,
+			.counter_flushes = &stats->counter_flushes,
+			.counter_updates = &stats->counter_updates,
+			.latency = NULL,
+			.name = "counter-calibrate",
+			.max_ops = 0,
+			.instance = 0,
+			.num_instances = 1,
+			.pid = getpid(),
+			.ppid = getppid(),
+			.page_size = page_size,
+			.mapped = &g_shared->mapped,
+		};
+
+		t = stress_time_now();
+		for (i = 0; i < COUNTER_CALIBRATE_LOOPS; i++)
+			inc_counter(&args);
+		counter_update_ns = (stress_time_now() - t) *
+			1000000000.0 / COUNTER_CALIBRATE_LOOPS;
+
+		stress_counter_batch_init(&args, &batch);
+		t = stress_time_now();
+		for (i = 0; i < COUNTER_CALIBRATE_LOOPS; i++)
+			inc_counter_batch(&args, &batch);
+		stress_counter_batch_flush(&args, &batch);
+		counter_batch_ns = (stress_time_now() - t) *
+			1000000000.0 / COUNTER_CALIBRATE_LOOPS;
+	}
+	(void)munmap((void *)stats, page_size);
+
+	pr_dbg("bogo ops counter update %.2f ns, batched counter increment %.2f ns\n",
+		counter_update_ns, counter_batch_ns);
+}
+
+/*
+ *  stress_counter_overhead_dump()
+ *	estimate the time each stressor spent updating the
+ *	bogo ops counters as a percentage of its run time,
+ *	add_counter() adds many bogo ops in one update so the
+ *	updates are counted rather than inferred from the ops
+ */
+void stress_counter_overhead_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+
+	pr_yaml(yaml, "counter-overhead:\n");
+	pr_inf("%-13s %12s %12s %12s\n",
+		"stressor", "bogo ops", "updates", "overhead %");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+		uint64_t ops = 0, updates = 0, batched_ops = 0;
+		double run_time = 0.0, overhead_ns, overhead;
+
+		if (!ss->started_instances)
+			continue;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+
+			ops += stats->counter;
+			updates += stats->counter_updates;
+			if (stats->counter_flushes)
+				batched_ops += stats->counter;
+			run_time += stats->finish - stats->start;
+		}
+		overhead_ns = ((double)updates * counter_update_ns) +
+			      ((double)batched_ops * counter_batch_ns);
+		overhead = (run_time > 0.0) ?
+			100.0 * overhead_ns / (run_time * 1000000000.0) : 0.0;
+
+		pr_inf("%-13s %12" PRIu64 " %12" PRIu64 " %12.4f\n",
+			stress_munge_underscore(ss->stressor->name),
+			ops, updates, overhead);
+		pr_yaml(yaml, "    - stressor: %s\n",
+			stress_munge_underscore(ss->stressor->name));
+		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", ops);
+		pr_yaml(yaml, "      counter-updates: %" PRIu64 "\n", updates);
+		pr_yaml(yaml, "      counter-update-ns: %f\n", counter_update_ns);
+		pr_yaml(yaml, "      batched-increment-ns: %f\n", counter_batch_ns);
+		pr_yaml(yaml, "      overhead-percent: %f\n", overhead);
+		pr_yaml(yaml, "\n");
+	}
+}
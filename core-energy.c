@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define ENERGY_ROOT_DEFAULT	"/sys/class/powercap"
+#define ENERGY_DOMAINS_MAX	(16)
+#define ENERGY_SAMPLE_PERIOD	(10.0)	/* seconds, well inside the wrap time */
+
+/* A powercap energy counter domain, e.g. intel-rapl:0 package-0 */
+typedef struct {
+	char label[64];			/* domain label, e.g. package-0-dram */
+	char path[PATH_MAX];		/* energy_uj counter path */
+	uint64_t max_range;		/* counter wraps after this many uJ */
+	uint64_t last;			/* last energy_uj counter reading */
+	double joules;			/* energy used since the run started */
+	bool subzone;			/* subzone of a top level zone */
+	bool total;			/* counted in the total energy */
+} stress_energy_domain_t;
+
+/* Energy used while a stressor was running, over all of its runs */
+typedef struct {
+	double joules[ENERGY_DOMAINS_MAX]; /* energy per domain */
+} stress_energy_result_t;
+
+static stress_energy_domain_t energy_domains[ENERGY_DOMAINS_MAX];
+static size_t energy_domains_num;
+static stress_results_t energy_results = {
+	"energy", "energy", sizeof(stress_energy_result_t), NULL, 0
+};
+static double energy_time_start;
+static double energy_time_next;
+static bool energy_running;
+
+/*
+ *  stress_energy_read()
+ *	read an energy_uj counter, false on failure
+ */
+static bool stress_energy_read(const char *path, uint64_t *val)
+{
+	char buf[64];
+
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	return sscanf(buf, "%" SCNu64, val) == 1;
+}
+
+/*
+ *  stress_energy_name()
+ *	read the name of a powercap zone, false on failure
+ */
+static bool stress_energy_name(
+	const char *root,
+	const char *zone,
+	char *name,
+	const size_t len)
+{
+	char path[PATH_MAX];
+
+	(void)snprintf(path, sizeof(path), "%s/%s/name", root, zone);
+	if (system_read(path, name, len) <= 0)
+		return false;
+	name[strcspn(name, "\n")] = '\0';
+	return *name != '\0';
+}
+
+/*
+ *  stress_energy_add_zone()
+ *	add a powercap zone that has an energy counter, subzones
+ *	such as intel-rapl:0:1 are labelled with the name of their
+ *	parent zone so that the domains of each package are unique
+ */
+static void stress_energy_add_zone(const char *root, const char *zone)
+{
+	stress_energy_domain_t *d = &energy_domains[energy_domains_num];
+	char name[32], parent_name[32], parent[PATH_MAX], path[PATH_MAX];
+	char *ptr;
+	size_t i;
+
+	if (!stress_energy_name(root, zone, name, sizeof(name)))
+		return;
+
+	/* zone:N is a top level zone, zone:N:M is a subzone of zone:N */
+	(void)shim_strlcpy(parent, zone, sizeof(parent));
+	ptr = strrchr(parent, ':');
+	if (ptr && (ptr != strchr(parent, ':'))) {
+		*ptr = '\0';
+		d->subzone = true;
+	} else {
+		d->subzone = false;
+	}
+
+	if (d->subzone && stress_energy_name(root, parent, parent_name, sizeof(parent_name)))
+		(void)snprintf(d->label, sizeof(d->label), "%s-%s", parent_name, name);
+	else
+		(void)shim_strlcpy(d->label, name, sizeof(d->label));
+
+	for (i = 0; i < energy_domains_num; i++) {
+		if (!strcmp(energy_domains[i].label, d->label))
+			return;
+	}
+
+	(void)snprintf(d->path, sizeof(d->path), "%s/%s/energy_uj", root, zone);
+	if (!stress_energy_read(d->path, &d->last)) {
+		pr_dbg("energy: cannot read %s, errno=%d (%s)\n",
+			d->path, errno, strerror(errno));
+		return;
+	}
+	(void)snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", root, zone);
+	if (!stress_energy_read(path, &d->max_range))
+		d->max_range = 0;
+
+	/*
+	 *  The package domains include the core and uncore energy,
+	 *  the dram domain is a subzone but is not included in the
+	 *  package energy, so the total is package + dram
+	 */
+	d->total = (!d->subzone && !strncmp(name, "package", 7)) ||
+		   !strcmp(name, "dram");
+	energy_domains_num++;
+}
+
+/*
+ *  stress_energy_init()
+ *	find the powercap energy counter domains for --energy,
+ *	returns -1 if there are none that can be read
+ */
+int stress_energy_init(void)
+{
+	struct dirent **namelist = NULL;
+	char *root = ENERGY_ROOT_DEFAULT;
+	int i, n;
+	size_t j;
+	bool total = false;
+
+	if (!(g_opt_flags & OPT_FLAGS_ENERGY))
+		return 0;
+
+	(void)stress_get_setting("energy-root", &root);
+	n = scandir(root, &namelist, NULL, alphasort);
+	for (i = 0; i < n; i++) {
+		const char *zone = namelist[i]->d_name;
+
+		/*
+		 *  The MMIO interface reports the same package
+		 *  counters as the MSR interface, skip it to
+		 *  avoid counting the energy twice
+		 */
+		if ((*zone != '.') && !strstr(zone, "-mmio") &&
+		    (energy_domains_num < ENERGY_DOMAINS_MAX))
+			stress_energy_add_zone(root, zone);
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	if (!energy_domains_num) {
+		pr_inf("energy: no readable powercap energy counters in %s\n", root);
+		return -1;
+	}
+
+	/* No package domains, so total all the top level domains */
+	for (j = 0; j < energy_domains_num; j++)
+		total |= energy_domains[j].total;
+	if (!total) {
+		for (j = 0; j < energy_domains_num; j++)
+			energy_domains[j].total = !energy_domains[j].subzone;
+	}
+	return 0;
+}
+
+/*
+ *  stress_energy_active()
+ *	true if energy is being measured
+ */
+bool stress_energy_active(void)
+{
+	return energy_running;
+}
+
+/*
+ *  stress_energy_sample()
+ *	accumulate the energy used since the last reading, handling
+ *	the wraparound of the counters at max_energy_range_uj
+ */
+static void stress_energy_sample(void)
+{
+	size_t i;
+
+	for (i = 0; i < energy_domains_num; i++) {
+		stress_energy_domain_t *d = &energy_domains[i];
+		uint64_t now, delta;
+
+		if (!stress_energy_read(d->path, &now))
+			continue;
+		if (now >= d->last)
+			delta = now - d->last;
+		else if (d->max_range >= d->last)
+			delta = (d->max_range - d->last) + now;
+		else
+			delta = 0;	/* unknown wrap point, drop sample */
+		d->joules += (double)delta / 1000000.0;
+		d->last = now;
+	}
+}
+
+/*
+ *  stress_energy_start()
+ *	start measuring the energy used by a run of stressors
+ */
+void stress_energy_start(void)
+{
+	size_t i;
+
+	if (!energy_domains_num)
+		return;
+
+	stress_energy_sample();
+	for (i = 0; i < energy_domains_num; i++)
+		energy_domains[i].joules = 0.0;
+	energy_time_start = stress_time_now();
+	energy_time_next = energy_time_start + ENERGY_SAMPLE_PERIOD;
+	energy_running = true;
+}
+
+/*
+ *  stress_energy_tick()
+ *	sample the counters often enough that they cannot
+ *	wrap more than once between readings
+ */
+void stress_energy_tick(const double now)
+{
+	if (!energy_running || (now < energy_time_next))
+		return;
+	stress_energy_sample();
+	energy_time_next += ENERGY_SAMPLE_PERIOD;
+	if (energy_time_next < now)
+		energy_time_next = now + ENERGY_SAMPLE_PERIOD;
+}
+
+/*
+ *  stress_energy_stop()
+ *	stop measuring and charge the energy used by the run to
+ *	each stressor in the run, stressors run in parallel all
+ *	share the same energy
+ */
+void stress_energy_stop(stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	if (!energy_running)
+		return;
+
+	stress_energy_sample();
+	energy_running = false;
+	if (!stress_results_charge(&energy_results, stressors_list,
+				   stress_time_now() - energy_time_start))
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_result_t *result =
+			stress_results_find(&energy_results, ss);
+		stress_energy_result_t *energy = result->data;
+		size_t i;
+
+		for (i = 0; i < energy_domains_num; i++)
+			energy->joules[i] += energy_domains[i].joules;
+	}
+}
+
+/*
+ *  stress_energy_dump()
+ *	report the energy, average power and bogo ops per
+ *	joule of each stressor for each energy domain
+ */
+void stress_energy_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		const stress_result_t *result =
+			stress_results_find(&energy_results, ss);
+		const stress_energy_result_t *energy;
+		double joules = 0.0;
+		size_t i;
+
+		if (!result || (result->duration <= 0.0))
+			continue;
+		energy = result->data;
+
+		if (!heading) {
+			pr_inf("%-13s %-20s %12s %10s %14s\n", "stressor",
+				"energy domain", "joules", "avg watts",
+				"bogo ops/J");
+			stress_report_list(yaml, "energy");
+			heading = true;
+		}
+		stress_results_report(yaml, result);
+		for (i = 0; i < energy_domains_num; i++) {
+			const double j = energy->joules[i];
+			char key[80];
+
+			pr_inf("%-13s %-20s %12.2f %10.2f %14.2f\n",
+				munged, energy_domains[i].label, j,
+				j / result->duration,
+				(j > 0.0) ? (double)result->ops / j : 0.0);
+			(void)snprintf(key, sizeof(key), "%.63s-joules", energy_domains[i].label);
+			stress_report_double(yaml, key, j);
+			(void)snprintf(key, sizeof(key), "%.63s-watts", energy_domains[i].label);
+			stress_report_double(yaml, key, j / result->duration);
+			if (energy_domains[i].total)
+				joules += j;
+		}
+		pr_inf("%-13s %-20s %12.2f %10.2f %14.2f\n",
+			munged, "total", joules, joules / result->duration,
+			(joules > 0.0) ? (double)result->ops / joules : 0.0);
+		stress_report_double(yaml, "joules", joules);
+		stress_report_double(yaml, "watts", joules / result->duration);
+		stress_report_double(yaml, "bogo-ops-per-joule",
+			(joules > 0.0) ? (double)result->ops / joules : 0.0);
+	}
+	if (!heading)
+		return;
+	stress_report_end(yaml);
+	stress_results_shared(&energy_results);
+}
+
+/*
+ *  stress_energy_free()
+ *	free energy results
+ */
+void stress_energy_free(void)
+{
+	stress_results_free(&energy_results, NULL);
+	energy_domains_num = 0;
+	energy_running = false;
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define EXPORT_PERIOD	(1.0)		/* rewrite period in seconds */
+
+static const char *export_path;		/* exported metrics file */
+static double export_start;		/* start time of the run */
+static double export_next;		/* time of next export */
+
+/*
+ *  bogo ops of the earlier runs of a stressor, so that the
+ *  exported counter keeps on rising over --repeat and
+ *  --scale-sweep runs that reset the instance counters
+ */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	uint64_t ops;			/* bogo ops of finished runs */
+	bool done;			/* current run included in ops */
+} stress_export_ops_t;
+
+static stress_export_ops_t *export_ops;
+static size_t export_ops_num;
+
+/*
+ *  stress_export_name()
+ *	turn text into a Prometheus metric name component
+ */
+static void stress_export_name(char *dst, const char *src, const size_t len)
+{
+	size_t i;
+
+	for (i = 0; *src && (i < len - 1); src++, i++)
+		dst[i] = isalnum((int)*src) ? (char)tolower((int)*src) : '_';
+	dst[i] = '\0';
+}
+
+/*
+ *  stress_export_label()
+ *	write a label value with the backslash, double quote
+ *	and line feed characters escaped
+ */
+static void stress_export_label(FILE *fp, const char *value)
+{
+	for (; *value; value++) {
+		if (*value == '\n')
+			(void)fputs("\\n", fp);
+		else if ((*value == '\\') || (*value == '"'))
+			(void)fprintf(fp, "\\%c", *value);
+		else
+			(void)fputc(*value, fp);
+	}
+}
+
+/*
+ *  stress_export_header()
+ *	write the HELP and TYPE lines of a metric
+ */
+static void stress_export_header(
+	FILE *fp,
+	const char *name,
+	const char *type,
+	const char *help)
+{
+	(void)fprintf(fp, "# HELP %s %s\n", name, help);
+	(void)fprintf(fp, "# TYPE %s %s\n", name, type);
+}
+
+/*
+ *  stress_export_sample()
+ *	write one sample of a metric for a stressor
+ */
+static void stress_export_sample(
+	FILE *fp,
+	const char *name,
+	const stress_stressor_t *ss,
+	const char *fmt,
+	...) FORMAT(printf, 4, 5);
+
+static void stress_export_sample(
+	FILE *fp,
+	const char *name,
+	const stress_stressor_t *ss,
+	const char *fmt,
+	...)
+{
+	va_list ap;
+
+	(void)fprintf(fp, "%s{stressor=\"", name);
+	stress_export_label(fp, stress_munge_underscore(ss->stressor->name));
+	(void)fputs("\"} ", fp);
+	va_start(ap, fmt);
+	(void)vfprintf(fp, fmt, ap);
+	va_end(ap);
+	(void)fputc('\n', fp);
+}
+
+/*
+ *  stress_export_ops_find()
+ *	find or add the bogo op totals of a stressor,
+ *	returns NULL if out of memory
+ */
+static stress_export_ops_t *stress_export_ops_find(const stress_stressor_t *ss)
+{
+	stress_export_ops_t *tmp;
+	size_t i;
+
+	for (i = 0; i < export_ops_num; i++) {
+		if (export_ops[i].ss == ss)
+			return &export_ops[i];
+	}
+	tmp = realloc(export_ops, (export_ops_num + 1) * sizeof(*export_ops));
+	if (!tmp)
+		return NULL;
+	export_ops = tmp;
+	tmp = &export_ops[export_ops_num++];
+	tmp->ss = ss;
+	tmp->ops = 0;
+	tmp->done = false;
+
+	return tmp;
+}
+
+/*
+ *  stress_export_run_ops()
+ *	bogo ops of the instances of the current run of a stressor
+ */
+static uint64_t stress_export_run_ops(const stress_stressor_t *ss)
+{
+	uint64_t ops = 0;
+	int32_t j;
+
+	for (j = 0; j < ss->started_instances; j++)
+		ops += ss->stats[j]->counter;
+
+	return ops;
+}
+
+/*
+ *  stress_export_stressors()
+ *	write the live per stressor metrics
+ */
+static void stress_export_stressors(FILE *fp, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	stress_export_header(fp, "stress_ng_bogo_ops_total", "counter",
+		"Bogo operations completed by all instances of the stressor.");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_export_ops_t *total = stress_export_ops_find(ss);
+		uint64_t ops = 0;
+
+		if (total)
+			ops = total->ops;
+		if (!total || !total->done)
+			ops += stress_export_run_ops(ss);
+		stress_export_sample(fp, "stress_ng_bogo_ops_total", ss,
+			"%" PRIu64, ops);
+	}
+
+	stress_export_header(fp, "stress_ng_instances", "gauge",
+		"Number of instances of the stressor started.");
+	for (ss = stressors_list; ss; ss = ss->next)
+		stress_export_sample(fp, "stress_ng_instances", ss,
+			"%" PRId32, ss->started_instances);
+
+	stress_export_header(fp, "stress_ng_instances_running", "gauge",
+		"Number of instances of the stressor still running.");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j, running = 0;
+
+		/* finish is set to the start time until the instance ends */
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+
+			if ((stats->start > 0.0) && (stats->finish == stats->start))
+				running++;
+		}
+		stress_export_sample(fp, "stress_ng_instances_running", ss,
+			"%" PRId32, running);
+	}
+
+	stress_export_header(fp, "stress_ng_run_ok", "gauge",
+		"Number of instances of the stressor that completed successfully.");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j, run_ok = 0;
+
+		for (j = 0; j < ss->started_instances; j++)
+			run_ok += ss->stats[j]->run_ok;
+		stress_export_sample(fp, "stress_ng_run_ok", ss,
+			"%" PRId32, run_ok);
+	}
+}
+
+#if defined(STRESS_THERMAL_ZONES)
+/*
+ *  stress_export_tz()
+ *	write the current thermal zone temperatures
+ */
+static void stress_export_tz(FILE *fp)
+{
+	static stress_tz_t tz;
+	stress_tz_info_t *tz_info;
+	char key[160];
+
+	if (!(g_opt_flags & OPT_FLAGS_THERMAL_ZONES) || !g_shared->tz_info)
+		return;
+
+	(void)stress_tz_get_temperatures(&g_shared->tz_info, &tz);
+	stress_export_header(fp, "stress_ng_thermal_zone_celsius", "gauge",
+		"Thermal zone temperature.");
+	for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next) {
+		(void)fputs("stress_ng_thermal_zone_celsius{zone=\"", fp);
+		stress_tz_key(tz_info, key, sizeof(key));
+		stress_export_label(fp, key);
+		(void)fprintf(fp, "\"} %.3f\n",
+			(double)tz.tz_stat[tz_info->index].temperature / 1000.0);
+	}
+}
+#endif
+
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+/*
+ *  stress_export_perf()
+ *	write the perf counter totals, these are only
+ *	available once the stressor instances have finished
+ */
+static void stress_export_perf(FILE *fp, stress_stressor_t *stressors_list)
+{
+	size_t p;
+	char label[128];
+	uint64_t total;
+
+	if (!(g_opt_flags & OPT_FLAGS_PERF_STATS))
+		return;
+
+	for (p = 0; stress_perf_stat_total(stressors_list, p, label,
+						sizeof(label), &total); p++) {
+		const stress_stressor_t *ss;
+		char name[192];
+		char metric[160];
+		size_t len;
+		bool header = false;
+
+		stress_export_name(metric, label, sizeof(metric));
+		/* Avoid a _total_total suffix, e.g. for page faults total */
+		len = strlen(metric);
+		if ((len > 6) && !strcmp(metric + len - 6, "_total"))
+			metric[len - 6] = '\0';
+		(void)snprintf(name, sizeof(name), "stress_ng_perf_%s_total", metric);
+
+		for (ss = stressors_list; ss; ss = ss->next) {
+			if (!stress_perf_stat_total(ss, p, label,
+						    sizeof(label), &total) ||
+			    (total == STRESS_PERF_INVALID) || (total == 0))
+				continue;
+			if (!header) {
+				stress_export_header(fp, name, "counter",
+					"Perf event count over all instances of the stressor.");
+				header = true;
+			}
+			stress_export_sample(fp, name, ss, "%" PRIu64, total);
+		}
+	}
+}
+#endif
+
+/*
+ *  stress_export_write()
+ *	atomically replace the exported metrics file by writing
+ *	a temporary file and renaming it over the old one, so a
+ *	scraper never sees a partially written file
+ */
+static void stress_export_write(stress_stressor_t *stressors_list, const bool final)
+{
+	char tmp[PATH_MAX];
+	FILE *fp;
+
+	(void)snprintf(tmp, sizeof(tmp), "%s.tmp", export_path);
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		pr_err("metrics-export: cannot create %s, errno=%d (%s)\n",
+			tmp, errno, strerror(errno));
+		export_path = NULL;
+		return;
+	}
+
+	stress_export_header(fp, "stress_ng_run_seconds", "gauge",
+		"Wall clock time since the stressors were started.");
+	(void)fprintf(fp, "stress_ng_run_seconds %f\n",
+		stress_time_now() - export_start);
+	stress_export_header(fp, "stress_ng_running", "gauge",
+		"1 while stress-ng is running the stressors, 0 when done.");
+	(void)fprintf(fp, "stress_ng_running %d\n", final ? 0 : 1);
+
+	stress_export_stressors(fp, stressors_list);
+#if defined(STRESS_THERMAL_ZONES)
+	stress_export_tz(fp);
+#endif
+#if defined(STRESS_PERF_STATS) &&	\
+    defined(HAVE_LINUX_PERF_EVENT_H)
+	if (final)
+		stress_export_perf(fp, stressors_list);
+#endif
+
+	if ((fflush(fp) != 0) || ferror(fp)) {
+		pr_err("metrics-export: failed to write %s, errno=%d (%s)\n",
+			tmp, errno, strerror(errno));
+		(void)fclose(fp);
+		(void)unlink(tmp);
+		return;
+	}
+	(void)fclose(fp);
+	if (rename(tmp, export_path) < 0) {
+		pr_err("metrics-export: cannot rename %s to %s, errno=%d (%s)\n",
+			tmp, export_path, errno, strerror(errno));
+		(void)unlink(tmp);
+	}
+}
+
+/*
+ *  stress_export_start()
+ *	start exporting metrics of the stressors in stressors_list
+ *	that started at time_start, all_list is the list of all the
+ *	stressors so that the ones that already finished in a
+ *	--sequential run are still exported, returns false if
+ *	not enabled
+ */
+bool stress_export_start(
+	stress_stressor_t *all_list,
+	stress_stressor_t *stressors_list,
+	const double time_start)
+{
+	const stress_stressor_t *ss;
+	char *path = NULL;
+
+	if (!export_path) {
+		if (!stress_get_setting("metrics-export", &path))
+			return false;
+		export_path = path;
+		export_start = time_start;
+	}
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_export_ops_t *total = stress_export_ops_find(ss);
+
+		if (total)
+			total->done = false;
+	}
+	export_next = stress_time_now();
+	stress_export_tick(all_list, export_next);
+
+	return export_path != NULL;
+}
+
+/*
+ *  stress_export_tick()
+ *	rewrite the exported metrics if an update is due
+ */
+void stress_export_tick(stress_stressor_t *all_list, const double now)
+{
+	if (!export_path || (now < export_next))
+		return;
+
+	stress_export_write(all_list, false);
+	export_next += EXPORT_PERIOD;
+	if (export_next < now)
+		export_next = now + EXPORT_PERIOD;
+}
+
+/*
+ *  stress_export_stop()
+ *	add the bogo ops of the run that just finished to the
+ *	totals before the next run resets the instance counters
+ */
+void stress_export_stop(stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	if (!export_path)
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_export_ops_t *total = stress_export_ops_find(ss);
+
+		if (total && !total->done) {
+			total->ops += stress_export_run_ops(ss);
+			total->done = true;
+		}
+	}
+}
+
+/*
+ *  stress_export_finish()
+ *	write the final metrics once all the stressors
+ *	have finished, including the perf counter totals
+ */
+void stress_export_finish(stress_stressor_t *all_list)
+{
+	if (export_path) {
+		stress_export_write(all_list, true);
+		export_path = NULL;
+	}
+	free(export_ops);
+	export_ops = NULL;
+	export_ops_num = 0;
+}
@@ -885,46 +885,46 @@ void pr_yaml_runinfo(FILE *yaml)
 	char hostname[hostname_len];
 	const char *user = shim_getlogin();
 
-	pr_yaml(yaml, "system-info:\n");
+	stress_report_map(yaml, "system-info");
 	if (time(&t) != ((time_t)-1))
 		tm = localtime(&t);
 
-	pr_yaml(yaml, "      stress-ng-version: " VERSION "\n");
-	pr_yaml(yaml, "      run-by: %s\n", user ? user : "unknown");
+	stress_report_str(yaml, "stress-ng-version", "%s", VERSION);
+	stress_report_str(yaml, "run-by", "%s", user ? user : "unknown");
 	if (tm) {
-		pr_yaml(yaml, "      date-yyyy-mm-dd: %4.4d:%2.2d:%2.2d\n",
+		stress_report_str(yaml, "date-yyyy-mm-dd", "%4.4d:%2.2d:%2.2d",
 			tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
-		pr_yaml(yaml, "      time-hh-mm-ss: %2.2d:%2.2d:%2.2d\n",
+		stress_report_str(yaml, "time-hh-mm-ss", "%2.2d:%2.2d:%2.2d",
 			tm->tm_hour, tm->tm_min, tm->tm_sec);
-		pr_yaml(yaml, "      epoch-secs: %ld\n", (long)t);
+		stress_report_int64(yaml, "epoch-secs", (int64_t)t);
 	}
 	if (!gethostname(hostname, sizeof(hostname)))
-		pr_yaml(yaml, "      hostname: %s\n", hostname);
+		stress_report_str(yaml, "hostname", "%s", hostname);
 #if defined(HAVE_UNAME) && defined(HAVE_SYS_UTSNAME_H)
 	if (uname(&uts) == 0) {
-		pr_yaml(yaml, "      sysname: %s\n", uts.sysname);
-		pr_yaml(yaml, "      nodename: %s\n", uts.nodename);
-		pr_yaml(yaml, "      release: %s\n", uts.release);
-		pr_yaml(yaml, "      version: %s\n", uts.version);
-		pr_yaml(yaml, "      machine: %s\n", uts.machine);
+		stress_report_str(yaml, "sysname", "%s", uts.sysname);
+		stress_report_str(yaml, "nodename", "%s", uts.nodename);
+		stress_report_str(yaml, "release", "%s", uts.release);
+		stress_report_str(yaml, "version", "%s", uts.version);
+		stress_report_str(yaml, "machine", "%s", uts.machine);
 	}
 #endif
 #if defined(HAVE_SYS_SYSINFO_H) && defined(HAVE_SYSINFO)
 	if (sysinfo(&info) == 0) {
-		pr_yaml(yaml, "      uptime: %ld\n", info.uptime);
-		pr_yaml(yaml, "      totalram: %lu\n", info.totalram);
-		pr_yaml(yaml, "      freeram: %lu\n", info.freeram);
-		pr_yaml(yaml, "      sharedram: %lu\n", info.sharedram);
-		pr_yaml(yaml, "      bufferram: %lu\n", info.bufferram);
-		pr_yaml(yaml, "      totalswap: %lu\n", info.totalswap);
-		pr_yaml(yaml, "      freeswap: %lu\n", info.freeswap);
+		stress_report_int64(yaml, "uptime", (int64_t)info.uptime);
+		stress_report_uint64(yaml, "totalram", (uint64_t)info.totalram);
+		stress_report_uint64(yaml, "freeram", (uint64_t)info.freeram);
+		stress_report_uint64(yaml, "sharedram", (uint64_t)info.sharedram);
+		stress_report_uint64(yaml, "bufferram", (uint64_t)info.bufferram);
+		stress_report_uint64(yaml, "totalswap", (uint64_t)info.totalswap);
+		stress_report_uint64(yaml, "freeswap", (uint64_t)info.freeswap);
 	}
 #endif
-	pr_yaml(yaml, "      pagesize: %zd\n", stress_get_pagesize());
-	pr_yaml(yaml, "      cpus: %" PRId32 "\n", stress_get_processors_configured());
-	pr_yaml(yaml, "      cpus-online: %" PRId32 "\n", stress_get_processors_online());
-	pr_yaml(yaml, "      ticks-per-second: %" PRId32 "\n", stress_get_ticks_per_second());
-	pr_yaml(yaml, "\n");
+	stress_report_uint64(yaml, "pagesize", (uint64_t)stress_get_pagesize());
+	stress_report_int64(yaml, "cpus", (int64_t)stress_get_processors_configured());
+	stress_report_int64(yaml, "cpus-online", (int64_t)stress_get_processors_online());
+	stress_report_int64(yaml, "ticks-per-second", (int64_t)stress_get_ticks_per_second());
+	stress_report_end(yaml);
 }
 
 
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+/* A bogo-op throughput sample of one stressor over one interval */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor sampled */
+	double time;			/* end of interval, secs since start */
+	double duration;		/* duration of interval in secs */
+	uint64_t ops;			/* bogo-ops done in the interval */
+} stress_interval_sample_t;
+
+static double interval_period;		/* sampling period in secs */
+static double interval_start;		/* start time of the run */
+static double interval_last;		/* time of last sample */
+static double interval_next;		/* time of next sample */
+static uint64_t *interval_counters;	/* last counter of each instance */
+static size_t interval_counters_max;	/* number of counters */
+static stress_interval_sample_t *interval_samples;
+static size_t interval_samples_num;
+static size_t interval_samples_max;
+static bool interval_heading;
+
+/*
+ *  stress_interval_start()
+ *	start interval sampling of the stressors in
+ *	stressors_list that started running at time_start
+ */
+int stress_interval_start(
+	stress_stressor_t *stressors_list,
+	const double time_start,
+	const double period)
+{
+	const stress_stressor_t *ss;
+	size_t n = 0;
+
+	/* Staged stressors start more instances later on */
+	for (ss = stressors_list; ss; ss = ss->next)
+		n += (size_t)ss->num_instances;
+
+	free(interval_counters);
+	interval_counters = calloc(n ? n : 1, sizeof(*interval_counters));
+	if (!interval_counters) {
+		pr_err("cannot allocate interval sampling counters\n");
+		interval_counters_max = 0;
+		return -1;
+	}
+	interval_counters_max = n;
+	interval_period = period;
+	interval_start = time_start;
+	interval_last = time_start;
+	interval_next = time_start + period;
+
+	return 0;
+}
+
+/*
+ *  stress_interval_next()
+ *	time when the next interval sample is due
+ */
+double stress_interval_next(void)
+{
+	return interval_next;
+}
+
+/*
+ *  stress_interval_add()
+ *	add a sample to the interval series
+ */
+static int stress_interval_add(
+	const stress_stressor_t *ss,
+	const double now,
+	const double duration,
+	const uint64_t ops)
+{
+	stress_interval_sample_t *sample;
+
+	if (interval_samples_num >= interval_samples_max) {
+		const size_t max = interval_samples_max ?
+			interval_samples_max * 2 : 64;
+
+		sample = realloc(interval_samples, max * sizeof(*sample));
+		if (!sample)
+			return -1;
+		interval_samples = sample;
+		interval_samples_max = max;
+	}
+	sample = &interval_samples[interval_samples_num++];
+	sample->ss = ss;
+	sample->time = now - interval_start;
+	sample->duration = duration;
+	sample->ops = ops;
+
+	return 0;
+}
+
+/*
+ *  stress_interval_tick()
+ *	if an interval sample is due, sum up the bogo-ops
+ *	each stressor has done since the previous sample and
+ *	report the bogo-op rate over the interval
+ */
+void stress_interval_tick(stress_stressor_t *stressors_list, const double now)
+{
+	const stress_stressor_t *ss;
+	const double duration = now - interval_last;
+	size_t base = 0;
+
+	if ((now < interval_next) || !interval_counters)
+		return;
+
+	if (!interval_heading) {
+		pr_inf("%-13s %9s %12s %12s\n",
+			"stressor", "time (s)", "bogo ops", "bogo ops/s");
+		interval_heading = true;
+	}
+
+	/* The counters of a stressor start at base, one per instance slot */
+	for (ss = stressors_list; ss; base += (size_t)ss->num_instances, ss = ss->next) {
+		int32_t j;
+		uint64_t ops = 0;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+			const size_t n = base + (size_t)j;
+
+			if (n >= interval_counters_max)
+				break;
+			/*
+			 *  A counter that is being updated is not
+			 *  trustworthy, so use it next time around
+			 */
+			shim_mb();
+			if (stats->counter_ready) {
+				const uint64_t counter = stats->counter;
+
+				if (counter >= interval_counters[n]) {
+					ops += counter - interval_counters[n];
+					interval_counters[n] = counter;
+				}
+			}
+		}
+		if (!ss->started_instances)
+			continue;
+
+		pr_inf("%-13s %9.2f %12" PRIu64 " %12.2f\n",
+			stress_munge_underscore(ss->stressor->name),
+			now - interval_start, ops,
+			duration > 0.0 ? (double)ops / duration : 0.0);
+		if (stress_interval_add(ss, now, duration, ops) < 0)
+			pr_dbg("cannot allocate interval sample, "
+				"interval metrics will be incomplete\n");
+	}
+
+	interval_last = now;
+	/* Skip any samples that were missed */
+	while (interval_next <= now)
+		interval_next += interval_period;
+}
+
+/*
+ *  stress_interval_dump()
+ *	dump the interval bogo-op rates to the YAML file
+ */
+void stress_interval_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	if (!interval_samples_num)
+		return;
+
+	pr_yaml(yaml, "interval-metrics:\n");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		size_t i;
+		bool dumped_heading = false;
+
+		for (i = 0; i < interval_samples_num; i++) {
+			const stress_interval_sample_t *sample = &interval_samples[i];
+
+			if (sample->ss != ss)
+				continue;
+			if (!dumped_heading) {
+				pr_yaml(yaml, "    - stressor: %s\n",
+					stress_munge_underscore(ss->stressor->name));
+				pr_yaml(yaml, "      samples:\n");
+				dumped_heading = true;
+			}
+			pr_yaml(yaml, "        - time: %f\n", sample->time);
+			pr_yaml(yaml, "          duration: %f\n", sample->duration);
+			pr_yaml(yaml, "          bogo-ops: %" PRIu64 "\n", sample->ops);
+			pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n",
+				sample->duration > 0.0 ?
+				(double)sample->ops / sample->duration : 0.0);
+		}
+		if (dumped_heading)
+			pr_yaml(yaml, "\n");
+	}
+}
+
+/*
+ *  stress_interval_free()
+ *	free interval sampling data
+ */
+void stress_interval_free(void)
+{
+	free(interval_counters);
+	interval_counters = NULL;
+	interval_counters_max = 0;
+	free(interval_samples);
+	interval_samples = NULL;
+	interval_samples_num = 0;
+	interval_samples_max = 0;
+}
@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define KSTAT_TOP_MAX		(8)
+
+/* A kernel activity counter, e.g. vmstat.pgfault */
+typedef struct {
+	char name[48];			/* source and counter name */
+	uint64_t value;			/* counter value or delta */
+} stress_kstat_t;
+
+/* A set of kernel activity counters */
+typedef struct {
+	stress_kstat_t *kstats;		/* counters */
+	size_t num;			/* number of counters */
+	size_t max;			/* allocated counters */
+} stress_kstat_set_t;
+
+/* A headline per bogo op metric, summed from one or more counters */
+typedef struct {
+	const char *label;		/* report label */
+	const char *names[4];		/* counters, trailing * is a prefix */
+} stress_kstat_metric_t;
+
+static const stress_kstat_metric_t kstat_metrics[] = {
+	{ "page-faults",	{ "vmstat.pgfault", NULL } },
+	{ "major-page-faults",	{ "vmstat.pgmajfault", NULL } },
+	{ "compaction-stalls",	{ "vmstat.compact_stall", NULL } },
+	{ "thp-allocs",		{ "vmstat.thp_fault_alloc", "vmstat.thp_collapse_alloc", NULL } },
+	{ "swap-pages",		{ "vmstat.pswpin", "vmstat.pswpout", NULL } },
+	{ "context-switches",	{ "stat.ctxt", NULL } },
+	{ "interrupts",		{ "stat.intr", NULL } },
+	{ "softirqs",		{ "stat.softirq", NULL } },
+	{ "ipis",		{ "interrupts.CAL", "interrupts.RES", "interrupts.TLB", "interrupts.IPI*" } },
+};
+
+/* /proc/stat per cpu time fields, in USER_HZ ticks */
+static const char * const kstat_cpu_fields[] = {
+	"user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal",
+};
+
+/* Kernel activity while a stressor was running, over all of its runs */
+static stress_results_t kstat_results = {
+	"kernel-stats", "kernel activity", sizeof(stress_kstat_set_t), NULL, 0
+};
+static stress_kstat_set_t kstat_start;
+static double kstat_time_start;
+static bool kstat_running;
+
+/*
+ *  stress_kstat_add()
+ *	add a counter to a set of counters
+ */
+static void stress_kstat_add(
+	stress_kstat_set_t *set,
+	const char *name,
+	const uint64_t value)
+{
+	stress_kstat_t *kstat;
+
+	if (set->num >= set->max) {
+		const size_t max = set->max ? set->max * 2 : 256;
+
+		kstat = realloc(set->kstats, max * sizeof(*kstat));
+		if (!kstat)
+			return;
+		set->kstats = kstat;
+		set->max = max;
+	}
+	kstat = &set->kstats[set->num++];
+	(void)shim_strlcpy(kstat->name, name, sizeof(kstat->name));
+	kstat->value = value;
+}
+
+/*
+ *  stress_kstat_find()
+ *	find a counter by name, the sets are read in the same
+ *	order so the counter is normally at index hint
+ */
+static stress_kstat_t *stress_kstat_find(
+	const stress_kstat_set_t *set,
+	const char *name,
+	const size_t hint)
+{
+	size_t i;
+
+	if ((hint < set->num) && !strcmp(set->kstats[hint].name, name))
+		return &set->kstats[hint];
+	for (i = 0; i < set->num; i++) {
+		if (!strcmp(set->kstats[i].name, name))
+			return &set->kstats[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_kstat_free_set()
+ *	free a set of counters
+ */
+static void stress_kstat_free_set(stress_kstat_set_t *set)
+{
+	free(set->kstats);
+	(void)memset(set, 0, sizeof(*set));
+}
+
+/*
+ *  stress_kstat_fgets()
+ *	read a line, discarding the rest of lines that
+ *	are too long for the buffer
+ */
+static char *stress_kstat_fgets(char *buf, const int len, FILE *fp)
+{
+	int ch;
+
+	if (!fgets(buf, len, fp))
+		return NULL;
+	if (strchr(buf, '\n'))
+		return buf;
+	do {
+		ch = fgetc(fp);
+	} while ((ch != '\n') && (ch != EOF));
+	return buf;
+}
+
+/*
+ *  stress_kstat_read_vmstat()
+ *	read the /proc/vmstat event counters, the nr_ entries
+ *	are gauges of the current number of pages and not
+ *	counters so their start to end change is meaningless
+ */
+static void stress_kstat_read_vmstat(stress_kstat_set_t *set)
+{
+	FILE *fp;
+	char buf[256];
+
+	if ((fp = fopen("/proc/vmstat", "r")) == NULL)
+		return;
+	while (stress_kstat_fgets(buf, sizeof(buf), fp)) {
+		char name[40], key[48];
+		uint64_t value;
+
+		if (sscanf(buf, "%39s %" SCNu64, name, &value) != 2)
+			continue;
+		if (!strncmp(name, "nr_", 3))
+			continue;
+		(void)snprintf(key, sizeof(key), "vmstat.%s", name);
+		stress_kstat_add(set, key, value);
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_kstat_read_stat()
+ *	read the context switch, interrupt, softirq and fork
+ *	totals and the per cpu times from /proc/stat
+ */
+static void stress_kstat_read_stat(stress_kstat_set_t *set)
+{
+	FILE *fp;
+	char buf[16384];
+
+	if ((fp = fopen("/proc/stat", "r")) == NULL)
+		return;
+	while (stress_kstat_fgets(buf, sizeof(buf), fp)) {
+		char name[32], key[48];
+		uint64_t value;
+
+		if (sscanf(buf, "%31s %" SCNu64, name, &value) != 2)
+			continue;
+		if (!strncmp(name, "cpu", 3) && isdigit((int)name[3])) {
+			char *ptr = buf + strlen(name);
+			size_t i;
+
+			for (i = 0; i < SIZEOF_ARRAY(kstat_cpu_fields); i++) {
+				char *end;
+
+				value = (uint64_t)strtoull(ptr, &end, 10);
+				if (end == ptr)
+					break;
+				ptr = end;
+				(void)snprintf(key, sizeof(key), "stat.%s.%s",
+					name, kstat_cpu_fields[i]);
+				stress_kstat_add(set, key, value);
+			}
+		} else if (!strcmp(name, "ctxt") ||
+			   !strcmp(name, "intr") ||
+			   !strcmp(name, "softirq") ||
+			   !strcmp(name, "processes")) {
+			(void)snprintf(key, sizeof(key), "stat.%s", name);
+			stress_kstat_add(set, key, value);
+		}
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_kstat_read_per_cpu()
+ *	read a /proc file with a CPUn header line and rows of
+ *	per cpu counts, such as /proc/interrupts, adding the
+ *	total of each row over all the cpus
+ */
+static void stress_kstat_read_per_cpu(
+	stress_kstat_set_t *set,
+	const char *path,
+	const char *prefix)
+{
+	FILE *fp;
+	char buf[16384];
+	char *ptr;
+	size_t cpus = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	if (!stress_kstat_fgets(buf, sizeof(buf), fp))
+		goto close;
+	for (ptr = buf; (ptr = strstr(ptr, "CPU")) != NULL; ptr += 3)
+		cpus++;
+
+	while (stress_kstat_fgets(buf, sizeof(buf), fp)) {
+		char *label = buf, key[48];
+		uint64_t total = 0;
+		size_t i;
+
+		while (isspace((int)*label))
+			label++;
+		ptr = strchr(label, ':');
+		if (!ptr)
+			continue;
+		*ptr++ = '\0';
+		for (i = 0; i < cpus; i++) {
+			char *end;
+			const uint64_t value = (uint64_t)strtoull(ptr, &end, 10);
+
+			if (end == ptr)
+				break;
+			total += value;
+			ptr = end;
+		}
+		(void)snprintf(key, sizeof(key), "%s.%.32s", prefix, label);
+		stress_kstat_add(set, key, total);
+	}
+close:
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_kstat_read()
+ *	snapshot the system wide kernel activity counters
+ */
+static void stress_kstat_read(stress_kstat_set_t *set)
+{
+	set->num = 0;
+	stress_kstat_read_vmstat(set);
+	stress_kstat_read_stat(set);
+	stress_kstat_read_per_cpu(set, "/proc/softirqs", "softirqs");
+	stress_kstat_read_per_cpu(set, "/proc/interrupts", "interrupts");
+}
+
+/*
+ *  stress_kstat_start()
+ *	snapshot the kernel activity counters at the start of a run
+ */
+void stress_kstat_start(void)
+{
+	if (!(g_opt_flags & OPT_FLAGS_KERNEL_STATS))
+		return;
+	kstat_time_start = stress_time_now();
+	stress_kstat_read(&kstat_start);
+	kstat_running = (kstat_start.num > 0);
+}
+
+/*
+ *  stress_kstat_stop()
+ *	snapshot the kernel activity counters at the end of a run
+ *	and add the changes to each stressor in the run, stressors
+ *	run in parallel all share the same changes
+ */
+void stress_kstat_stop(stress_stressor_t *stressors_list)
+{
+	stress_kstat_set_t end;
+	const stress_stressor_t *ss;
+
+	if (!kstat_running)
+		return;
+	kstat_running = false;
+
+	(void)memset(&end, 0, sizeof(end));
+	stress_kstat_read(&end);
+	if (!stress_results_charge(&kstat_results, stressors_list,
+				   stress_time_now() - kstat_time_start)) {
+		stress_kstat_free_set(&end);
+		return;
+	}
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_result_t *result =
+			stress_results_find(&kstat_results, ss);
+		stress_kstat_set_t *set = result->data;
+		size_t i;
+
+		for (i = 0; i < end.num; i++) {
+			const stress_kstat_t *kend = &end.kstats[i];
+			const stress_kstat_t *kstart;
+			stress_kstat_t *delta;
+			uint64_t value;
+
+			kstart = stress_kstat_find(&kstat_start, kend->name, i);
+			if (!kstart)
+				continue;
+			value = (kend->value > kstart->value) ?
+				kend->value - kstart->value : 0;
+			delta = stress_kstat_find(set, kend->name, i);
+			if (delta)
+				delta->value += value;
+			else
+				stress_kstat_add(set, kend->name, value);
+		}
+	}
+	stress_kstat_free_set(&end);
+}
+
+/*
+ *  stress_kstat_metric()
+ *	sum the counters of a headline metric
+ */
+static uint64_t stress_kstat_metric(
+	const stress_kstat_set_t *set,
+	const stress_kstat_metric_t *metric)
+{
+	uint64_t total = 0;
+	size_t i, j;
+
+	for (i = 0; (i < SIZEOF_ARRAY(metric->names)) && metric->names[i]; i++) {
+		const char *name = metric->names[i];
+		const size_t len = strlen(name);
+
+		for (j = 0; j < set->num; j++) {
+			const char *kname = set->kstats[j].name;
+
+			if ((name[len - 1] == '*') ?
+			    !strncmp(kname, name, len - 1) : !strcmp(kname, name))
+				total += set->kstats[j].value;
+		}
+	}
+	return total;
+}
+
+/*
+ *  stress_kstat_cpu_busy()
+ *	busy percentage of cpu, false if the cpu was not seen
+ */
+static bool stress_kstat_cpu_busy(
+	const stress_kstat_set_t *set,
+	const uint32_t cpu,
+	double *busy)
+{
+	uint64_t total = 0, idle = 0;
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(kstat_cpu_fields); i++) {
+		const stress_kstat_t *kstat;
+		char name[48];
+
+		(void)snprintf(name, sizeof(name), "stat.cpu%" PRIu32 ".%s",
+			cpu, kstat_cpu_fields[i]);
+		kstat = stress_kstat_find(set, name, 0);
+		if (!kstat)
+			break;
+		total += kstat->value;
+		if (!strcmp(kstat_cpu_fields[i], "idle") ||
+		    !strcmp(kstat_cpu_fields[i], "iowait"))
+			idle += kstat->value;
+	}
+	if (!i)
+		return false;
+	*busy = total ? 100.0 * (double)(total - idle) / (double)total : 0.0;
+	return true;
+}
+
+/*
+ *  stress_kstat_cmp()
+ *	sort counters into descending order of change
+ */
+static int stress_kstat_cmp(const void *p1, const void *p2)
+{
+	const stress_kstat_t *k1 = *(const stress_kstat_t * const *)p1;
+	const stress_kstat_t *k2 = *(const stress_kstat_t * const *)p2;
+
+	if (k1->value < k2->value)
+		return 1;
+	else if (k1->value > k2->value)
+		return -1;
+	return strcmp(k1->name, k2->name);
+}
+
+/*
+ *  stress_kstat_dump_result()
+ *	report the headline kernel activity per bogo op, the
+ *	most changed counters and the cpu utilization of a stressor
+ */
+static void stress_kstat_dump_result(
+	FILE *yaml,
+	const char *munged,
+	const stress_result_t *result)
+{
+	const stress_kstat_set_t *set = result->data;
+	const double ops = (double)result->ops;
+	const stress_kstat_t **sorted;
+	double busy, min = 0.0, max = 0.0, sum = 0.0;
+	uint32_t cpu;
+	size_t i, n = 0;
+
+	stress_results_report(yaml, result);
+
+	for (i = 0; i < SIZEOF_ARRAY(kstat_metrics); i++) {
+		const uint64_t value = stress_kstat_metric(set, &kstat_metrics[i]);
+		char key[64];
+
+		pr_inf("%-13s %-28s %14" PRIu64 " %14.4f\n", munged,
+			kstat_metrics[i].label, value,
+			ops > 0.0 ? (double)value / ops : 0.0);
+		stress_report_uint64(yaml, kstat_metrics[i].label, value);
+		(void)snprintf(key, sizeof(key), "%s-per-bogo-op", kstat_metrics[i].label);
+		stress_report_double(yaml, key, ops > 0.0 ? (double)value / ops : 0.0);
+	}
+
+	/* Most changed counters, per cpu times are reported as utilization */
+	sorted = calloc(set->num ? set->num : 1, sizeof(*sorted));
+	if (sorted) {
+		for (i = 0; i < set->num; i++) {
+			if (set->kstats[i].value &&
+			    strncmp(set->kstats[i].name, "stat.cpu", 8))
+				sorted[n++] = &set->kstats[i];
+		}
+		qsort(sorted, n, sizeof(*sorted), stress_kstat_cmp);
+		for (i = 0; (i < n) && (i < KSTAT_TOP_MAX); i++) {
+			pr_inf("%-13s %-28s %14" PRIu64 " %14.4f\n", munged,
+				sorted[i]->name, sorted[i]->value,
+				ops > 0.0 ? (double)sorted[i]->value / ops : 0.0);
+			stress_report_uint64(yaml, sorted[i]->name, sorted[i]->value);
+		}
+		free(sorted);
+	}
+
+	for (cpu = 0; stress_kstat_cpu_busy(set, cpu, &busy); cpu++) {
+		char key[48];
+
+		if (!cpu || (busy < min))
+			min = busy;
+		if (!cpu || (busy > max))
+			max = busy;
+		sum += busy;
+		(void)snprintf(key, sizeof(key), "cpu%" PRIu32 "-busy-percent", cpu);
+		stress_report_double(yaml, key, busy);
+	}
+	if (cpu)
+		pr_inf("%-13s cpu busy: min %.2f%%, mean %.2f%%, max %.2f%% over %" PRIu32 " cpus\n",
+			munged, min, sum / (double)cpu, max, cpu);
+}
+
+/*
+ *  stress_kstat_dump()
+ *	report the system wide kernel activity of each stressor
+ */
+void stress_kstat_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_result_t *result =
+			stress_results_find(&kstat_results, ss);
+
+		if (!result)
+			continue;
+
+		if (!heading) {
+			pr_inf("%-13s %-28s %14s %14s\n", "stressor",
+				"kernel activity", "count", "per bogo op");
+			stress_report_list(yaml, "kernel-stats");
+			heading = true;
+		}
+		stress_kstat_dump_result(yaml,
+			stress_munge_underscore(ss->stressor->name), result);
+	}
+	if (!heading)
+		return;
+	stress_report_end(yaml);
+	stress_results_shared(&kstat_results);
+}
+
+/*
+ *  stress_kstat_free_data()
+ *	free the counter deltas of a result
+ */
+static void stress_kstat_free_data(void *data)
+{
+	stress_kstat_free_set((stress_kstat_set_t *)data);
+}
+
+/*
+ *  stress_kstat_free()
+ *	free kernel activity results
+ */
+void stress_kstat_free(void)
+{
+	stress_results_free(&kstat_results, stress_kstat_free_data);
+	stress_kstat_free_set(&kstat_start);
+	kstat_running = false;
+}
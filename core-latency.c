@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define STRESS_LATENCY_MAX_NS	((1ULL << STRESS_LATENCY_MAX_BITS) - 1)
+
+/*
+ *  stress_latency_now_ns()
+ *	monotonic time in nanoseconds
+ */
+static inline uint64_t stress_latency_now_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+#endif
+	return (uint64_t)(stress_time_now() * 1000000000.0);
+}
+
+/*
+ *  stress_latency_msb()
+ *	index of most significant set bit, val must be non-zero
+ */
+static inline int stress_latency_msb(const uint64_t val)
+{
+#if defined(HAVE_BUILTIN_CTZ)
+	return 63 - __builtin_clzll(val);
+#else
+	uint64_t v = val;
+	int msb = 0;
+
+	while (v >>= 1)
+		msb++;
+	return msb;
+#endif
+}
+
+/*
+ *  stress_latency_index()
+ *	map a value in nanoseconds to a histogram bucket index
+ */
+static inline size_t stress_latency_index(const uint64_t ns)
+{
+	int shift;
+	const uint64_t val = (ns > STRESS_LATENCY_MAX_NS) ?
+		STRESS_LATENCY_MAX_NS : ns;
+
+	if (val < (STRESS_LATENCY_SUB_HALF << 1))
+		return (size_t)val;
+
+	shift = stress_latency_msb(val) - (STRESS_LATENCY_SUB_BITS - 1);
+	return ((size_t)shift * STRESS_LATENCY_SUB_HALF) + (size_t)(val >> shift);
+}
+
+/*
+ *  stress_latency_value()
+ *	map a histogram bucket index to the mid-point value
+ *	of the range of values the bucket covers
+ */
+static inline uint64_t stress_latency_value(const size_t index)
+{
+	size_t shift;
+	uint64_t sub;
+
+	if (index < (STRESS_LATENCY_SUB_HALF << 1))
+		return (uint64_t)index;
+
+	shift = (index / STRESS_LATENCY_SUB_HALF) - 1;
+	sub = (uint64_t)(index - (shift * STRESS_LATENCY_SUB_HALF));
+
+	return (sub << shift) + ((1ULL << shift) >> 1);
+}
+
+/*
+ *  stress_latency_init()
+ *	reset a latency histogram
+ */
+void stress_latency_init(stress_latency_t *latency)
+{
+	(void)memset(latency, 0, sizeof(*latency));
+	latency->min_ns = ~0ULL;
+}
+
+/*
+ *  stress_latency_add()
+ *	add ops bogo ops of latency ns to the histogram
+ */
+static inline void stress_latency_add(
+	stress_latency_t *latency,
+	const uint64_t ns,
+	const uint64_t ops)
+{
+	latency->bucket[stress_latency_index(ns)] += ops;
+	latency->count += ops;
+	latency->sum_ns += ns * ops;
+	if (ns < latency->min_ns)
+		latency->min_ns = ns;
+	if (ns > latency->max_ns)
+		latency->max_ns = ns;
+}
+
+/*
+ *  stress_latency_set_rate()
+ *	run open-loop at a fixed rate of ops_per_sec bogo ops
+ *	per second, 0 runs closed loop as fast as possible
+ */
+void stress_latency_set_rate(stress_latency_t *latency, const double ops_per_sec)
+{
+	latency->interval_ns = (ops_per_sec > 0.0) ?
+		(uint64_t)(1000000000.0 / ops_per_sec) : 0;
+	if ((ops_per_sec > 0.0) && (latency->interval_ns == 0))
+		latency->interval_ns = 1;
+}
+
+/*
+ *  stress_latency_pace()
+ *	sleep until the intended start time of the next bogo op,
+ *	if the stressor is behind schedule then don't sleep and
+ *	let the next ops run back to back to catch up
+ */
+static void stress_latency_pace(const uint64_t next_ns, const uint64_t now)
+{
+	if (next_ns <= now)
+		return;
+#if defined(HAVE_CLOCK_GETTIME) &&	\
+    defined(HAVE_CLOCK_NANOSLEEP) &&	\
+    defined(CLOCK_MONOTONIC) &&		\
+    defined(TIMER_ABSTIME)
+	{
+		struct timespec ts;
+
+		ts.tv_sec = (time_t)(next_ns / 1000000000ULL);
+		ts.tv_nsec = (long)(next_ns % 1000000000ULL);
+		while (keep_stressing_flag()) {
+			if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != EINTR)
+				break;
+		}
+	}
+#else
+	(void)shim_nanosleep_uint64(next_ns - now);
+#endif
+}
+
+/*
+ *  stress_latency_record_paced()
+ *	open-loop accounting, the latency of each op is measured
+ *	from its intended start time on the fixed schedule rather
+ *	than from when it actually started, so stalls are charged
+ *	to all the ops that should have run during the stall and
+ *	are not hidden by coordinated omission, returns the time
+ *	to pace the next op to or 0 to not pace
+ */
+static uint64_t stress_latency_record_paced(
+	stress_latency_t *latency,
+	const uint64_t ops,
+	const uint64_t now)
+{
+	const uint64_t interval_ns = latency->interval_ns;
+	uint64_t ns, start_ns;
+
+	if (UNLIKELY(latency->next_ns == 0) || UNLIKELY(ops == 0)) {
+		latency->next_ns = now;
+		return 0;
+	}
+
+	/* mean latency of the ops from their intended start times */
+	start_ns = latency->next_ns + ((ops - 1) * interval_ns) / 2;
+	ns = (now > start_ns) ? now - start_ns : 0;
+	latency->next_ns += ops * interval_ns;
+	latency->last_ns = now;
+
+	stress_latency_add(latency, ns, ops);
+	return latency->next_ns;
+}
+
+/*
+ *  stress_latency_record()
+ *	account the time since the previous bogo-op counter
+ *	update against the ops just completed. The first
+ *	update just primes the time stamp so that stressor
+ *	setup time is not accounted as a bogo-op latency.
+ *	Stressors may update the counter from several threads,
+ *	an update made while another thread is recording one
+ *	is not recorded rather than corrupting the histogram.
+ */
+void stress_latency_record(stress_latency_t *latency, const uint64_t ops)
+{
+	const uint64_t now = stress_latency_now_ns();
+	uint64_t ns, next_ns = 0;
+
+#if defined(HAVE_ATOMIC)
+	if (__atomic_test_and_set(&latency->lock, __ATOMIC_ACQUIRE))
+		return;
+#endif
+	if (latency->interval_ns) {
+		next_ns = stress_latency_record_paced(latency, ops, now);
+	} else if (UNLIKELY(latency->last_ns == 0) || UNLIKELY(ops == 0)) {
+		latency->last_ns = now;
+	} else {
+		ns = (now - latency->last_ns) / ops;
+		latency->last_ns = now;
+		stress_latency_add(latency, ns, ops);
+	}
+#if defined(HAVE_ATOMIC)
+	__atomic_clear(&latency->lock, __ATOMIC_RELEASE);
+#endif
+	if (next_ns)
+		stress_latency_pace(next_ns, now);
+}
+
+/*
+ *  stress_latency_merge()
+ *	add histogram src into histogram dst
+ */
+void stress_latency_merge(stress_latency_t *dst, const stress_latency_t *src)
+{
+	size_t i;
+
+	if (!src->count)
+		return;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	dst->sum_ns += src->sum_ns;
+	if (src->min_ns < dst->min_ns)
+		dst->min_ns = src->min_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/*
+ *  stress_latency_sub()
+ *	subtract an earlier snapshot src of a histogram from dst
+ *	to get the histogram of the samples recorded since then;
+ *	the min and max are approximated from the buckets
+ */
+void stress_latency_sub(stress_latency_t *dst, const stress_latency_t *src)
+{
+	size_t i;
+	bool first = true;
+
+	dst->count = 0;
+	dst->min_ns = ~0ULL;
+	dst->max_ns = 0;
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+		dst->bucket[i] = (dst->bucket[i] > src->bucket[i]) ?
+			dst->bucket[i] - src->bucket[i] : 0;
+		if (dst->bucket[i]) {
+			const uint64_t val = stress_latency_value(i);
+
+			if (first) {
+				dst->min_ns = val;
+				first = false;
+			}
+			dst->max_ns = val;
+			dst->count += dst->bucket[i];
+		}
+	}
+	dst->sum_ns = (dst->sum_ns > src->sum_ns) ? dst->sum_ns - src->sum_ns : 0;
+}
+
+/*
+ *  stress_latency_percentile()
+ *	return the latency in nanoseconds at the given
+ *	percentile (0..100), 0 if there are no samples
+ */
+uint64_t stress_latency_percentile(
+	const stress_latency_t *latency,
+	const double percentile)
+{
+	uint64_t target, total = 0;
+	size_t i;
+
+	if (!latency->count)
+		return 0;
+
+	target = (uint64_t)ceil(((double)latency->count * percentile) / 100.0);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < STRESS_LATENCY_BUCKETS; i++) {
+		total += latency->bucket[i];
+		if (total >= target) {
+			uint64_t val = stress_latency_value(i);
+
+			/* Bucket mid-point can't be outside the real range */
+			if (val < latency->min_ns)
+				val = latency->min_ns;
+			if (val > latency->max_ns)
+				val = latency->max_ns;
+			return val;
+		}
+	}
+	return latency->max_ns;
+}
+
+/*
+ *  stress_latency_map()
+ *	allocate the shared latency histograms, one per
+ *	stressor instance
+ */
+int stress_latency_map(const size_t num_procs)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t len = sizeof(stress_latency_t) * (num_procs ? num_procs : 1);
+	const size_t sz = (len + page_size - 1) & ~(page_size - 1);
+
+	g_shared->latencies = (stress_latency_t *)mmap(NULL, sz,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+	if (g_shared->latencies == MAP_FAILED) {
+		pr_err("cannot mmap latency histograms, errno=%d (%s)\n",
+			errno, strerror(errno));
+		g_shared->latencies = NULL;
+		return -1;
+	}
+	g_shared->latencies_length = sz;
+
+	return 0;
+}
+
+/*
+ *  stress_latency_unmap()
+ *	free the shared latency histograms
+ */
+void stress_latency_unmap(void)
+{
+	if (!g_shared->latencies)
+		return;
+
+	(void)munmap((void *)g_shared->latencies, g_shared->latencies_length);
+	g_shared->latencies = NULL;
+	g_shared->latencies_length = 0;
+}
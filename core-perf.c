@@ -40,6 +40,15 @@
 
 #define UNRESOLVED	(~0UL)
 
+#define STRESS_PERF_GROUP_HW_MAX	(4)	/* max hardware events per group */
+#define STRESS_PERF_GROUP_MAX		(16)	/* max software events per group */
+
+#define STRESS_PERF_SAMPLE_PAGES	(64)	/* IP sample ring buffer pages */
+#define STRESS_PERF_SAMPLE_SIZE		(16)	/* size of an IP sample record */
+#define STRESS_PERF_SAMPLE_REC_MAX	(8)	/* max record size in uint64_t */
+#define STRESS_PERF_SAMPLE_FREQ		(1000)	/* max IP samples per second */
+#define STRESS_PERF_SAMPLE_SHOW		(10)	/* hottest symbols to report */
+
 /* used for table of perf events to gather */
 typedef struct {
 	const unsigned long type;	/* perf types */
@@ -48,13 +57,25 @@ typedef struct {
 	const char *label;		/* human readable name for perf type */
 } stress_perf_info_t;
 
-/* perf data */
+/* perf group data */
 typedef struct {
-	uint64_t counter;		/* perf counter */
+	uint64_t nr;			/* number of counters in group */
 	uint64_t time_enabled;		/* perf time enabled */
 	uint64_t time_running;		/* perf time running */
+	uint64_t counter[STRESS_PERF_MAX]; /* perf counters */
 } stress_perf_data_t;
 
+/* used for table of metrics derived from a ratio of perf counters */
+typedef struct {
+	const unsigned long type;	/* perf type of numerator */
+	const unsigned long config;	/* perf config of numerator */
+	const unsigned long per_type;	/* perf type of denominator */
+	const unsigned long per_config;	/* perf config of denominator */
+	const double scale;		/* 100.0 for percentages */
+	const char *label;		/* human readable name of metric */
+	const char *yaml_label;		/* yaml name of metric */
+} stress_perf_derived_t;
+
 typedef struct {
 	const double	threshold;
 	const double	scale;
@@ -74,13 +95,29 @@ typedef struct {
 	{ PERF_TYPE_SOFTWARE, PERF_COUNT_ ## config, NULL, label }
 
 /* Hardware Cache */
+#define PERF_HW_CACHE_CONFIG(cache_id, op_id, result_id)	\
+	((PERF_COUNT_HW_CACHE_ ## cache_id) |			\
+	 ((PERF_COUNT_HW_CACHE_OP_ ## op_id) << 8) |		\
+	 ((PERF_COUNT_HW_CACHE_RESULT_ ## result_id) << 16))
+
 #define PERF_INFO_HW_C(cache_id, op_id, result_id, label)	\
 	{ PERF_TYPE_HW_CACHE, 					\
-	  (PERF_COUNT_HW_CACHE_ ## cache_id) |			\
-	  ((PERF_COUNT_HW_CACHE_OP_ ## op_id) << 8) |		\
-	  ((PERF_COUNT_HW_CACHE_RESULT_ ## result_id) << 16),	\
+	  PERF_HW_CACHE_CONFIG(cache_id, op_id, result_id),	\
 	  NULL, label }
 
+/* Pseudo perf type for the stressor bogo ops count */
+#define PERF_TYPE_BOGO_OPS	(~0UL)
+
+/* Derived metric counters */
+#define PERF_DERIVED_HW(config)		\
+	PERF_TYPE_HARDWARE, PERF_COUNT_ ## config
+
+#define PERF_DERIVED_HW_C(cache_id, op_id, result_id)	\
+	PERF_TYPE_HW_CACHE, PERF_HW_CACHE_CONFIG(cache_id, op_id, result_id)
+
+#define PERF_DERIVED_BOGO_OPS		\
+	PERF_TYPE_BOGO_OPS, 0
+
 #define STRESS_PERF_DEFINED(x) _SNG_PERF_COUNT_ ## x
 
 
@@ -297,6 +334,21 @@ static stress_perf_info_t perf_info[STRESS_PERF_MAX] = {
 	{ 0, 0, NULL, NULL }
 };
 
+static bool perf_select;			/* true if --perf-events used */
+static bool perf_selected[STRESS_PERF_MAX];	/* events chosen by --perf-events */
+
+/* symbols for IP samples */
+typedef struct {
+	uint64_t addr;		/* start address */
+	uint64_t size;		/* size, 0 for up to the next symbol */
+	char *name;		/* symbol or shared library name */
+	bool kernel;		/* true for kernel symbols */
+} stress_perf_sym_t;
+
+static stress_perf_sym_t *perf_syms;	/* symbols sorted by address */
+static size_t perf_syms_num;
+static size_t perf_syms_max;
+
 static inline void stress_perf_type_tracepoint_resolve_config(stress_perf_info_t *pi)
 {
 	char path[PATH_MAX];
@@ -319,6 +371,288 @@ static inline void stress_perf_type_tracepoint_resolve_config(stress_perf_info_t
 	pi->config = config;
 }
 
+/*
+ *  stress_perf_sym_add()
+ *	add a symbol to the IP sample symbol table
+ */
+static void stress_perf_sym_add(
+	const uint64_t addr,
+	const uint64_t size,
+	const char *name,
+	const bool kernel)
+{
+	stress_perf_sym_t *sym;
+
+	if (perf_syms_num >= perf_syms_max) {
+		const size_t max = perf_syms_max ? perf_syms_max * 2 : 4096;
+		stress_perf_sym_t *syms;
+
+		syms = realloc(perf_syms, max * sizeof(*syms));
+		if (!syms)
+			return;
+		perf_syms = syms;
+		perf_syms_max = max;
+	}
+	sym = &perf_syms[perf_syms_num];
+	sym->name = strdup(name);
+	if (!sym->name)
+		return;
+	sym->addr = addr;
+	sym->size = size;
+	sym->kernel = kernel;
+	perf_syms_num++;
+}
+
+/*
+ *  stress_perf_sym_load_kallsyms()
+ *	add the kernel text symbols, these are only visible
+ *	if kptr_restrict allows, otherwise all the addresses
+ *	are zero and kernel samples can't be symbolized
+ */
+static void stress_perf_sym_load_kallsyms(void)
+{
+	FILE *fp;
+	char buf[512];
+
+	fp = fopen("/proc/kallsyms", "r");
+	if (!fp)
+		return;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		uint64_t addr;
+		char type;
+		char name[256];
+
+		if (sscanf(buf, "%" SCNx64 " %c %255s", &addr, &type, name) != 3)
+			continue;
+		if (!addr || ((type != 't') && (type != 'T')))
+			continue;
+		stress_perf_sym_add(addr, 0, name, true);
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_perf_sym_load_maps()
+ *	add the executable mappings of the shared libraries,
+ *	samples in these are accounted to the library as a whole;
+ *	returns the load address of the stress-ng executable
+ */
+static uint64_t stress_perf_sym_load_maps(const char *exe)
+{
+	FILE *fp;
+	char buf[PATH_MAX + 128];
+	uint64_t exe_base = 0;
+
+	fp = fopen("/proc/self/maps", "r");
+	if (!fp)
+		return 0;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		uint64_t begin, end, offset;
+		char perms[8];
+		char path[PATH_MAX];
+		const char *name;
+
+		*path = '\0';
+		if (sscanf(buf, "%" SCNx64 "-%" SCNx64 " %7s %" SCNx64 " %*s %*s %4095s",
+			   &begin, &end, perms, &offset, path) < 4)
+			continue;
+		if (!strcmp(path, exe)) {
+			if ((offset == 0) && (!exe_base))
+				exe_base = begin;
+			continue;
+		}
+		if ((perms[2] != 'x') || !*path)
+			continue;
+		name = strrchr(path, '/');
+		stress_perf_sym_add(begin, end - begin, name ? name + 1 : path, false);
+	}
+	(void)fclose(fp);
+
+	return exe_base;
+}
+
+#if defined(HAVE_ELF_H) &&	\
+    defined(HAVE_LINK_H)
+/*
+ *  stress_perf_sym_load_exe()
+ *	add the function symbols of the stress-ng executable,
+ *	from the full symbol table if it has not been stripped
+ *	or the dynamic symbol table otherwise
+ */
+static void stress_perf_sym_load_exe(const char *exe, const uint64_t exe_base)
+{
+	int fd;
+	struct stat statbuf;
+	uint8_t *data;
+	const ElfW(Ehdr) *ehdr;
+	const ElfW(Shdr) *shdr, *symtab = NULL;
+	uint64_t base;
+	size_t i;
+
+	fd = open(exe, O_RDONLY);
+	if (fd < 0)
+		return;
+	if ((fstat(fd, &statbuf) < 0) || (statbuf.st_size < (off_t)sizeof(*ehdr))) {
+		(void)close(fd);
+		return;
+	}
+	data = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (data == MAP_FAILED)
+		return;
+
+	ehdr = (const ElfW(Ehdr) *)data;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    (ehdr->e_shoff + ((size_t)ehdr->e_shnum * sizeof(*shdr)) > (size_t)statbuf.st_size))
+		goto unmap;
+
+	/* Position independent executables are relocated to the load address */
+	base = (ehdr->e_type == ET_DYN) ? exe_base : 0;
+	shdr = (const ElfW(Shdr) *)(data + ehdr->e_shoff);
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		if (shdr[i].sh_type == SHT_SYMTAB)
+			symtab = &shdr[i];
+		else if ((shdr[i].sh_type == SHT_DYNSYM) && !symtab)
+			symtab = &shdr[i];
+	}
+	if (!symtab || (symtab->sh_link >= ehdr->e_shnum) ||
+	    (symtab->sh_offset + symtab->sh_size > (size_t)statbuf.st_size) ||
+	    (shdr[symtab->sh_link].sh_offset + shdr[symtab->sh_link].sh_size > (size_t)statbuf.st_size))
+		goto unmap;
+
+	for (i = 0; i < symtab->sh_size / sizeof(ElfW(Sym)); i++) {
+		const ElfW(Sym) *sym = (const ElfW(Sym) *)(data + symtab->sh_offset) + i;
+		const char *strtab = (const char *)(data + shdr[symtab->sh_link].sh_offset);
+
+		if ((ELF64_ST_TYPE(sym->st_info) != STT_FUNC) ||
+		    !sym->st_value || !sym->st_size ||
+		    (sym->st_name >= shdr[symtab->sh_link].sh_size))
+			continue;
+		stress_perf_sym_add(base + sym->st_value, sym->st_size,
+			strtab + sym->st_name, false);
+	}
+unmap:
+	(void)munmap((void *)data, (size_t)statbuf.st_size);
+}
+#endif
+
+/*
+ *  stress_perf_sym_cmp()
+ *	sort symbols by address
+ */
+static int stress_perf_sym_cmp(const void *p1, const void *p2)
+{
+	const stress_perf_sym_t *s1 = (const stress_perf_sym_t *)p1;
+	const stress_perf_sym_t *s2 = (const stress_perf_sym_t *)p2;
+
+	if (s1->addr < s2->addr)
+		return -1;
+	if (s1->addr > s2->addr)
+		return 1;
+	return 0;
+}
+
+/*
+ *  stress_perf_sym_lookup()
+ *	find the index of the symbol an IP is in, the symbol
+ *	table is built before the stressors are forked so the
+ *	indices are the same in all stressor instances;
+ *	perf_syms_num is returned for unknown IPs
+ */
+static uint32_t stress_perf_sym_lookup(const uint64_t ip)
+{
+	size_t lo = 0, hi = perf_syms_num;
+	const stress_perf_sym_t *sym;
+
+	/* Find the last symbol starting at or below ip */
+	while (lo < hi) {
+		const size_t mid = lo + ((hi - lo) >> 1);
+
+		if (perf_syms[mid].addr <= ip)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return (uint32_t)perf_syms_num;
+
+	/* Kernel symbols extend up to the next symbol */
+	sym = &perf_syms[lo - 1];
+	if (sym->kernel || (ip < sym->addr + sym->size))
+		return (uint32_t)(lo - 1);
+	return (uint32_t)perf_syms_num;
+}
+
+/*
+ *  stress_perf_sample_freq()
+ *	the IP sample ring buffer of an instance is only read when
+ *	the instance finishes and the kernel drops the samples that
+ *	do not fit, so lower the sample frequency to fit the samples
+ *	of a whole --timeout run into the ring buffer, leaving 25%
+ *	head room for the lost sample and frequency overshoot records
+ */
+static uint64_t stress_perf_sample_freq(void)
+{
+	const uint64_t samples = (STRESS_PERF_SAMPLE_PAGES * stress_get_pagesize()) /
+		STRESS_PERF_SAMPLE_SIZE;
+	uint64_t freq = STRESS_PERF_SAMPLE_FREQ;
+
+	if (g_opt_timeout && ((samples * 3) / 4) / g_opt_timeout < freq)
+		freq = ((samples * 3) / 4) / g_opt_timeout;
+
+	return freq < 1 ? 1 : freq;
+}
+
+/*
+ *  stress_perf_sample_init()
+ *	build the symbol table used to symbolize IP samples
+ */
+static void stress_perf_sample_init(void)
+{
+	char exe[PATH_MAX];
+	uint64_t exe_base;
+	ssize_t len;
+
+	len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len < 0)
+		len = 0;
+	exe[len] = '\0';
+
+	exe_base = stress_perf_sym_load_maps(exe);
+#if defined(HAVE_ELF_H) &&	\
+    defined(HAVE_LINK_H)
+	if (*exe)
+		stress_perf_sym_load_exe(exe, exe_base);
+#else
+	(void)exe_base;
+#endif
+	stress_perf_sym_load_kallsyms();
+
+	if (perf_syms_num)
+		qsort(perf_syms, perf_syms_num, sizeof(*perf_syms), stress_perf_sym_cmp);
+	pr_dbg("perf: %zu symbols loaded for IP sampling\n", perf_syms_num);
+	pr_dbg("perf: sampling at %" PRIu64 " Hz into a %d page ring buffer "
+		"per instance\n", stress_perf_sample_freq(), STRESS_PERF_SAMPLE_PAGES);
+}
+
+/*
+ *  stress_perf_sample_free()
+ *	free the IP sample symbol table
+ */
+void stress_perf_sample_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < perf_syms_num; i++)
+		free(perf_syms[i].name);
+	free(perf_syms);
+	perf_syms = NULL;
+	perf_syms_num = 0;
+	perf_syms_max = 0;
+}
+
 void stress_perf_init(void)
 {
 	size_t i;
@@ -328,6 +662,8 @@ void stress_perf_init(void)
 			stress_perf_type_tracepoint_resolve_config(&perf_info[i]);
 		}
 	}
+	if (g_opt_flags & OPT_FLAGS_PERF_SAMPLE)
+		stress_perf_sample_init();
 }
 
 static inline int stress_sys_perf_event_open(
@@ -340,6 +676,79 @@ static inline int stress_sys_perf_event_open(
 	return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
 }
 
+/*
+ *  Metrics derived from the perf counters, the per bogo op
+ *  metrics allow runs of the same stressor to be compared
+ *  across kernels, microcode revisions and machines
+ */
+static const stress_perf_derived_t perf_derived[] = {
+#if STRESS_PERF_DEFINED(HW_CPU_CYCLES) &&	\
+    STRESS_PERF_DEFINED(HW_INSTRUCTIONS)
+	{ PERF_DERIVED_HW(HW_INSTRUCTIONS), PERF_DERIVED_HW(HW_CPU_CYCLES),
+	  1.0, "Instructions Per Cycle", "instructions_per_cycle" },
+#endif
+#if STRESS_PERF_DEFINED(HW_BRANCH_INSTRUCTIONS) &&	\
+    STRESS_PERF_DEFINED(HW_BRANCH_MISSES)
+	{ PERF_DERIVED_HW(HW_BRANCH_MISSES), PERF_DERIVED_HW(HW_BRANCH_INSTRUCTIONS),
+	  100.0, "Branch Miss %", "branch_miss_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_REFERENCES) &&	\
+    STRESS_PERF_DEFINED(HW_CACHE_MISSES)
+	{ PERF_DERIVED_HW(HW_CACHE_MISSES), PERF_DERIVED_HW(HW_CACHE_REFERENCES),
+	  100.0, "Cache Miss %", "cache_miss_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_L1D)
+	{ PERF_DERIVED_HW_C(L1D, READ, MISS), PERF_DERIVED_HW_C(L1D, READ, ACCESS),
+	  100.0, "L1D Read Miss %", "l1d_read_miss_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_LL)
+	{ PERF_DERIVED_HW_C(LL, READ, MISS), PERF_DERIVED_HW_C(LL, READ, ACCESS),
+	  100.0, "LLC Read Miss %", "llc_read_miss_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_DTLB)
+	{ PERF_DERIVED_HW_C(DTLB, READ, MISS), PERF_DERIVED_HW_C(DTLB, READ, ACCESS),
+	  100.0, "DTLB Read Miss %", "dtlb_read_miss_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CPU_CYCLES) &&	\
+    STRESS_PERF_DEFINED(HW_STALLED_CYCLES_FRONTEND)
+	{ PERF_DERIVED_HW(HW_STALLED_CYCLES_FRONTEND), PERF_DERIVED_HW(HW_CPU_CYCLES),
+	  100.0, "Frontend Stall %", "frontend_stall_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CPU_CYCLES) &&	\
+    STRESS_PERF_DEFINED(HW_STALLED_CYCLES_BACKEND)
+	{ PERF_DERIVED_HW(HW_STALLED_CYCLES_BACKEND), PERF_DERIVED_HW(HW_CPU_CYCLES),
+	  100.0, "Backend Stall %", "backend_stall_percent" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CPU_CYCLES)
+	{ PERF_DERIVED_HW(HW_CPU_CYCLES), PERF_DERIVED_BOGO_OPS,
+	  1.0, "Cycles Per Bogo Op", "cpu_cycles_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_INSTRUCTIONS)
+	{ PERF_DERIVED_HW(HW_INSTRUCTIONS), PERF_DERIVED_BOGO_OPS,
+	  1.0, "Instructions Per Bogo Op", "instructions_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_BRANCH_MISSES)
+	{ PERF_DERIVED_HW(HW_BRANCH_MISSES), PERF_DERIVED_BOGO_OPS,
+	  1.0, "Branch Misses Per Bogo Op", "branch_misses_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_MISSES)
+	{ PERF_DERIVED_HW(HW_CACHE_MISSES), PERF_DERIVED_BOGO_OPS,
+	  1.0, "Cache Misses Per Bogo Op", "cache_misses_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_L1D)
+	{ PERF_DERIVED_HW_C(L1D, READ, MISS), PERF_DERIVED_BOGO_OPS,
+	  1.0, "L1D Misses Per Bogo Op", "l1d_read_misses_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_LL)
+	{ PERF_DERIVED_HW_C(LL, READ, MISS), PERF_DERIVED_BOGO_OPS,
+	  1.0, "LLC Misses Per Bogo Op", "llc_read_misses_per_bogo_op" },
+#endif
+#if STRESS_PERF_DEFINED(HW_CACHE_DTLB)
+	{ PERF_DERIVED_HW_C(DTLB, READ, MISS), PERF_DERIVED_BOGO_OPS,
+	  1.0, "DTLB Misses Per Bogo Op", "dtlb_read_misses_per_bogo_op" },
+#endif
+};
+
 /*
  *  stress_perf_yaml_label()
  *	turns text into a yaml compatible label.
@@ -370,44 +779,298 @@ static char *stress_perf_yaml_label(char *dst, const char *src, const size_t n)
 	return dst;
 }
 
+/*
+ *  stress_perf_sample_open()
+ *	open a CPU cycles (or CPU clock if there are no hardware
+ *	counters) sampling event with a ring buffer for IP samples.
+ *	The event is not inherited, so only the thread that runs the
+ *	stressor is sampled and not its child threads or processes.
+ */
+static void stress_perf_sample_open(stress_perf_t *sp)
+{
+	static const struct {
+		const uint32_t type;
+		const uint64_t config;
+	} events[] = {
+		{ PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CPU_CLOCK },
+	};
+	const size_t page_size = stress_get_pagesize();
+	const size_t sz = (STRESS_PERF_SAMPLE_PAGES + 1) * page_size;
+	const uint64_t freq = stress_perf_sample_freq();
+	size_t i;
+	void *buf;
+
+	sp->sample_fd = -1;
+	sp->sample_buf = NULL;
+
+	for (i = 0; (i < SIZEOF_ARRAY(events)) && (sp->sample_fd < 0); i++) {
+		struct perf_event_attr attr;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.size = sizeof(attr);
+		attr.freq = 1;
+		attr.sample_freq = freq;
+		attr.sample_type = PERF_SAMPLE_IP;
+		attr.disabled = 1;
+		attr.exclude_hv = 1;
+
+		sp->sample_fd = stress_sys_perf_event_open(&attr, 0, -1, -1, 0);
+		if ((sp->sample_fd < 0) && ((errno == EACCES) || (errno == EPERM))) {
+			/* Not allowed to sample the kernel, try user space only */
+			attr.exclude_kernel = 1;
+			sp->sample_fd = stress_sys_perf_event_open(&attr, 0, -1, -1, 0);
+		}
+	}
+	if (sp->sample_fd < 0)
+		return;
+
+	buf = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, sp->sample_fd, 0);
+	if (buf == MAP_FAILED) {
+		(void)close(sp->sample_fd);
+		sp->sample_fd = -1;
+		return;
+	}
+	sp->sample_buf = buf;
+}
+
+/*
+ *  stress_perf_sample_top()
+ *	keep the STRESS_PERF_SAMPLE_TOP symbols with the most samples
+ */
+static void stress_perf_sample_top(
+	stress_perf_sample_t *samples,
+	const uint32_t *counts,
+	const size_t n)
+{
+	size_t i;
+
+	(void)memset(samples, 0, sizeof(*samples) * STRESS_PERF_SAMPLE_TOP);
+	for (i = 0; i < n; i++) {
+		size_t j, min = 0;
+
+		if (!counts[i])
+			continue;
+		for (j = 1; j < STRESS_PERF_SAMPLE_TOP; j++) {
+			if (samples[j].count < samples[min].count)
+				min = j;
+		}
+		if (counts[i] > samples[min].count) {
+			samples[min].sym = (uint32_t)i;
+			samples[min].count = counts[i];
+		}
+	}
+}
+
+/*
+ *  stress_perf_sample_close()
+ *	read the IP samples from the ring buffer, account
+ *	them to symbols and close the sampling event
+ */
+static void stress_perf_sample_close(stress_perf_t *sp)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t sz = (STRESS_PERF_SAMPLE_PAGES + 1) * page_size;
+	const uint64_t mask = (STRESS_PERF_SAMPLE_PAGES * page_size) - 1;
+	struct perf_event_mmap_page *meta;
+	const uint8_t *data;
+	uint64_t head, tail;
+	uint32_t *counts;
+
+	if (!sp->sample_buf)
+		goto close_fd;
+
+	counts = calloc(perf_syms_num + 1, sizeof(*counts));
+	if (!counts)
+		goto unmap;
+
+	meta = (struct perf_event_mmap_page *)sp->sample_buf;
+	data = (const uint8_t *)sp->sample_buf + page_size;
+	head = meta->data_head;
+	shim_mb();
+	tail = meta->data_tail;
+
+	while (tail < head) {
+		struct perf_event_header hdr;
+		uint64_t rec[STRESS_PERF_SAMPLE_REC_MAX];
+		size_t i;
+
+		for (i = 0; i < sizeof(hdr); i++)
+			((uint8_t *)&hdr)[i] = data[(tail + i) & mask];
+		if ((hdr.size < sizeof(hdr)) || (tail + hdr.size > head))
+			break;
+		if (hdr.size <= sizeof(rec)) {
+			for (i = 0; i < hdr.size; i++)
+				((uint8_t *)rec)[i] = data[(tail + i) & mask];
+
+			/* rec[0] is the header */
+			if (hdr.type == PERF_RECORD_SAMPLE) {
+				counts[stress_perf_sym_lookup(rec[1])]++;
+				sp->sample_total++;
+			} else if (hdr.type == PERF_RECORD_LOST) {
+				sp->sample_lost += rec[2];
+			}
+		}
+		tail += hdr.size;
+	}
+	meta->data_tail = tail;
+
+	stress_perf_sample_top(sp->samples, counts, perf_syms_num + 1);
+	free(counts);
+unmap:
+	(void)munmap(sp->sample_buf, sz);
+	sp->sample_buf = NULL;
+close_fd:
+	if (sp->sample_fd > -1)
+		(void)close(sp->sample_fd);
+	sp->sample_fd = -1;
+}
+
+/*
+ *  stress_perf_set_events()
+ *	select the perf events to gather from a comma separated
+ *	list of event names, these are the names used in the
+ *	YAML output, e.g. cpu_cycles,instructions
+ */
+int stress_perf_set_events(const char *arg)
+{
+	char *str, *ptr, *token;
+	int p;
+
+	str = stress_const_optdup(arg);
+	if (!str) {
+		(void)fprintf(stderr, "out of memory duplicating argument '%s'\n", arg);
+		return -1;
+	}
+
+	(void)memset(perf_selected, 0, sizeof(perf_selected));
+	for (ptr = str; (token = strtok(ptr, ",")) != NULL; ptr = NULL) {
+		bool found = false;
+
+		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+			char name[128];
+
+			stress_perf_yaml_label(name, perf_info[p].label, sizeof(name));
+			if (!strcmp(name, token)) {
+				perf_selected[p] = true;
+				found = true;
+			}
+		}
+		if (!found) {
+			(void)fprintf(stderr, "perf-events: invalid event '%s', "
+				"event must be one of:", token);
+			for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+				char name[128];
+
+				stress_perf_yaml_label(name, perf_info[p].label, sizeof(name));
+				(void)fprintf(stderr, " %s", name);
+			}
+			(void)fprintf(stderr, "\n");
+			free(str);
+			return -1;
+		}
+	}
+	free(str);
+
+	perf_select = true;
+	g_opt_flags |= OPT_FLAGS_PERF_STATS;
+
+	return 0;
+}
+
+/*
+ *  stress_perf_group_max()
+ *	maximum number of events in a group of a given perf type,
+ *	hardware groups are kept small enough to fit onto the
+ *	PMU counters of most CPUs so that they are not multiplexed
+ */
+static inline int stress_perf_group_max(const unsigned long type)
+{
+	return ((type == PERF_TYPE_HARDWARE) || (type == PERF_TYPE_HW_CACHE)) ?
+		STRESS_PERF_GROUP_HW_MAX : STRESS_PERF_GROUP_MAX;
+}
+
+/*
+ *  stress_perf_same_group()
+ *	can events of perf types t1 and t2 be in the same group?
+ */
+static inline bool stress_perf_same_group(const unsigned long t1, const unsigned long t2)
+{
+	if (t1 == PERF_TYPE_HW_CACHE)
+		return (t2 == PERF_TYPE_HARDWARE) || (t2 == PERF_TYPE_HW_CACHE);
+	if (t1 == PERF_TYPE_HARDWARE)
+		return (t2 == PERF_TYPE_HARDWARE) || (t2 == PERF_TYPE_HW_CACHE);
+	return t1 == t2;
+}
+
 /*
  *  stress_perf_open()
- *	open perf, get leader and perf fd's
+ *	open perf, get leader and perf fd's. Events are opened
+ *	in groups of the same perf type so that the events of
+ *	a group are scheduled onto the PMU together and can be
+ *	read in one go by reading the group leader
  */
 int stress_perf_open(stress_perf_t *sp)
 {
 	size_t i;
+	int leader = -1, group_size = 0;
 
 	if (!sp)
 		return -1;
-	if (g_shared->perf.no_perf)
-		return -1;
 
 	(void)memset(sp, 0, sizeof(*sp));
 	sp->perf_opened = 0;
+	sp->sample_fd = -1;
 
 	for (i = 0; i < STRESS_PERF_MAX; i++) {
 		sp->perf_stat[i].fd = -1;
+		sp->perf_stat[i].leader = -1;
 		sp->perf_stat[i].counter = 0;
 	}
+	if (g_opt_flags & OPT_FLAGS_PERF_SAMPLE)
+		stress_perf_sample_open(sp);
+	if (g_shared->perf.no_perf)
+		return -1;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
-		if (perf_info[i].config != UNRESOLVED) {
-			struct perf_event_attr attr;
-
-			(void)memset(&attr, 0, sizeof(attr));
-			attr.type = perf_info[i].type;
-			attr.config = perf_info[i].config;
-			attr.disabled = 1;
-			attr.inherit = 1;
-			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
-					   PERF_FORMAT_TOTAL_TIME_RUNNING;
-			attr.size = sizeof(attr);
-			sp->perf_stat[i].fd =
-				stress_sys_perf_event_open(&attr, 0, -1, -1, 0);
-			if (sp->perf_stat[i].fd > -1)
-				sp->perf_opened++;
+		struct perf_event_attr attr;
+		int fd;
+
+		if (perf_info[i].config == UNRESOLVED)
+			continue;
+		if (perf_select && !perf_selected[i])
+			continue;
+
+		/* Start a new group? */
+		if ((leader >= 0) &&
+		    (!stress_perf_same_group(perf_info[leader].type, perf_info[i].type) ||
+		     (group_size >= stress_perf_group_max(perf_info[leader].type))))
+			leader = -1;
+
+		(void)memset(&attr, 0, sizeof(attr));
+		attr.type = perf_info[i].type;
+		attr.config = perf_info[i].config;
+		attr.disabled = (leader < 0);
+		attr.inherit = 1;
+		attr.read_format = PERF_FORMAT_GROUP |
+				   PERF_FORMAT_TOTAL_TIME_ENABLED |
+				   PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.size = sizeof(attr);
+		fd = stress_sys_perf_event_open(&attr, 0, -1,
+			(leader < 0) ? -1 : sp->perf_stat[leader].fd, 0);
+		if (fd < 0)
+			continue;
+
+		if (leader < 0) {
+			leader = (int)i;
+			group_size = 0;
 		}
+		sp->perf_stat[i].fd = fd;
+		sp->perf_stat[i].leader = leader;
+		sp->perf_opened++;
+		group_size++;
 	}
 	if (!sp->perf_opened) {
 		int ret;
@@ -435,6 +1098,23 @@ int stress_perf_open(stress_perf_t *sp)
 	return 0;
 }
 
+/*
+ *  stress_perf_close_group()
+ *	close all the counters of the group of a leader
+ */
+static void stress_perf_close_group(stress_perf_t *sp, const int leader)
+{
+	size_t i;
+
+	for (i = (size_t)leader; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if (sp->perf_stat[i].leader != leader)
+			continue;
+		if (sp->perf_stat[i].fd > -1)
+			(void)close(sp->perf_stat[i].fd);
+		sp->perf_stat[i].fd = -1;
+	}
+}
+
 /*
  *  stress_perf_enable()
  *	enable perf counters
@@ -445,25 +1125,19 @@ int stress_perf_enable(stress_perf_t *sp)
 
 	if (!sp)
 		return -1;
+	if (sp->sample_fd > -1)
+		(void)ioctl(sp->sample_fd, PERF_EVENT_IOC_ENABLE, 0);
 	if (!sp->perf_opened)
 		return 0;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
-		if (fd > -1) {
-			if (ioctl(fd, PERF_EVENT_IOC_RESET,
-				  PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-				continue;
-			}
-			if (ioctl(fd, PERF_EVENT_IOC_ENABLE,
-				  PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-			}
-		}
+		if ((fd < 0) || (sp->perf_stat[i].leader != (int)i))
+			continue;
+		if ((ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) < 0) ||
+		    (ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) < 0))
+			stress_perf_close_group(sp, (int)i);
 	}
 	return 0;
 }
@@ -478,23 +1152,66 @@ int stress_perf_disable(stress_perf_t *sp)
 
 	if (!sp)
 		return -1;
+	if (sp->sample_fd > -1)
+		(void)ioctl(sp->sample_fd, PERF_EVENT_IOC_DISABLE, 0);
 	if (!sp->perf_opened)
 		return 0;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		int fd = sp->perf_stat[i].fd;
 
-		if (fd > -1) {
-			if (ioctl(fd, PERF_EVENT_IOC_DISABLE,
-			          PERF_IOC_FLAG_GROUP) < 0) {
-				(void)close(fd);
-				sp->perf_stat[i].fd = -1;
-			}
-		}
+		if ((fd < 0) || (sp->perf_stat[i].leader != (int)i))
+			continue;
+		if (ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) < 0)
+			stress_perf_close_group(sp, (int)i);
 	}
 	return 0;
 }
 
+/*
+ *  stress_perf_read_group()
+ *	read all the counters of the group of a leader, the
+ *	counters are scaled by time enabled / time running
+ *	to estimate the counts had the group not been
+ *	multiplexed with other groups
+ */
+static void stress_perf_read_group(stress_perf_t *sp, const int leader)
+{
+	stress_perf_data_t data;
+	ssize_t ret;
+	size_t i, n = 0;
+	double scale;
+
+	(void)memset(&data, 0, sizeof(data));
+	ret = read(sp->perf_stat[leader].fd, &data, sizeof(data));
+	if (ret < (ssize_t)(3 * sizeof(uint64_t)))
+		data.nr = 0;
+
+	/* Ensure we don't get division by zero */
+	if (data.time_running == 0) {
+		scale = (data.time_enabled == 0) ? 1.0 : 0.0;
+	} else {
+		scale = (double)data.time_enabled /
+			data.time_running;
+	}
+
+	/* Group members are read back in the order they were opened */
+	for (i = (size_t)leader; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		stress_perf_stat_t *ps = &sp->perf_stat[i];
+
+		if ((ps->leader != leader) || (ps->fd < 0))
+			continue;
+		if (n < data.nr) {
+			ps->counter = (uint64_t)((double)data.counter[n] * scale);
+			ps->time_enabled = data.time_enabled;
+			ps->time_running = data.time_running;
+		} else {
+			ps->counter = STRESS_PERF_INVALID;
+		}
+		n++;
+	}
+}
+
 /*
  *  stress_perf_close()
  *	read counters and close
@@ -502,38 +1219,24 @@ int stress_perf_disable(stress_perf_t *sp)
 int stress_perf_close(stress_perf_t *sp)
 {
 	size_t i = 0;
-	stress_perf_data_t data;
-	ssize_t ret;
-	double scale;
 
 	if (!sp)
 		return -1;
+	if (sp->sample_fd > -1)
+		stress_perf_sample_close(sp);
 	if (!sp->perf_opened)
 		goto out_ok;
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
-		int fd = sp->perf_stat[i].fd;
-		if (fd < 0 ) {
+		if ((sp->perf_stat[i].fd > -1) && (sp->perf_stat[i].leader == (int)i))
+			stress_perf_read_group(sp, (int)i);
+	}
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if (sp->perf_stat[i].fd < 0) {
 			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
 			continue;
 		}
-
-		(void)memset(&data, 0, sizeof(data));
-		ret = read(fd, &data, sizeof(data));
-		if (ret != sizeof(data))
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
-		else {
-			/* Ensure we don't get division by zero */
-			if (data.time_running == 0) {
-				scale = (data.time_enabled == 0) ? 1.0 : 0.0;
-			} else {
-				scale = (double)data.time_enabled /
-					data.time_running;
-			}
-			sp->perf_stat[i].counter = (uint64_t)
-				((double)data.counter * scale);
-		}
-		(void)close(fd);
+		(void)close(sp->perf_stat[i].fd);
 		sp->perf_stat[i].fd = -1;
 	}
 
@@ -550,7 +1253,7 @@ out_ok:
  */
 bool stress_perf_stat_succeeded(const stress_perf_t *sp)
 {
-	return sp->perf_opened > 0;
+	return sp && (sp->perf_opened > 0);
 }
 
 /*
@@ -583,6 +1286,94 @@ static const char *stress_perf_stat_scale(const uint64_t counter, const double d
 	return buffer;
 }
 
+/*
+ *  stress_perf_derived_total()
+ *	find the total of a perf counter of a given type and config,
+ *	STRESS_PERF_INVALID if the counter was not read
+ */
+static uint64_t stress_perf_derived_total(
+	const uint64_t counter_totals[],
+	const uint64_t bogo_ops,
+	const unsigned long type,
+	const unsigned long config)
+{
+	int p;
+
+	if (type == PERF_TYPE_BOGO_OPS)
+		return bogo_ops;
+
+	for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
+		if ((perf_info[p].type == type) &&
+		    (perf_info[p].config == config))
+			return counter_totals[p];
+	}
+	return STRESS_PERF_INVALID;
+}
+
+/*
+ *  stress_perf_derived_dump()
+ *	dump the metrics derived from the counter totals of a stressor
+ */
+static void stress_perf_derived_dump(
+	FILE *yaml,
+	const uint64_t counter_totals[],
+	const uint64_t bogo_ops)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_derived); i++) {
+		const stress_perf_derived_t *d = &perf_derived[i];
+		const uint64_t ct = stress_perf_derived_total(counter_totals,
+			bogo_ops, d->type, d->config);
+		const uint64_t per = stress_perf_derived_total(counter_totals,
+			bogo_ops, d->per_type, d->per_config);
+		double metric;
+
+		if ((ct == STRESS_PERF_INVALID) ||
+		    (per == STRESS_PERF_INVALID) || (per == 0))
+			continue;
+
+		metric = d->scale * (double)ct / (double)per;
+		pr_inf("%'26.3f %-24s\n", metric, d->label);
+		stress_report_double(yaml, d->yaml_label, metric);
+	}
+}
+
+/*
+ *  stress_perf_stat_total()
+ *	get the label of perf event p and the total count of the
+ *	event over all instances of a stressor, total is set to
+ *	STRESS_PERF_INVALID if it could not be counted. Returns
+ *	false if there is no perf event p.
+ */
+bool stress_perf_stat_total(
+	const stress_stressor_t *ss,
+	const size_t p,
+	char *label,
+	const size_t label_len,
+	uint64_t *total)
+{
+	int32_t j;
+
+	if ((p >= STRESS_PERF_MAX) || !perf_info[p].label)
+		return false;
+
+	(void)stress_perf_yaml_label(label, perf_info[p].label, label_len);
+	*total = 0;
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_perf_t *sp = ss->stats[j]->sp;
+
+		if (!stress_perf_stat_succeeded(sp))
+			continue;
+		if (sp->perf_stat[p].counter == STRESS_PERF_INVALID) {
+			*total = STRESS_PERF_INVALID;
+			break;
+		}
+		*total += sp->perf_stat[p].counter;
+	}
+	return true;
+}
+
 void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const double duration)
 {
 	bool no_perf_stats = true;
@@ -592,35 +1383,46 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 	(void)setlocale(LC_ALL, "");
 #endif
 
-	pr_yaml(yaml, "perfstats:\n");
+	stress_report_list(yaml, "perfstats");
 
 	for (ss = stressors_list; ss; ss = ss->next) {
 		int p;
 		uint64_t counter_totals[STRESS_PERF_MAX];
+		uint64_t time_enabled[STRESS_PERF_MAX];
+		uint64_t time_running[STRESS_PERF_MAX];
 		uint64_t total_cpu_cycles = 0;
 		uint64_t total_cache_refs = 0;
 		uint64_t total_branches = 0;
+		uint64_t bogo_ops = 0;
+		int32_t j;
 		bool got_data = false;
 		char *munged;
 
 		(void)memset(counter_totals, 0, sizeof(counter_totals));
+		(void)memset(time_enabled, 0, sizeof(time_enabled));
+		(void)memset(time_running, 0, sizeof(time_running));
+
+		for (j = 0; j < ss->started_instances; j++)
+			bogo_ops += ss->stats[j]->counter;
 
 		/* Sum totals across all instances of the stressor */
 		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
-			int32_t j;
-			stress_perf_t *sp = &ss->stats[0]->sp;
+			for (j = 0; j < ss->started_instances; j++) {
+				const stress_perf_t *sp = ss->stats[j]->sp;
+				uint64_t counter;
 
-			if (!stress_perf_stat_succeeded(sp))
-				continue;
+				if (!stress_perf_stat_succeeded(sp))
+					continue;
 
-			for (j = 0; j < ss->started_instances; j++) {
-				const uint64_t counter = sp->perf_stat[p].counter;
+				counter = sp->perf_stat[p].counter;
 
 				if (counter == STRESS_PERF_INVALID) {
 					counter_totals[p] = STRESS_PERF_INVALID;
 					break;
 				}
 				counter_totals[p] += counter;
+				time_enabled[p] += sp->perf_stat[p].time_enabled;
+				time_running[p] += sp->perf_stat[p].time_running;
 				got_data |= (counter > 0);
 			}
 			if (perf_info[p].type == PERF_TYPE_HARDWARE) {
@@ -640,8 +1442,8 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 
 		munged = stress_munge_underscore(ss->stressor->name);
 		pr_inf("%s:\n", munged);
-		pr_yaml(yaml, "    - stressor: %s\n", munged);
-		pr_yaml(yaml, "      duration: %f\n", duration);
+		stress_report_item(yaml, "stressor", munged);
+		stress_report_double(yaml, "duration", duration);
 
 		for (p = 0; p < STRESS_PERF_MAX && perf_info[p].label; p++) {
 			const char *l = perf_info[p].label;
@@ -649,8 +1451,19 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 
 			if (l && (ct != STRESS_PERF_INVALID)) {
 				char extra[32];
+				char mux[32];
 				char yaml_label[128];
+				char key[160];
+				/* Less than 100% running means the group was multiplexed */
+				const bool multiplexed = time_running[p] < time_enabled[p];
+				const double running = time_enabled[p] ?
+					100.0 * (double)time_running[p] / (double)time_enabled[p] : 100.0;
+
 				*extra = '\0';
+				*mux = '\0';
+				if (multiplexed)
+					(void)snprintf(mux, sizeof(mux),
+						" [multiplexed %.2f%%]", running);
 
 				no_perf_stats = false;
 
@@ -673,19 +1486,26 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 							100.0 * (double)ct / (double)total_branches);
 				}
 
-				pr_inf("%'26" PRIu64 " %-24s %s%s\n",
+				pr_inf("%'26" PRIu64 " %-24s %s%s%s\n",
 					ct, l, stress_perf_stat_scale(ct, duration),
-					extra);
+					extra, mux);
 
 				stress_perf_yaml_label(yaml_label, l, sizeof(yaml_label));
-				pr_yaml(yaml, "      %s_total: %" PRIu64
-					"\n", yaml_label, ct);
-				pr_yaml(yaml, "      %s_per_second: %f\n",
-					yaml_label, (double)ct / duration);
+				(void)snprintf(key, sizeof(key), "%s_total", yaml_label);
+				stress_report_uint64(yaml, key, ct);
+				(void)snprintf(key, sizeof(key), "%s_per_second", yaml_label);
+				stress_report_double(yaml, key, (double)ct / duration);
+				if (multiplexed) {
+					(void)snprintf(key, sizeof(key),
+						"%s_running_percent", yaml_label);
+					stress_report_double(yaml, key, running);
+				}
 			}
 		}
-		pr_yaml(yaml, "\n");
+		stress_report_uint64(yaml, "bogo_ops", bogo_ops);
+		stress_perf_derived_dump(yaml, counter_totals, bogo_ops);
 	}
+	stress_report_end(yaml);
 	if (no_perf_stats) {
 		if (geteuid() != 0) {
 			char buffer[64];
@@ -711,4 +1531,97 @@ void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *stressors_list, const
 		}
 	}
 }
+
+/*
+ *  stress_perf_sample_cmp()
+ *	sort samples into descending sample count order
+ */
+static int stress_perf_sample_cmp(const void *p1, const void *p2)
+{
+	const stress_perf_sample_t *s1 = (const stress_perf_sample_t *)p1;
+	const stress_perf_sample_t *s2 = (const stress_perf_sample_t *)p2;
+
+	if (s1->count > s2->count)
+		return -1;
+	if (s1->count < s2->count)
+		return 1;
+	return 0;
+}
+
+/*
+ *  stress_perf_sample_dump()
+ *	dump the hottest user and kernel symbols of each stressor
+ */
+void stress_perf_sample_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool no_samples = true;
+
+	pr_yaml(yaml, "perf-samples:\n");
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_perf_sample_t samples[STRESS_PERF_SAMPLE_TOP * 4];
+		uint64_t total = 0, lost = 0;
+		size_t i, n = 0;
+		int32_t j;
+		char *munged;
+
+		/* Merge the hottest symbols of all the instances */
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_perf_t *sp = ss->stats[j]->sp;
+
+			if (!sp)
+				continue;
+			total += sp->sample_total;
+			lost += sp->sample_lost;
+			for (i = 0; i < STRESS_PERF_SAMPLE_TOP; i++) {
+				const stress_perf_sample_t *s = &sp->samples[i];
+				size_t k;
+
+				if (!s->count)
+					continue;
+				for (k = 0; k < n; k++) {
+					if (samples[k].sym == s->sym) {
+						samples[k].count += s->count;
+						break;
+					}
+				}
+				if ((k == n) && (n < SIZEOF_ARRAY(samples)))
+					samples[n++] = *s;
+			}
+		}
+		if (!total)
+			continue;
+
+		no_samples = false;
+		qsort(samples, n, sizeof(*samples), stress_perf_sample_cmp);
+
+		munged = stress_munge_underscore(ss->stressor->name);
+		pr_inf("%s: %" PRIu64 " IP samples, %" PRIu64 " lost\n",
+			munged, total, lost);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      samples: %" PRIu64 "\n", total);
+		pr_yaml(yaml, "      samples-lost: %" PRIu64 "\n", lost);
+		pr_yaml(yaml, "      symbols:\n");
+
+		for (i = 0; (i < n) && (i < STRESS_PERF_SAMPLE_SHOW); i++) {
+			const uint32_t sym = samples[i].sym;
+			const bool known = sym < perf_syms_num;
+			const char *name = known ? perf_syms[sym].name : "[unknown]";
+			const char *space = known ?
+				(perf_syms[sym].kernel ? "kernel" : "user") : "unknown";
+			const double percent = 100.0 * (double)samples[i].count / (double)total;
+
+			pr_inf("%26.2f%% %-40.40s [%s]\n", percent, name, space);
+			pr_yaml(yaml, "        - symbol: %s\n", name);
+			pr_yaml(yaml, "          space: %s\n", space);
+			pr_yaml(yaml, "          samples: %" PRIu32 "\n", samples[i].count);
+			pr_yaml(yaml, "          percent: %f\n", percent);
+		}
+		pr_yaml(yaml, "\n");
+	}
+
+	if (no_samples)
+		pr_inf("perf IP samples not available\n");
+}
 #endif
@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define PSI_SOURCES_MAX		(6)
+#define PSI_PERIOD_DEFAULT	(1.0)	/* secs, if --interval is not used */
+
+/* A pressure stall information file, e.g. /proc/pressure/io */
+typedef struct {
+	char name[16];			/* source name, e.g. cgroup-io */
+	char path[PATH_MAX];		/* pressure file path */
+	uint64_t some;			/* some stall total in usecs */
+	uint64_t full;			/* full stall total in usecs */
+	uint64_t some_start;		/* some stall total at start of run */
+	uint64_t full_start;		/* full stall total at start of run */
+	double some_max;		/* peak some stall % of a period */
+	double full_max;		/* peak full stall % of a period */
+} stress_psi_source_t;
+
+/* Stalls while a stressor was running, over all of its runs */
+typedef struct {
+	double some[PSI_SOURCES_MAX];	/* some stall time in secs */
+	double full[PSI_SOURCES_MAX];	/* full stall time in secs */
+	double some_max[PSI_SOURCES_MAX]; /* peak some stall % */
+	double full_max[PSI_SOURCES_MAX]; /* peak full stall % */
+} stress_psi_result_t;
+
+/* Stall percentages of all the sources over one --interval period */
+typedef struct {
+	uint32_t run;			/* run number, 0 = first */
+	double time;			/* end of period, secs since start */
+	double some[PSI_SOURCES_MAX];	/* some stall % */
+	double full[PSI_SOURCES_MAX];	/* full stall % */
+} stress_psi_sample_t;
+
+static const char * const psi_resources[] = { "cpu", "memory", "io" };
+
+static stress_psi_source_t psi_sources[PSI_SOURCES_MAX];
+static size_t psi_sources_num;
+static stress_results_t psi_results = {
+	"psi", "stalls", sizeof(stress_psi_result_t), NULL, 0
+};
+static stress_psi_sample_t *psi_samples;
+static size_t psi_samples_num;
+static uint32_t psi_runs;
+static double psi_period;
+static double psi_time_start;
+static double psi_time_last;
+static double psi_time_next;
+static bool psi_interval;
+static bool psi_running;
+
+/*
+ *  stress_psi_read()
+ *	read the some and full stall totals of a pressure
+ *	file, cpu pressure on older kernels has no full line
+ */
+static bool stress_psi_read(const char *path, uint64_t *some, uint64_t *full)
+{
+	FILE *fp;
+	char buf[256];
+	bool got_some = false;
+
+	*full = 0;
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		const char *ptr = strstr(buf, "total=");
+		uint64_t total;
+
+		if (!ptr || (sscanf(ptr + 6, "%" SCNu64, &total) != 1))
+			continue;
+		if (!strncmp(buf, "some", 4)) {
+			*some = total;
+			got_some = true;
+		} else if (!strncmp(buf, "full", 4)) {
+			*full = total;
+		}
+	}
+	(void)fclose(fp);
+
+	return got_some;
+}
+
+/*
+ *  stress_psi_add()
+ *	add a pressure file if it can be read
+ */
+static void stress_psi_add(const char *name, const char *path)
+{
+	stress_psi_source_t *src = &psi_sources[psi_sources_num];
+
+	if (psi_sources_num >= PSI_SOURCES_MAX)
+		return;
+	if (!stress_psi_read(path, &src->some, &src->full))
+		return;
+	(void)shim_strlcpy(src->name, name, sizeof(src->name));
+	(void)shim_strlcpy(src->path, path, sizeof(src->path));
+	psi_sources_num++;
+}
+
+/*
+ *  stress_psi_cgroup()
+ *	find the cgroup v2 path of stress-ng, false if
+ *	it is not in a cgroup other than the root cgroup
+ */
+static bool stress_psi_cgroup(char *path, const size_t len)
+{
+	FILE *fp;
+	char buf[PATH_MAX];
+	bool found = false;
+
+	if ((fp = fopen("/proc/self/cgroup", "r")) == NULL)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (strncmp(buf, "0::", 3))
+			continue;
+		buf[strcspn(buf, "\n")] = '\0';
+		if (strcmp(buf + 3, "/")) {
+			(void)shim_strlcpy(path, buf + 3, len);
+			found = true;
+		}
+		break;
+	}
+	(void)fclose(fp);
+
+	return found;
+}
+
+/*
+ *  stress_psi_init()
+ *	find the system wide and cgroup pressure stall
+ *	information files for --psi, returns -1 if the
+ *	kernel does not provide pressure stall information
+ */
+int stress_psi_init(void)
+{
+	char cgroup[PATH_MAX / 2], name[16], path[PATH_MAX];
+	uint64_t interval = 0;
+	size_t i;
+
+	if (!(g_opt_flags & OPT_FLAGS_PSI))
+		return 0;
+
+	for (i = 0; i < SIZEOF_ARRAY(psi_resources); i++) {
+		(void)snprintf(path, sizeof(path), "/proc/pressure/%s", psi_resources[i]);
+		stress_psi_add(psi_resources[i], path);
+	}
+	if (!psi_sources_num) {
+		pr_inf("psi: pressure stall information not available\n");
+		return -1;
+	}
+
+	if (stress_psi_cgroup(cgroup, sizeof(cgroup))) {
+		for (i = 0; i < SIZEOF_ARRAY(psi_resources); i++) {
+			const size_t n = psi_sources_num;
+
+			(void)snprintf(name, sizeof(name), "cgroup-%s", psi_resources[i]);
+			(void)snprintf(path, sizeof(path), "/sys/fs/cgroup%s/%s.pressure",
+				cgroup, psi_resources[i]);
+			stress_psi_add(name, path);
+			if (n != psi_sources_num)
+				continue;
+			/* hybrid hierarchy, cgroup v2 is mounted on unified */
+			(void)snprintf(path, sizeof(path), "/sys/fs/cgroup/unified%s/%s.pressure",
+				cgroup, psi_resources[i]);
+			stress_psi_add(name, path);
+		}
+	}
+
+	(void)stress_get_setting("interval", &interval);
+	psi_interval = (interval > 0);
+	psi_period = psi_interval ? (double)interval : PSI_PERIOD_DEFAULT;
+
+	return 0;
+}
+
+/*
+ *  stress_psi_active()
+ *	true if pressure stall information is being sampled
+ */
+bool stress_psi_active(void)
+{
+	return psi_running;
+}
+
+/*
+ *  stress_psi_start()
+ *	start sampling pressure stall information for a run
+ */
+void stress_psi_start(void)
+{
+	size_t i;
+
+	if (!psi_sources_num)
+		return;
+
+	for (i = 0; i < psi_sources_num; i++) {
+		stress_psi_source_t *src = &psi_sources[i];
+
+		(void)stress_psi_read(src->path, &src->some, &src->full);
+		src->some_start = src->some;
+		src->full_start = src->full;
+		src->some_max = 0.0;
+		src->full_max = 0.0;
+	}
+	psi_time_start = stress_time_now();
+	psi_time_last = psi_time_start;
+	psi_time_next = psi_time_start + psi_period;
+	psi_running = true;
+}
+
+/*
+ *  stress_psi_percent()
+ *	stall time in usecs as a percentage of duration secs
+ */
+static inline double stress_psi_percent(
+	const uint64_t stall_start,
+	const uint64_t stall_end,
+	const double duration)
+{
+	double percent;
+
+	if ((duration <= 0.0) || (stall_end < stall_start))
+		return 0.0;
+	/* Clamp the jitter between reading the time and the totals */
+	percent = (double)(stall_end - stall_start) / (duration * 10000.0);
+	return (percent > 100.0) ? 100.0 : percent;
+}
+
+/*
+ *  stress_psi_sample()
+ *	sample the stall totals and track the peak stall
+ *	percentages of the period since the last sample
+ */
+static void stress_psi_sample(const double now, stress_psi_sample_t *sample)
+{
+	const double duration = now - psi_time_last;
+	size_t i;
+
+	for (i = 0; i < psi_sources_num; i++) {
+		stress_psi_source_t *src = &psi_sources[i];
+		uint64_t some, full;
+		double some_pc, full_pc;
+
+		if (!stress_psi_read(src->path, &some, &full))
+			continue;
+		some_pc = stress_psi_percent(src->some, some, duration);
+		full_pc = stress_psi_percent(src->full, full, duration);
+		if (some_pc > src->some_max)
+			src->some_max = some_pc;
+		if (full_pc > src->full_max)
+			src->full_max = full_pc;
+		src->some = some;
+		src->full = full;
+		if (sample) {
+			sample->some[i] = some_pc;
+			sample->full[i] = full_pc;
+		}
+	}
+	psi_time_last = now;
+}
+
+/*
+ *  stress_psi_tick()
+ *	if a sample is due, sample the stall totals, with
+ *	--interval the stall percentages of each interval
+ *	are reported too
+ */
+void stress_psi_tick(const double now)
+{
+	stress_psi_sample_t sample, *new_samples;
+	char buf[256];
+	size_t i, len = 0;
+
+	if (!psi_running || (now < psi_time_next))
+		return;
+	while (psi_time_next <= now)
+		psi_time_next += psi_period;
+
+	if (!psi_interval) {
+		stress_psi_sample(now, NULL);
+		return;
+	}
+
+	(void)memset(&sample, 0, sizeof(sample));
+	sample.run = psi_runs;
+	sample.time = now - psi_time_start;
+	stress_psi_sample(now, &sample);
+
+	*buf = '\0';
+	for (i = 0; i < psi_sources_num; i++) {
+		const int n = snprintf(buf + len, sizeof(buf) - len,
+			" %s %.2f%%/%.2f%%", psi_sources[i].name,
+			sample.some[i], sample.full[i]);
+
+		if ((n < 0) || ((size_t)n >= sizeof(buf) - len))
+			break;
+		len += (size_t)n;
+	}
+	pr_inf("%-13s %9.2f some/full stall:%s\n", "psi", sample.time, buf);
+
+	new_samples = realloc(psi_samples, (psi_samples_num + 1) * sizeof(*psi_samples));
+	if (!new_samples) {
+		pr_dbg("cannot allocate psi sample, psi interval metrics will be incomplete\n");
+		return;
+	}
+	psi_samples = new_samples;
+	psi_samples[psi_samples_num++] = sample;
+}
+
+/*
+ *  stress_psi_stop()
+ *	stop sampling and charge the stalls of the run to each
+ *	stressor in the run, stressors run in parallel all share
+ *	the same stalls
+ */
+void stress_psi_stop(stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	const double now = stress_time_now();
+
+	if (!psi_running)
+		return;
+	psi_running = false;
+	psi_runs++;
+
+	/* A final partial period is too short to give a meaningful peak */
+	if (now - psi_time_last >= psi_period * 0.5) {
+		stress_psi_sample(now, NULL);
+	} else {
+		size_t i;
+
+		for (i = 0; i < psi_sources_num; i++) {
+			stress_psi_source_t *src = &psi_sources[i];
+
+			(void)stress_psi_read(src->path, &src->some, &src->full);
+		}
+	}
+
+	if (!stress_results_charge(&psi_results, stressors_list,
+				   now - psi_time_start))
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_result_t *result =
+			stress_results_find(&psi_results, ss);
+		stress_psi_result_t *psi = result->data;
+		size_t i;
+
+		for (i = 0; i < psi_sources_num; i++) {
+			const stress_psi_source_t *src = &psi_sources[i];
+
+			if (src->some >= src->some_start)
+				psi->some[i] += (double)(src->some - src->some_start) / 1000000.0;
+			if (src->full >= src->full_start)
+				psi->full[i] += (double)(src->full - src->full_start) / 1000000.0;
+			if (src->some_max > psi->some_max[i])
+				psi->some_max[i] = src->some_max;
+			if (src->full_max > psi->full_max[i])
+				psi->full_max[i] = src->full_max;
+		}
+	}
+}
+
+/*
+ *  stress_psi_dump()
+ *	report the mean and peak some and full stall percentages
+ *	of each stressor and the stall percentages of each interval
+ */
+void stress_psi_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false;
+	size_t i, j;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		const stress_result_t *result =
+			stress_results_find(&psi_results, ss);
+		const stress_psi_result_t *psi;
+
+		if (!result || (result->duration <= 0.0))
+			continue;
+		psi = result->data;
+
+		if (!heading) {
+			pr_inf("%-13s %-14s %10s %10s %10s %10s\n", "stressor",
+				"pressure", "some %", "full %", "some max %",
+				"full max %");
+			stress_report_list(yaml, "psi");
+			heading = true;
+		}
+		stress_results_report(yaml, result);
+		for (i = 0; i < psi_sources_num; i++) {
+			const char *name = psi_sources[i].name;
+			const double some = 100.0 * psi->some[i] / result->duration;
+			const double full = 100.0 * psi->full[i] / result->duration;
+			char key[64];
+
+			pr_inf("%-13s %-14s %10.2f %10.2f %10.2f %10.2f\n",
+				munged, name, some, full,
+				psi->some_max[i], psi->full_max[i]);
+			(void)snprintf(key, sizeof(key), "%.15s-some-percent", name);
+			stress_report_double(yaml, key, some);
+			(void)snprintf(key, sizeof(key), "%.15s-full-percent", name);
+			stress_report_double(yaml, key, full);
+			(void)snprintf(key, sizeof(key), "%.15s-some-max-percent", name);
+			stress_report_double(yaml, key, psi->some_max[i]);
+			(void)snprintf(key, sizeof(key), "%.15s-full-max-percent", name);
+			stress_report_double(yaml, key, psi->full_max[i]);
+		}
+	}
+	if (!heading)
+		return;
+	stress_report_end(yaml);
+	stress_results_shared(&psi_results);
+
+	if (!psi_samples_num)
+		return;
+	stress_report_list(yaml, "psi-intervals");
+	for (i = 0; i < psi_samples_num; i++) {
+		const stress_psi_sample_t *sample = &psi_samples[i];
+		char key[64], time[32];
+
+		(void)snprintf(time, sizeof(time), "%f", sample->time);
+		stress_report_item(yaml, "time", time);
+		stress_report_uint64(yaml, "run", (uint64_t)sample->run + 1);
+		for (j = 0; j < psi_sources_num; j++) {
+			(void)snprintf(key, sizeof(key), "%.15s-some-percent", psi_sources[j].name);
+			stress_report_double(yaml, key, sample->some[j]);
+			(void)snprintf(key, sizeof(key), "%.15s-full-percent", psi_sources[j].name);
+			stress_report_double(yaml, key, sample->full[j]);
+		}
+	}
+	stress_report_end(yaml);
+}
+
+/*
+ *  stress_psi_free()
+ *	free pressure stall information results
+ */
+void stress_psi_free(void)
+{
+	stress_results_free(&psi_results, NULL);
+	free(psi_samples);
+	psi_samples = NULL;
+	psi_samples_num = 0;
+	psi_sources_num = 0;
+	psi_runs = 0;
+	psi_running = false;
+}
@@ -0,0 +1,695 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define RECORD_MAGIC		"STRNGREC"
+#define RECORD_VERSION		(1)
+#define RECORD_NAME_LEN		(32)
+#define RECORD_MAX_BYTES	(64 * MB)
+#define RECORD_DEFAULT_PERIOD	(10)		/* milliseconds */
+
+#define RECORD_EXTRA_CPU	(0x01)		/* CPU each instance is on */
+#define RECORD_EXTRA_TZ		(0x02)		/* thermal zone temperatures */
+#define RECORD_EXTRA_CPUFREQ	(0x04)		/* CPU frequencies */
+
+/*
+ *  Recording file layout:
+ *	header
+ *	series table, one entry per stressor instance
+ *	thermal zone name table
+ *	ring of fixed size records starting at data_offset
+ *
+ *  Each record holds the time in nanoseconds since the start
+ *  followed by the bogo-op counter of each instance and then
+ *  optionally the CPU of each instance (int32_t), thermal zone
+ *  temperatures in millidegrees C (int32_t) and the CPU
+ *  frequencies in kHz (uint32_t)
+ */
+typedef struct {
+	char magic[8];			/* RECORD_MAGIC */
+	uint32_t version;		/* RECORD_VERSION */
+	uint32_t extra;			/* RECORD_EXTRA_* flags */
+	uint32_t num_series;		/* number of instances */
+	uint32_t num_tz;		/* number of thermal zones */
+	uint32_t num_cpufreq;		/* number of CPU frequencies */
+	uint32_t record_size;		/* size of a record in bytes */
+	uint64_t data_offset;		/* file offset of the records */
+	uint64_t capacity;		/* number of records in the ring */
+	uint64_t head;			/* records written, next is head % capacity */
+	uint64_t period_ns;		/* sampling period */
+	double start_time;		/* time of day the recording started */
+} stress_record_header_t;
+
+typedef struct {
+	char name[RECORD_NAME_LEN];	/* stressor name */
+	uint32_t instance;		/* stressor instance number */
+	uint32_t reserved;
+} stress_record_series_t;
+
+/* Per stressor accumulated stats of a report interval */
+typedef struct {
+	const char *name;		/* stressor name */
+	uint64_t ops;			/* bogo ops in interval */
+	uint64_t sample_ops;		/* bogo ops in current sample */
+	uint64_t samples;		/* number of rate samples */
+	double rate_min;		/* minimum sample rate */
+	double rate_max;		/* maximum sample rate */
+	double max_stall;		/* longest time without progress */
+	uint64_t migrations;		/* instance CPU changes */
+} stress_record_group_t;
+
+static const char *record_filename;
+static uint8_t *record_map = MAP_FAILED;	/* mapped recording file */
+static size_t record_map_len;
+static stress_record_header_t *record_header;
+static stress_stats_t **record_stats;		/* stats of each instance */
+static pid_t **record_pids;			/* pid of each instance */
+static int *record_tz_fds;
+static int *record_cpufreq_fds;
+static uint32_t record_extra;
+static uint32_t record_period = RECORD_DEFAULT_PERIOD;
+static double record_start;
+static double record_next;
+
+/*
+ *  stress_set_record_extra()
+ *	parse the comma separated list of extra data to record
+ */
+int stress_set_record_extra(const char *arg)
+{
+	char *str, *token, *saveptr = NULL;
+	char *buf = strdup(arg);
+
+	if (!buf) {
+		(void)fprintf(stderr, "record-extra: out of memory\n");
+		return -1;
+	}
+	record_extra = 0;
+	for (str = buf; (token = strtok_r(str, ",", &saveptr)) != NULL; str = NULL) {
+		if (!strcmp(token, "cpu")) {
+			record_extra |= RECORD_EXTRA_CPU;
+		} else if (!strcmp(token, "tz")) {
+			record_extra |= RECORD_EXTRA_TZ;
+		} else if (!strcmp(token, "cpufreq")) {
+			record_extra |= RECORD_EXTRA_CPUFREQ;
+		} else {
+			(void)fprintf(stderr, "record-extra must be a comma "
+				"separated list of: cpu tz cpufreq\n");
+			free(buf);
+			return -1;
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+
+/*
+ *  stress_record_size()
+ *	size of a record in bytes, rounded up to 8 bytes
+ */
+static uint64_t stress_record_size(
+	const uint32_t num_series,
+	const uint32_t num_tz,
+	const uint32_t num_cpufreq,
+	const uint32_t extra)
+{
+	uint64_t size = sizeof(uint64_t) * (1 + (uint64_t)num_series);
+
+	if (extra & RECORD_EXTRA_CPU)
+		size += sizeof(int32_t) * (uint64_t)num_series;
+	size += sizeof(int32_t) * ((uint64_t)num_tz + num_cpufreq);
+
+	return (size + 7) & ~7ULL;
+}
+
+/*
+ *  stress_record_read_int()
+ *	read an integer from an open sysfs file, 0 on failure
+ */
+static int64_t stress_record_read_int(const int fd)
+{
+	char buf[32];
+	ssize_t ret;
+
+	if (fd < 0)
+		return 0;
+	ret = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (ret <= 0)
+		return 0;
+	buf[ret] = '\0';
+
+	return (int64_t)atoll(buf);
+}
+
+/*
+ *  stress_record_pid_cpu()
+ *	CPU a process last ran on, -1 if unknown
+ */
+static int32_t stress_record_pid_cpu(const pid_t pid)
+{
+	char path[64], buf[1024];
+	char *ptr;
+	int i;
+
+	if (!pid)
+		return -1;
+	(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return -1;
+	buf[sizeof(buf) - 1] = '\0';
+
+	/* Skip over the command name, it may contain spaces */
+	ptr = strrchr(buf, ')');
+	if (!ptr)
+		return -1;
+	/* processor is field 39, field 3 follows the command name */
+	for (i = 2; (i < 39) && ptr; i++)
+		ptr = strchr(ptr + 1, ' ');
+
+	return ptr ? (int32_t)atoi(ptr + 1) : -1;
+}
+
+/*
+ *  stress_record_tz_open()
+ *	open the thermal zone temperature files and add
+ *	the zone names to the name table
+ */
+static uint32_t stress_record_tz_open(char names[][RECORD_NAME_LEN], const uint32_t max)
+{
+	uint32_t n = 0, i;
+
+	for (i = 0; (n < max) && (i < 1024); i++) {
+		char path[PATH_MAX], type[RECORD_NAME_LEN];
+		int fd;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/class/thermal/thermal_zone%" PRIu32 "/temp", i);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			break;
+		(void)snprintf(path, sizeof(path),
+			"/sys/class/thermal/thermal_zone%" PRIu32 "/type", i);
+		if (system_read(path, type, sizeof(type) - 1) <= 0)
+			(void)snprintf(type, sizeof(type), "thermal_zone%" PRIu32, i);
+		type[sizeof(type) - 1] = '\0';
+		type[strcspn(type, "\n")] = '\0';
+		if (names)
+			(void)shim_strlcpy(names[n], type, RECORD_NAME_LEN);
+		if (record_tz_fds)
+			record_tz_fds[n] = fd;
+		else
+			(void)close(fd);
+		n++;
+	}
+	return n;
+}
+
+/*
+ *  stress_record_init()
+ *	create the memory mapped recording file if --record
+ *	is used, returns -1 on failure
+ */
+int stress_record_init(stress_stressor_t *stressors_list)
+{
+	char *filename = NULL;
+	const stress_stressor_t *ss;
+	stress_record_header_t header;
+	stress_record_series_t *series;
+	char (*tz_names)[RECORD_NAME_LEN];
+	uint32_t num_series = 0, num_tz = 0, num_cpufreq = 0, i;
+	uint64_t records, seconds;
+	size_t table_size;
+	int fd;
+
+	if (!stress_get_setting("record", &filename))
+		return 0;
+	(void)stress_get_setting("record-period", &record_period);
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		num_series += (uint32_t)ss->num_instances;
+	if (record_extra & RECORD_EXTRA_TZ)
+		num_tz = stress_record_tz_open(NULL, 256);
+	if (record_extra & RECORD_EXTRA_CPUFREQ)
+		num_cpufreq = (uint32_t)stress_get_processors_configured();
+
+	record_stats = calloc(num_series ? num_series : 1, sizeof(*record_stats));
+	record_pids = calloc(num_series ? num_series : 1, sizeof(*record_pids));
+	record_tz_fds = calloc(num_tz ? num_tz : 1, sizeof(*record_tz_fds));
+	record_cpufreq_fds = calloc(num_cpufreq ? num_cpufreq : 1, sizeof(*record_cpufreq_fds));
+	if (!record_stats || !record_pids || !record_tz_fds || !record_cpufreq_fds) {
+		pr_err("record: cannot allocate recording state\n");
+		goto err;
+	}
+
+	(void)memset(&header, 0, sizeof(header));
+	(void)memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+	header.version = RECORD_VERSION;
+	header.extra = record_extra;
+	header.num_series = num_series;
+	header.num_tz = num_tz;
+	header.num_cpufreq = num_cpufreq;
+	header.record_size = (uint32_t)stress_record_size(num_series,
+		num_tz, num_cpufreq, record_extra);
+	table_size = sizeof(header) + (num_series * sizeof(*series)) +
+		(num_tz * RECORD_NAME_LEN);
+	header.data_offset = (table_size + stress_get_pagesize() - 1) &
+		~(stress_get_pagesize() - 1);
+	header.period_ns = (uint64_t)record_period * 1000000ULL;
+	header.start_time = stress_time_now();
+
+	/* Enough records for the run, the ring wraps on longer runs */
+	seconds = ((g_opt_timeout == TIMEOUT_NOT_SET) || (g_opt_timeout == 0)) ?
+		3600 : g_opt_timeout;
+	records = ((seconds * 1000) / record_period) + 1024;
+	if (records > RECORD_MAX_BYTES / header.record_size)
+		records = RECORD_MAX_BYTES / header.record_size;
+	header.capacity = records;
+
+	record_map_len = (size_t)(header.data_offset + (records * header.record_size));
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		pr_err("record: cannot create %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		goto err;
+	}
+	if (ftruncate(fd, (off_t)record_map_len) < 0) {
+		pr_err("record: cannot size %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		(void)close(fd);
+		goto err;
+	}
+	record_map = (uint8_t *)mmap(NULL, record_map_len, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	(void)close(fd);
+	if (record_map == MAP_FAILED) {
+		pr_err("record: cannot mmap %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		goto err;
+	}
+
+	record_header = (stress_record_header_t *)record_map;
+	*record_header = header;
+	series = (stress_record_series_t *)(record_map + sizeof(header));
+	tz_names = (char (*)[RECORD_NAME_LEN])(series + num_series);
+
+	i = 0;
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		for (j = 0; j < ss->num_instances; j++, i++) {
+			(void)shim_strlcpy(series[i].name,
+				stress_munge_underscore(ss->stressor->name),
+				sizeof(series[i].name));
+			series[i].instance = (uint32_t)j;
+			record_stats[i] = ss->stats[j];
+			record_pids[i] = &ss->pids[j];
+		}
+	}
+	if (num_tz)
+		(void)stress_record_tz_open(tz_names, num_tz);
+	for (i = 0; i < num_cpufreq; i++) {
+		char path[PATH_MAX];
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%" PRIu32 "/cpufreq/scaling_cur_freq", i);
+		record_cpufreq_fds[i] = open(path, O_RDONLY);
+	}
+
+	record_filename = filename;
+	record_start = stress_time_now();
+	record_next = record_start;
+
+	return 0;
+err:
+	free(record_stats);
+	free(record_pids);
+	free(record_tz_fds);
+	free(record_cpufreq_fds);
+	record_stats = NULL;
+	record_pids = NULL;
+	record_tz_fds = NULL;
+	record_cpufreq_fds = NULL;
+	return -1;
+}
+
+/*
+ *  stress_record_active()
+ *	true if samples are being recorded
+ */
+bool stress_record_active(void)
+{
+	return record_map != MAP_FAILED;
+}
+
+/*
+ *  stress_record_next()
+ *	time when the next sample is due
+ */
+double stress_record_next(void)
+{
+	return record_next;
+}
+
+/*
+ *  stress_record_tick()
+ *	record a sample of the instance counters and extra
+ *	data if a sample is due
+ */
+void stress_record_tick(const double now)
+{
+	stress_record_header_t *const header = record_header;
+	uint8_t *record;
+	uint64_t *counters;
+	int32_t *data;
+	uint32_t i;
+
+	if ((record_map == MAP_FAILED) || (now < record_next))
+		return;
+
+	record = record_map + header->data_offset +
+		((header->head % header->capacity) * header->record_size);
+	*(uint64_t *)record = (uint64_t)((now - record_start) * 1000000000.0);
+	counters = (uint64_t *)(record + sizeof(uint64_t));
+	for (i = 0; i < header->num_series; i++)
+		counters[i] = record_stats[i]->counter;
+
+	data = (int32_t *)(counters + header->num_series);
+	if (header->extra & RECORD_EXTRA_CPU) {
+		for (i = 0; i < header->num_series; i++)
+			*data++ = stress_record_pid_cpu(*record_pids[i]);
+	}
+	for (i = 0; i < header->num_tz; i++)
+		*data++ = (int32_t)stress_record_read_int(record_tz_fds[i]);
+	for (i = 0; i < header->num_cpufreq; i++)
+		*data++ = (int32_t)stress_record_read_int(record_cpufreq_fds[i]);
+	header->head++;
+
+	record_next += (double)record_period / 1000.0;
+	if (record_next < now)
+		record_next = now + ((double)record_period / 1000.0);
+}
+
+/*
+ *  stress_record_close()
+ *	write a final sample and close the recording
+ */
+void stress_record_close(void)
+{
+	uint32_t i;
+
+	if (record_map == MAP_FAILED)
+		return;
+
+	record_next = 0.0;
+	stress_record_tick(stress_time_now());
+	pr_inf("record: %" PRIu64 " samples written to %s%s\n",
+		record_header->head, record_filename,
+		(record_header->head > record_header->capacity) ?
+			" (ring wrapped, oldest samples lost)" : "");
+
+	for (i = 0; i < record_header->num_tz; i++)
+		(void)close(record_tz_fds[i]);
+	for (i = 0; i < record_header->num_cpufreq; i++) {
+		if (record_cpufreq_fds[i] >= 0)
+			(void)close(record_cpufreq_fds[i]);
+	}
+	(void)msync(record_map, record_map_len, MS_SYNC);
+	(void)munmap((void *)record_map, record_map_len);
+	record_map = MAP_FAILED;
+	record_header = NULL;
+
+	free(record_stats);
+	free(record_pids);
+	free(record_tz_fds);
+	free(record_cpufreq_fds);
+	record_stats = NULL;
+	record_pids = NULL;
+	record_tz_fds = NULL;
+	record_cpufreq_fds = NULL;
+}
+
+/*
+ *  stress_record_report_interval()
+ *	print the stats of one report interval
+ */
+static void stress_record_report_interval(
+	const stress_record_header_t *header,
+	const char (*tz_names)[RECORD_NAME_LEN],
+	stress_record_group_t *groups,
+	const size_t num_groups,
+	const double t,
+	const double duration,
+	const double *tz_sum,
+	const double freq_sum,
+	const double freq_min,
+	const double freq_max,
+	const uint64_t samples)
+{
+	size_t i;
+
+	for (i = 0; i < num_groups; i++) {
+		stress_record_group_t *g = &groups[i];
+
+		(void)printf("%9.3f %-13s %12" PRIu64 " %12.2f %12.2f %12.2f %11.3f",
+			t, g->name, g->ops,
+			(duration > 0.0) ? (double)g->ops / duration : 0.0,
+			g->samples ? g->rate_min : 0.0,
+			g->samples ? g->rate_max : 0.0,
+			g->max_stall * 1000.0);
+		if (header->extra & RECORD_EXTRA_CPU)
+			(void)printf(" %10" PRIu64, g->migrations);
+		(void)printf("\n");
+
+		g->ops = 0;
+		g->samples = 0;
+		g->rate_min = 0.0;
+		g->rate_max = 0.0;
+		g->max_stall = 0.0;
+		g->migrations = 0;
+	}
+	if (!samples)
+		return;
+	for (i = 0; i < header->num_tz; i++)
+		(void)printf("%9.3f %-13s %-25s %12.2f C\n", t, "thermal",
+			tz_names[i], tz_sum[i] / (double)samples / 1000.0);
+	if (header->num_cpufreq && (freq_max > 0.0))
+		(void)printf("%9.3f %-13s %12.2f MHz mean, %.2f..%.2f MHz\n",
+			t, "cpufreq",
+			freq_sum / (double)(samples * header->num_cpufreq) / 1000.0,
+			freq_min / 1000.0, freq_max / 1000.0);
+}
+
+/*
+ *  stress_record_replay()
+ *	turn a recording into a report of per interval throughput,
+ *	sample rate range, longest stall and optionally migrations,
+ *	temperatures and CPU frequencies
+ */
+int stress_record_replay(const char *filename)
+{
+	struct stat statbuf;
+	const stress_record_header_t *header;
+	const stress_record_series_t *series;
+	const char (*tz_names)[RECORD_NAME_LEN];
+	stress_record_group_t *groups = NULL;
+	size_t *group_of = NULL, num_groups = 0;
+	uint64_t *last_counter = NULL;
+	double *last_change = NULL, *tz_sum = NULL;
+	int32_t *last_cpu = NULL;
+	double freq_sum = 0.0, freq_min = 0.0, freq_max = 0.0;
+	double interval_start = 0.0, prev_t = 0.0;
+	uint64_t interval = 1, first, r, samples = 0, interval_index = 0;
+	uint8_t *map;
+	size_t len;
+	uint32_t i;
+	int fd, rc = EXIT_FAILURE;
+
+	(void)stress_get_setting("interval", &interval);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		(void)fprintf(stderr, "replay-report: cannot open %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if ((fstat(fd, &statbuf) < 0) || ((size_t)statbuf.st_size < sizeof(*header))) {
+		(void)fprintf(stderr, "replay-report: %s is not a stress-ng recording\n",
+			filename);
+		(void)close(fd);
+		return EXIT_FAILURE;
+	}
+	len = (size_t)statbuf.st_size;
+	map = (uint8_t *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (map == MAP_FAILED) {
+		(void)fprintf(stderr, "replay-report: cannot mmap %s, errno=%d (%s)\n",
+			filename, errno, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	header = (const stress_record_header_t *)map;
+	if (memcmp(header->magic, RECORD_MAGIC, sizeof(header->magic)) ||
+	    (header->version != RECORD_VERSION) ||
+	    (header->capacity == 0) ||
+	    (header->record_size != stress_record_size(header->num_series,
+		header->num_tz, header->num_cpufreq, header->extra)) ||
+	    (header->data_offset < sizeof(*header) +
+		((uint64_t)header->num_series * sizeof(*series)) +
+		((uint64_t)header->num_tz * RECORD_NAME_LEN)) ||
+	    (header->data_offset > len) ||
+	    (header->capacity > (len - header->data_offset) / header->record_size)) {
+		(void)fprintf(stderr, "replay-report: %s is not a valid stress-ng "
+			"recording\n", filename);
+		goto done;
+	}
+	series = (const stress_record_series_t *)(map + sizeof(*header));
+	tz_names = (const char (*)[RECORD_NAME_LEN])(series + header->num_series);
+
+	/* Group the instance series by stressor */
+	groups = calloc(header->num_series + 1, sizeof(*groups));
+	group_of = calloc(header->num_series + 1, sizeof(*group_of));
+	last_counter = calloc(header->num_series + 1, sizeof(*last_counter));
+	last_change = calloc(header->num_series + 1, sizeof(*last_change));
+	last_cpu = calloc(header->num_series + 1, sizeof(*last_cpu));
+	tz_sum = calloc(header->num_tz + 1, sizeof(*tz_sum));
+	if (!groups || !group_of || !last_counter || !last_change || !last_cpu || !tz_sum) {
+		(void)fprintf(stderr, "replay-report: out of memory\n");
+		goto done;
+	}
+	for (i = 0; i < header->num_series; i++) {
+		if (!num_groups || strncmp(groups[num_groups - 1].name,
+					   series[i].name, RECORD_NAME_LEN))
+			groups[num_groups++].name = series[i].name;
+		group_of[i] = num_groups - 1;
+		last_cpu[i] = -1;
+	}
+
+	first = (header->head > header->capacity) ? header->head - header->capacity : 0;
+	(void)printf("recording of %" PRIu32 " instances, %" PRIu64 " samples, "
+		"%.3f ms sampling period%s\n",
+		header->num_series, header->head - first,
+		(double)header->period_ns / 1000000.0,
+		first ? ", oldest samples were overwritten" : "");
+	(void)printf("%9s %-13s %12s %12s %12s %12s %11s%s\n",
+		"time (s)", "stressor", "bogo ops", "bogo ops/s",
+		"min ops/s", "max ops/s", "stall (ms)",
+		(header->extra & RECORD_EXTRA_CPU) ? " migrations" : "");
+
+	for (r = first; r < header->head; r++) {
+		const uint8_t *record = map + header->data_offset +
+			((r % header->capacity) * header->record_size);
+		const double t = (double)*(const uint64_t *)record / 1000000000.0;
+		const uint64_t *counters = (const uint64_t *)(record + sizeof(uint64_t));
+		const int32_t *data = (const int32_t *)(counters + header->num_series);
+		const double dt = t - prev_t;
+		const uint64_t index = (uint64_t)t / interval;
+		size_t g;
+
+		if (index != interval_index) {
+			stress_record_report_interval(header, tz_names, groups, num_groups,
+				interval_start, t - interval_start, tz_sum,
+				freq_sum, freq_min, freq_max, samples);
+			(void)memset(tz_sum, 0, sizeof(*tz_sum) * header->num_tz);
+			freq_sum = 0.0;
+			samples = 0;
+			interval_start = t;
+			interval_index = index;
+		}
+
+		for (g = 0; g < num_groups; g++)
+			groups[g].sample_ops = 0;
+		for (i = 0; i < header->num_series; i++) {
+			stress_record_group_t *grp = &groups[group_of[i]];
+			/* counters restart from zero on a new run */
+			const uint64_t ops = (counters[i] >= last_counter[i]) ?
+				counters[i] - last_counter[i] : counters[i];
+
+			grp->ops += ops;
+			grp->sample_ops += ops;
+			if (ops) {
+				const double stall = t - last_change[i];
+
+				/* only time stalls between progress in the same run */
+				if (last_counter[i] && (counters[i] > last_counter[i]) &&
+				    (stall > grp->max_stall))
+					grp->max_stall = stall;
+				last_change[i] = t;
+			}
+			last_counter[i] = counters[i];
+		}
+
+		/* Aggregate rate of each stressor over the sample period */
+		if ((r > first) && (dt > 0.0)) {
+			for (g = 0; g < num_groups; g++) {
+				stress_record_group_t *grp = &groups[g];
+				const double rate = (double)grp->sample_ops / dt;
+
+				if (!grp->samples || (rate < grp->rate_min))
+					grp->rate_min = rate;
+				if (rate > grp->rate_max)
+					grp->rate_max = rate;
+				grp->samples++;
+			}
+		}
+
+		if (header->extra & RECORD_EXTRA_CPU) {
+			for (i = 0; i < header->num_series; i++, data++) {
+				if ((*data >= 0) && (last_cpu[i] >= 0) && (*data != last_cpu[i]))
+					groups[group_of[i]].migrations++;
+				if (*data >= 0)
+					last_cpu[i] = *data;
+			}
+		}
+		for (i = 0; i < header->num_tz; i++, data++)
+			tz_sum[i] += (double)*data;
+		for (i = 0; i < header->num_cpufreq; i++, data++) {
+			const double freq = (double)(uint32_t)*data;
+
+			if ((!samples && !i) || (freq < freq_min))
+				freq_min = freq;
+			if ((!samples && !i) || (freq > freq_max))
+				freq_max = freq;
+			freq_sum += freq;
+		}
+		samples++;
+		prev_t = t;
+	}
+	if (samples)
+		stress_record_report_interval(header, tz_names, groups, num_groups,
+			interval_start, prev_t - interval_start, tz_sum,
+			freq_sum, freq_min, freq_max, samples);
+	rc = EXIT_SUCCESS;
+done:
+	free(tz_sum);
+	free(last_cpu);
+	free(last_change);
+	free(last_counter);
+	free(group_of);
+	free(groups);
+	(void)munmap((void *)map, len);
+
+	return rc;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+/* Throughput of a stressor in one run of a repeated run */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	uint32_t run;			/* run number, 0 = first */
+	bool warmup;			/* true if a discarded warm-up run */
+	double rate;			/* bogo ops per second */
+} stress_repeat_result_t;
+
+static stress_repeat_result_t *repeat_results;
+static size_t repeat_results_num;
+
+/*
+ *  Two sided 95% Student's t critical values for
+ *  1 to 30 degrees of freedom
+ */
+static const double t_95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+/*
+ *  stress_repeat_t_95()
+ *	two sided 95% Student's t critical value for df degrees
+ *	of freedom, interpolated in 1/df above 30 degrees
+ */
+double stress_repeat_t_95(const uint32_t df)
+{
+	if (df == 0)
+		return 0.0;
+	if (df <= SIZEOF_ARRAY(t_95))
+		return t_95[df - 1];
+	/* t tends to 1.960 as df tends to infinity, almost linearly in 1/df */
+	return 1.960 + ((t_95[SIZEOF_ARRAY(t_95) - 1] - 1.960) *
+		(double)SIZEOF_ARRAY(t_95)) / (double)df;
+}
+
+/*
+ *  stress_repeat_rate()
+ *	bogo ops per second of the last run of a stressor over
+ *	the average wall clock time, as in the metrics
+ */
+double stress_repeat_rate(const stress_stressor_t *ss)
+{
+	uint64_t ops = 0;
+	double run_time = 0.0;
+	int32_t j;
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		ops += stats->counter;
+		run_time += stats->finish - stats->start;
+	}
+	run_time = ss->started_instances ?
+		run_time / (double)ss->started_instances : 0.0;
+
+	return (run_time > 0.0) ? (double)ops / run_time : 0.0;
+}
+
+/*
+ *  stress_repeat_record()
+ *	record the throughput of the stressors after a run
+ */
+void stress_repeat_record(
+	stress_stressor_t *stressors_list,
+	const uint32_t run,
+	const bool warmup)
+{
+	const stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_repeat_result_t *result;
+		const double rate = stress_repeat_rate(ss);
+
+		result = realloc(repeat_results,
+			(repeat_results_num + 1) * sizeof(*repeat_results));
+		if (!result) {
+			pr_err("cannot allocate repeat run results\n");
+			return;
+		}
+		repeat_results = result;
+		result = &repeat_results[repeat_results_num++];
+		result->ss = ss;
+		result->run = run;
+		result->warmup = warmup;
+		result->rate = rate;
+
+		pr_inf("%s: run %" PRIu32 "%s, %.2f bogo ops/s\n",
+			stress_munge_underscore(ss->stressor->name),
+			run + 1, warmup ? " (warm-up)" : "", rate);
+	}
+}
+
+/*
+ *  stress_repeat_stats()
+ *	compute the statistics of the throughput of a stressor
+ *	over the measured (non warm-up) runs, returns false if
+ *	the stressor has no measured runs
+ */
+bool stress_repeat_stats(
+	const stress_stressor_t *ss,
+	stress_repeat_stats_t *stats)
+{
+	size_t i;
+	double sum = 0.0, sum_sq = 0.0;
+
+	(void)memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < repeat_results_num; i++) {
+		const stress_repeat_result_t *r = &repeat_results[i];
+
+		if ((r->ss != ss) || r->warmup)
+			continue;
+		stats->n++;
+		sum += r->rate;
+		if ((stats->n == 1) || (r->rate < stats->min))
+			stats->min = r->rate;
+		if (r->rate > stats->max)
+			stats->max = r->rate;
+	}
+	if (!stats->n)
+		return false;
+
+	stats->mean = sum / (double)stats->n;
+	for (i = 0; i < repeat_results_num; i++) {
+		const stress_repeat_result_t *r = &repeat_results[i];
+
+		if ((r->ss != ss) || r->warmup)
+			continue;
+		sum_sq += (r->rate - stats->mean) * (r->rate - stats->mean);
+	}
+
+	/* Sample standard deviation and confidence interval of the mean */
+	if (stats->n > 1) {
+		stats->stddev = sqrt(sum_sq / (double)(stats->n - 1));
+		stats->ci95 = stress_repeat_t_95(stats->n - 1) *
+			stats->stddev / sqrt((double)stats->n);
+	}
+	stats->cv = (stats->mean > 0.0) ? 100.0 * stats->stddev / stats->mean : 0.0;
+
+	return true;
+}
+
+/*
+ *  stress_repeat_dump()
+ *	report the mean, standard deviation, range, coefficient
+ *	of variation and 95% confidence interval of the mean
+ *	throughput of each stressor over the measured runs
+ */
+void stress_repeat_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	bool heading = false;
+
+	if (!repeat_results_num)
+		return;
+
+	pr_yaml(yaml, "repeat-statistics:\n");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		stress_repeat_stats_t stats;
+		size_t i;
+
+		if (!stress_repeat_stats(ss, &stats))
+			continue;
+
+		if (!heading) {
+			pr_inf("%-13s %4s %12s %10s %7s %12s %12s %25s\n",
+				"stressor", "runs", "mean ops/s", "stddev", "CV",
+				"min", "max", "95% CI of mean");
+			heading = true;
+		}
+		pr_inf("%-13s %4" PRIu32 " %12.2f %10.2f %6.2f%% %12.2f %12.2f %12.2f..%.2f\n",
+			munged, stats.n, stats.mean, stats.stddev, stats.cv,
+			stats.min, stats.max,
+			stats.mean - stats.ci95, stats.mean + stats.ci95);
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      runs: %" PRIu32 "\n", stats.n);
+		pr_yaml(yaml, "      mean: %f\n", stats.mean);
+		pr_yaml(yaml, "      stddev: %f\n", stats.stddev);
+		pr_yaml(yaml, "      min: %f\n", stats.min);
+		pr_yaml(yaml, "      max: %f\n", stats.max);
+		pr_yaml(yaml, "      coefficient-of-variation: %f\n", stats.cv);
+		pr_yaml(yaml, "      ci95-low: %f\n", stats.mean - stats.ci95);
+		pr_yaml(yaml, "      ci95-high: %f\n", stats.mean + stats.ci95);
+		pr_yaml(yaml, "      bogo-ops-per-second-real-time:\n");
+		for (i = 0; i < repeat_results_num; i++) {
+			const stress_repeat_result_t *r = &repeat_results[i];
+
+			if ((r->ss == ss) && !r->warmup)
+				pr_yaml(yaml, "        - %f\n", r->rate);
+		}
+		pr_yaml(yaml, "\n");
+	}
+}
+
+/*
+ *  stress_repeat_free()
+ *	free repeat run results
+ */
+void stress_repeat_free(void)
+{
+	free(repeat_results);
+	repeat_results = NULL;
+	repeat_results_num = 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+/*
+ *  Structured report emitter. Report sections are either a
+ *  mapping of key/value pairs (stress_report_map) or a list of
+ *  items (stress_report_list), each item is started with its
+ *  identifying key/value (stress_report_item) and holds further
+ *  key/value pairs, sections are ended with stress_report_end.
+ *  The same calls produce the YAML output and, when enabled,
+ *  the JSON and CSV outputs:
+ *
+ *  YAML: the existing stress-ng YAML layout
+ *  JSON: one object, sections are objects or arrays of objects
+ *  CSV:  one row per value, section,item,key,value
+ */
+#define REPORT_NONE	(0)
+#define REPORT_MAP	(1)
+#define REPORT_LIST	(2)
+
+static FILE *report_json;
+static FILE *report_csv;
+static int report_section = REPORT_NONE;	/* current section type */
+static bool report_item;			/* inside a list item */
+static bool report_first_section = true;	/* JSON comma tracking */
+static bool report_first_item;
+static bool report_first_key;
+static char report_section_name[64];
+static char report_item_name[128];
+
+/*
+ *  stress_report_json_str()
+ *	write a JSON string with escaping
+ */
+static void stress_report_json_str(const char *str)
+{
+	const unsigned char *ptr;
+
+	(void)fputc('"', report_json);
+	for (ptr = (const unsigned char *)str; *ptr; ptr++) {
+		switch (*ptr) {
+		case '"':
+		case '\\':
+			(void)fprintf(report_json, "\\%c", *ptr);
+			break;
+		case '\n':
+			(void)fputs("\\n", report_json);
+			break;
+		case '\t':
+			(void)fputs("\\t", report_json);
+			break;
+		default:
+			if (*ptr < 0x20)
+				(void)fprintf(report_json, "\\u%4.4x", *ptr);
+			else
+				(void)fputc(*ptr, report_json);
+			break;
+		}
+	}
+	(void)fputc('"', report_json);
+}
+
+/*
+ *  stress_report_csv_str()
+ *	write a CSV field, quoted if it contains a
+ *	separator, quote or line break
+ */
+static void stress_report_csv_str(const char *str)
+{
+	const char *ptr;
+
+	if (!strpbrk(str, ",\"\r\n")) {
+		(void)fputs(str, report_csv);
+		return;
+	}
+	(void)fputc('"', report_csv);
+	for (ptr = str; *ptr; ptr++) {
+		if (*ptr == '"')
+			(void)fputc('"', report_csv);
+		(void)fputc(*ptr, report_csv);
+	}
+	(void)fputc('"', report_csv);
+}
+
+/*
+ *  stress_report_open()
+ *	open the JSON and CSV report files if they
+ *	have been requested with --json and --csv
+ */
+void stress_report_open(void)
+{
+	char *filename = NULL;
+
+	if (stress_get_setting("json", &filename)) {
+		report_json = fopen(filename, "w");
+		if (!report_json)
+			pr_err("Cannot output JSON data to %s\n", filename);
+		else
+			(void)fputs("{", report_json);
+	}
+	filename = NULL;
+	if (stress_get_setting("csv", &filename)) {
+		report_csv = fopen(filename, "w");
+		if (!report_csv)
+			pr_err("Cannot output CSV data to %s\n", filename);
+		else
+			(void)fputs("section,item,key,value\n", report_csv);
+	}
+	report_first_section = true;
+}
+
+/*
+ *  stress_report_item_end()
+ *	end the current list item
+ */
+static void stress_report_item_end(FILE *yaml)
+{
+	if (!report_item)
+		return;
+	pr_yaml(yaml, "\n");
+	if (report_json)
+		(void)fputs("\n\t\t}", report_json);
+	report_item = false;
+	*report_item_name = '\0';
+}
+
+/*
+ *  stress_report_end()
+ *	end the current report section
+ */
+void stress_report_end(FILE *yaml)
+{
+	if (report_section == REPORT_NONE)
+		return;
+
+	if (report_section == REPORT_LIST) {
+		stress_report_item_end(yaml);
+		if (report_json)
+			(void)fputs("\n\t]", report_json);
+	} else {
+		pr_yaml(yaml, "\n");
+		if (report_json)
+			(void)fputs("\n\t}", report_json);
+	}
+	report_section = REPORT_NONE;
+}
+
+/*
+ *  stress_report_section()
+ *	start a new report section of the given type
+ */
+static void stress_report_section(FILE *yaml, const char *name, const int type)
+{
+	stress_report_end(yaml);
+
+	pr_yaml(yaml, "%s:\n", name);
+	if (report_json) {
+		(void)fputs(report_first_section ? "\n\t" : ",\n\t", report_json);
+		stress_report_json_str(name);
+		(void)fputs((type == REPORT_LIST) ? ": [" : ": {", report_json);
+	}
+	(void)shim_strlcpy(report_section_name, name, sizeof(report_section_name));
+	report_first_section = false;
+	report_first_item = true;
+	report_first_key = true;
+	report_section = type;
+}
+
+/*
+ *  stress_report_map()
+ *	start a section of key/value pairs
+ */
+void stress_report_map(FILE *yaml, const char *name)
+{
+	stress_report_section(yaml, name, REPORT_MAP);
+}
+
+/*
+ *  stress_report_list()
+ *	start a section that is a list of items
+ */
+void stress_report_list(FILE *yaml, const char *name)
+{
+	stress_report_section(yaml, name, REPORT_LIST);
+}
+
+/*
+ *  stress_report_item()
+ *	start a new list item identified by key and value,
+ *	e.g. stressor: cpu
+ */
+void stress_report_item(FILE *yaml, const char *key, const char *value)
+{
+	stress_report_item_end(yaml);
+
+	pr_yaml(yaml, "    - %s: %s\n", key, value);
+	if (report_json) {
+		(void)fputs(report_first_item ? "\n\t\t{\n\t\t\t" : ",\n\t\t{\n\t\t\t",
+			report_json);
+		stress_report_json_str(key);
+		(void)fputs(": ", report_json);
+		stress_report_json_str(value);
+	}
+	(void)shim_strlcpy(report_item_name, value, sizeof(report_item_name));
+	report_first_item = false;
+	report_first_key = false;
+	report_item = true;
+}
+
+/*
+ *  stress_report_value()
+ *	emit a key with a pre-formatted value, json_value is
+ *	the JSON representation of the value, NULL for a string
+ */
+static void stress_report_value(
+	FILE *yaml,
+	const char *key,
+	const char *value,
+	const char *json_value)
+{
+	pr_yaml(yaml, "      %s: %s\n", key, value);
+
+	if (report_json) {
+		if (report_first_key)
+			(void)fputs(report_item ? "\n\t\t\t" : "\n\t\t", report_json);
+		else
+			(void)fputs(report_item ? ",\n\t\t\t" : ",\n\t\t", report_json);
+		stress_report_json_str(key);
+		(void)fputs(": ", report_json);
+		if (json_value)
+			(void)fputs(json_value, report_json);
+		else
+			stress_report_json_str(value);
+		report_first_key = false;
+	}
+	if (report_csv) {
+		stress_report_csv_str(report_section_name);
+		(void)fputc(',', report_csv);
+		stress_report_csv_str(report_item_name);
+		(void)fputc(',', report_csv);
+		stress_report_csv_str(key);
+		(void)fputc(',', report_csv);
+		stress_report_csv_str(value);
+		(void)fputc('\n', report_csv);
+	}
+}
+
+/*
+ *  stress_report_str()
+ *	emit a printf formatted string value
+ */
+void stress_report_str(FILE *yaml, const char *key, const char *fmt, ...)
+{
+	va_list ap;
+	char buf[512];
+
+	va_start(ap, fmt);
+	(void)vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	stress_report_value(yaml, key, buf, NULL);
+}
+
+/*
+ *  stress_report_uint64()
+ *	emit an unsigned integer value
+ */
+void stress_report_uint64(FILE *yaml, const char *key, const uint64_t value)
+{
+	char buf[32];
+
+	(void)snprintf(buf, sizeof(buf), "%" PRIu64, value);
+	stress_report_value(yaml, key, buf, buf);
+}
+
+/*
+ *  stress_report_int64()
+ *	emit a signed integer value
+ */
+void stress_report_int64(FILE *yaml, const char *key, const int64_t value)
+{
+	char buf[32];
+
+	(void)snprintf(buf, sizeof(buf), "%" PRId64, value);
+	stress_report_value(yaml, key, buf, buf);
+}
+
+/*
+ *  stress_report_double()
+ *	emit a floating point value, JSON has no
+ *	representation of NaN or infinity so use null
+ */
+void stress_report_double(FILE *yaml, const char *key, const double value)
+{
+	char buf[64];
+
+	(void)snprintf(buf, sizeof(buf), "%f", value);
+	stress_report_value(yaml, key, buf,
+		(isnan(value) || isinf(value)) ? "null" : buf);
+}
+
+/*
+ *  stress_report_double_prec()
+ *	emit a floating point value with precision decimal places
+ */
+void stress_report_double_prec(
+	FILE *yaml,
+	const char *key,
+	const int precision,
+	const double value)
+{
+	char buf[64];
+
+	(void)snprintf(buf, sizeof(buf), "%.*f", precision, value);
+	stress_report_value(yaml, key, buf,
+		(isnan(value) || isinf(value)) ? "null" : buf);
+}
+
+/*
+ *  stress_report_close()
+ *	end the last section and close the JSON and CSV files
+ */
+void stress_report_close(FILE *yaml)
+{
+	stress_report_end(yaml);
+
+	if (report_json) {
+		(void)fputs("\n}\n", report_json);
+		(void)fclose(report_json);
+		report_json = NULL;
+	}
+	if (report_csv) {
+		(void)fclose(report_csv);
+		report_csv = NULL;
+	}
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+/*
+ *  System wide measurements such as the energy, kernel activity and
+ *  pressure stalls can't be split between the stressors that run at
+ *  the same time, so the measurement of each run is charged to every
+ *  stressor in the run and the results are accumulated over all the
+ *  runs of each stressor
+ */
+
+/*
+ *  stress_results_find()
+ *	find the results of a stressor, NULL if there are none
+ */
+stress_result_t *stress_results_find(
+	const stress_results_t *results,
+	const stress_stressor_t *ss)
+{
+	size_t i;
+
+	for (i = 0; i < results->num; i++) {
+		if (results->results[i].ss == ss)
+			return &results->results[i];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_results_add()
+ *	add zeroed results for a stressor, NULL if out of memory
+ */
+static stress_result_t *stress_results_add(
+	stress_results_t *results,
+	const stress_stressor_t *ss)
+{
+	stress_result_t *result;
+	void *data;
+
+	data = calloc(1, results->data_size);
+	if (!data)
+		return NULL;
+	result = realloc(results->results,
+		(results->num + 1) * sizeof(*results->results));
+	if (!result) {
+		free(data);
+		return NULL;
+	}
+	results->results = result;
+	result = &results->results[results->num++];
+	(void)memset(result, 0, sizeof(*result));
+	result->ss = ss;
+	result->data = data;
+
+	return result;
+}
+
+/*
+ *  stress_results_charge()
+ *	charge a run of duration seconds to each stressor in the
+ *	run, the caller then adds its measurement to the data of
+ *	each result, returns false if out of memory
+ */
+bool stress_results_charge(
+	stress_results_t *results,
+	stress_stressor_t *stressors_list,
+	const double duration)
+{
+	const stress_stressor_t *ss;
+	uint32_t shared = 0;
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		shared++;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_result_t *result = stress_results_find(results, ss);
+		int32_t j;
+
+		if (!result)
+			result = stress_results_add(results, ss);
+		if (!result) {
+			pr_err("cannot allocate %s results\n", results->name);
+			return false;
+		}
+		for (j = 0; j < ss->started_instances; j++)
+			result->ops += ss->stats[j]->counter;
+		result->duration += duration;
+		if (shared > result->shared)
+			result->shared = shared;
+	}
+	return true;
+}
+
+/*
+ *  stress_results_report()
+ *	start the report item of a stressor with the run
+ *	time, bogo ops and number of stressors run together
+ */
+void stress_results_report(FILE *yaml, const stress_result_t *result)
+{
+	stress_report_item(yaml, "stressor",
+		stress_munge_underscore(result->ss->stressor->name));
+	stress_report_double(yaml, "duration", result->duration);
+	stress_report_uint64(yaml, "bogo-ops", result->ops);
+	stress_report_uint64(yaml, "shared-stressors", (uint64_t)result->shared);
+}
+
+/*
+ *  stress_results_shared()
+ *	note that the results of stressors that were run in
+ *	parallel are those of the whole run
+ */
+void stress_results_shared(const stress_results_t *results)
+{
+	size_t i;
+
+	for (i = 0; i < results->num; i++) {
+		if (results->results[i].shared > 1) {
+			pr_inf("%s: stressors run in parallel share the %s of "
+				"the whole run, use --sequential for per "
+				"stressor %s\n", results->name,
+				results->what, results->what);
+			return;
+		}
+	}
+}
+
+/*
+ *  stress_results_free()
+ *	free the results, free_data frees any memory
+ *	allocated by the caller in the data of a result
+ */
+void stress_results_free(stress_results_t *results, void (*free_data)(void *data))
+{
+	size_t i;
+
+	for (i = 0; i < results->num; i++) {
+		if (free_data)
+			free_data(results->results[i].data);
+		free(results->results[i].data);
+	}
+	free(results->results);
+	results->results = NULL;
+	results->num = 0;
+}
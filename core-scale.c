@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2013-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define SCALE_POINTS_MAX	(64)
+
+/* Throughput of a stressor at a given number of instances */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	int32_t instances;		/* number of instances run */
+	double rate;			/* bogo ops per second */
+} stress_scale_result_t;
+
+static int32_t scale_points[SCALE_POINTS_MAX];	/* instances to run */
+static size_t scale_points_num;
+static stress_scale_result_t *scale_results;
+static size_t scale_results_num;
+
+/*
+ *  stress_scale_sweep_set()
+ *	parse the --scale-sweep option, either a maximum N to
+ *	sweep over 1, 2, 4 .. N instances (0 = number of CPUs)
+ *	or a comma separated list of instances
+ */
+int stress_scale_sweep_set(const char *opt)
+{
+	int32_t n;
+
+	scale_points_num = 0;
+	if (!strchr(opt, ',')) {
+		int32_t i;
+
+		n = stress_get_int32(opt);
+		if (n == 0)
+			n = stress_get_processors_configured();
+		stress_check_range("scale-sweep", (uint64_t)n, 1, STRESS_PROCS_MAX);
+
+		for (i = 1; (i < n) && (scale_points_num < SCALE_POINTS_MAX - 1); i <<= 1)
+			scale_points[scale_points_num++] = i;
+		scale_points[scale_points_num++] = n;
+	} else {
+		char *str, *ptr, *token;
+
+		str = strdup(opt);
+		if (!str) {
+			(void)fprintf(stderr, "out of memory parsing '%s'\n", opt);
+			return -1;
+		}
+		for (ptr = str; (token = strtok(ptr, ",")) != NULL; ptr = NULL) {
+			if (scale_points_num >= SCALE_POINTS_MAX) {
+				(void)fprintf(stderr, "scale-sweep: too many instance "
+					"counts, maximum is %d\n", SCALE_POINTS_MAX);
+				free(str);
+				return -1;
+			}
+			n = stress_get_int32(token);
+			if ((n < 1) || (n > STRESS_PROCS_MAX)) {
+				(void)fprintf(stderr, "scale-sweep: instance count %s "
+					"out of range, allowed range 1 to %d\n",
+					token, STRESS_PROCS_MAX);
+				free(str);
+				return -1;
+			}
+			scale_points[scale_points_num++] = n;
+		}
+		free(str);
+	}
+	return 0;
+}
+
+/*
+ *  stress_scale_sweep_points()
+ *	get the instance counts of the sweep, returns the
+ *	number of counts, 0 if there is no sweep
+ */
+size_t stress_scale_sweep_points(const int32_t **points)
+{
+	*points = scale_points;
+	return scale_points_num;
+}
+
+/*
+ *  stress_scale_sweep_record()
+ *	record the throughput of the stressors after a run
+ *	with the given number of instances
+ */
+void stress_scale_sweep_record(
+	stress_stressor_t *stressors_list,
+	const int32_t instances)
+{
+	const stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_scale_result_t *result;
+		uint64_t ops = 0;
+		double run_time = 0.0, rate;
+		int32_t j;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			const stress_stats_t *const stats = ss->stats[j];
+
+			ops += stats->counter;
+			run_time += stats->finish - stats->start;
+		}
+		/* bogo ops over average wall clock time, as in the metrics */
+		run_time = ss->started_instances ?
+			run_time / (double)ss->started_instances : 0.0;
+		rate = (run_time > 0.0) ? (double)ops / run_time : 0.0;
+
+		result = realloc(scale_results,
+			(scale_results_num + 1) * sizeof(*scale_results));
+		if (!result) {
+			pr_err("cannot allocate scale sweep results\n");
+			return;
+		}
+		scale_results = result;
+		result = &scale_results[scale_results_num++];
+		result->ss = ss;
+		result->instances = instances;
+		result->rate = rate;
+
+		pr_inf("%s: %" PRId32 " instance%s, %.2f bogo ops/s\n",
+			stress_munge_underscore(ss->stressor->name),
+			instances, instances == 1 ? "" : "s", rate);
+	}
+}
+
+/*
+ *  stress_scale_fit()
+ *	least squares fit of the Amdahl and Universal Scalability
+ *	Law models, X(n) = X(1) n / (1 + sigma (n - 1) + kappa n (n - 1)),
+ *	by linear regression of n X(1) / X(n) - 1 against (n - 1)
+ *	and n (n - 1). X(1) is the single instance throughput or,
+ *	if 1 instance was not run, extrapolated linearly from the
+ *	smallest instance count run. Returns false if there is
+ *	not enough data for a fit.
+ */
+static bool stress_scale_fit(
+	const stress_stressor_t *ss,
+	double *amdahl_sigma,
+	double *usl_sigma,
+	double *usl_kappa)
+{
+	double saa = 0.0, sab = 0.0, sbb = 0.0, say = 0.0, sby = 0.0;
+	double x1 = 0.0, det;
+	int32_t n_min = INT32_MAX;
+	size_t i, points = 0;
+
+	for (i = 0; i < scale_results_num; i++) {
+		const stress_scale_result_t *r = &scale_results[i];
+
+		if ((r->ss == ss) && (r->instances < n_min) && (r->rate > 0.0)) {
+			n_min = r->instances;
+			x1 = r->rate / (double)r->instances;
+		}
+	}
+	if (x1 <= 0.0)
+		return false;
+
+	for (i = 0; i < scale_results_num; i++) {
+		const stress_scale_result_t *r = &scale_results[i];
+		const double n = (double)r->instances;
+		double a, b, y;
+
+		if ((r->ss != ss) || (r->instances <= 1) || (r->rate <= 0.0))
+			continue;
+		a = n - 1.0;
+		b = n * (n - 1.0);
+		y = ((n * x1) / r->rate) - 1.0;
+		saa += a * a;
+		sab += a * b;
+		sbb += b * b;
+		say += a * y;
+		sby += b * y;
+		points++;
+	}
+	if (!points || (saa <= 0.0))
+		return false;
+
+	*amdahl_sigma = say / saa;
+	det = (saa * sbb) - (sab * sab);
+	if ((points < 2) || (fabs(det) < 1.0E-12 * saa * sbb)) {
+		*usl_sigma = *amdahl_sigma;
+		*usl_kappa = 0.0;
+	} else {
+		*usl_sigma = ((say * sbb) - (sby * sab)) / det;
+		*usl_kappa = ((sby * saa) - (say * sab)) / det;
+	}
+	return true;
+}
+
+/*
+ *  stress_scale_sweep_dump()
+ *	report the throughput, per instance throughput and
+ *	parallel efficiency of each stressor at each instance
+ *	count and the fitted scalability model parameters
+ */
+void stress_scale_sweep_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	if (!scale_results_num)
+		return;
+
+	pr_yaml(yaml, "scale-sweep:\n");
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const char *munged = stress_munge_underscore(ss->stressor->name);
+		double x1 = 0.0, amdahl_sigma, usl_sigma, usl_kappa;
+		int32_t n_min = INT32_MAX;
+		size_t i;
+
+		for (i = 0; i < scale_results_num; i++) {
+			const stress_scale_result_t *r = &scale_results[i];
+
+			if ((r->ss == ss) && (r->instances < n_min)) {
+				n_min = r->instances;
+				x1 = r->rate / (double)r->instances;
+			}
+		}
+		if (n_min == INT32_MAX)
+			continue;
+
+		pr_inf("%-13s %9s %12s %12s %10s\n",
+			"stressor", "instances", "bogo ops/s", "per instance",
+			"efficiency");
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      points:\n");
+		for (i = 0; i < scale_results_num; i++) {
+			const stress_scale_result_t *r = &scale_results[i];
+			double per_instance, efficiency;
+
+			if (r->ss != ss)
+				continue;
+			per_instance = r->rate / (double)r->instances;
+			efficiency = (x1 > 0.0) ? per_instance / x1 : 0.0;
+
+			pr_inf("%-13s %9" PRId32 " %12.2f %12.2f %9.2f%%\n",
+				munged, r->instances, r->rate, per_instance,
+				efficiency * 100.0);
+			pr_yaml(yaml, "        - instances: %" PRId32 "\n", r->instances);
+			pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n", r->rate);
+			pr_yaml(yaml, "          bogo-ops-per-second-per-instance: %f\n", per_instance);
+			pr_yaml(yaml, "          efficiency: %f\n", efficiency);
+		}
+
+		if (stress_scale_fit(ss, &amdahl_sigma, &usl_sigma, &usl_kappa)) {
+			pr_inf("%s: Amdahl serial fraction %.4f, USL contention "
+				"(sigma) %.4f, coherency (kappa) %.6f\n",
+				munged, amdahl_sigma, usl_sigma, usl_kappa);
+			pr_yaml(yaml, "      amdahl-serial-fraction: %f\n", amdahl_sigma);
+			pr_yaml(yaml, "      usl-contention: %f\n", usl_sigma);
+			pr_yaml(yaml, "      usl-coherency: %f\n", usl_kappa);
+			if ((usl_kappa > 0.0) && (usl_sigma < 1.0)) {
+				const double peak = sqrt((1.0 - usl_sigma) / usl_kappa);
+
+				pr_inf("%s: USL predicts peak throughput at %.1f instances\n",
+					munged, peak);
+				pr_yaml(yaml, "      usl-peak-instances: %f\n", peak);
+			}
+		} else {
+			pr_inf("%s: not enough data to fit a scalability model\n",
+				munged);
+		}
+		pr_yaml(yaml, "\n");
+	}
+}
+
+/*
+ *  stress_scale_sweep_free()
+ *	free scale sweep results
+ */
+void stress_scale_sweep_free(void)
+{
+	free(scale_results);
+	scale_results = NULL;
+	scale_results_num = 0;
+	scale_points_num = 0;
+}
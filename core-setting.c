@@ -27,12 +27,139 @@
 static stress_setting_t *setting_head;	/* setting list head */
 static stress_setting_t *setting_tail;	/* setting list tail */
 
+/* Settings visible to a stressor, see stress_find_setting_list() */
+typedef struct {
+	stress_pstressor_info_t proc;	/* stressor that owns settings */
+	size_t end;			/* settings before end are visible */
+	bool used;			/* true if hash slot is in use */
+} stress_setting_proc_t;
+
+/* Hashed index of the setting list */
+static struct {
+	stress_setting_t **settings;	/* settings in list order */
+	size_t *prev;			/* previous setting of same name + 1, 0 = none */
+	size_t *names;			/* last setting of a name + 1, 0 = empty slot */
+	stress_setting_proc_t *procs;	/* visible settings of each stressor */
+	size_t n;			/* number of settings */
+	size_t mask;			/* hash table size - 1 */
+	bool valid;			/* true if index matches the list */
+} setting_index;
+
 #if defined(DEBUG_SETTINGS)
 #define	DBG(...)	pr_inf(__VA_ARGS__)
 #else
 #define DBG(...)
 #endif
 
+/*
+ *  stress_free_settings_index()
+ *	free the settings index
+ */
+static void stress_free_settings_index(void)
+{
+	free(setting_index.settings);
+	free(setting_index.prev);
+	free(setting_index.names);
+	free(setting_index.procs);
+	(void)memset(&setting_index, 0, sizeof(setting_index));
+}
+
+/*
+ *  stress_setting_proc_slot()
+ *	find the hash slot of a stressor in the settings index
+ */
+static size_t stress_setting_proc_slot(const stress_pstressor_info_t proc)
+{
+	size_t h = (size_t)(((uintptr_t)proc >> 4) * 2654435761UL) & setting_index.mask;
+
+	while (setting_index.procs[h].used &&
+	       (setting_index.procs[h].proc != proc))
+		h = (h + 1) & setting_index.mask;
+	return h;
+}
+
+/*
+ *  stress_setting_name_slot()
+ *	find the hash slot of a setting name in the settings index
+ */
+static size_t stress_setting_name_slot(const char *name)
+{
+	size_t h = (size_t)stress_hash_pjw(name) & setting_index.mask;
+
+	while (setting_index.names[h] &&
+	       strcmp(setting_index.settings[setting_index.names[h] - 1]->name, name))
+		h = (h + 1) & setting_index.mask;
+	return h;
+}
+
+/*
+ *  stress_index_settings()
+ *	build a hashed index of the settings so that lookups don't
+ *	have to walk the entire setting list, call this once the
+ *	options are parsed so that the stressor processes inherit it
+ */
+void stress_index_settings(void)
+{
+	stress_setting_t *setting;
+	size_t i, n = 0, size = 16, *open, n_open = 0;
+
+	stress_free_settings_index();
+
+	for (setting = setting_head; setting; setting = setting->next)
+		n++;
+	while (size < n * 2)
+		size <<= 1;
+
+	setting_index.settings = calloc(n ? n : 1, sizeof(*setting_index.settings));
+	setting_index.prev = calloc(n ? n : 1, sizeof(*setting_index.prev));
+	setting_index.names = calloc(size, sizeof(*setting_index.names));
+	setting_index.procs = calloc(size, sizeof(*setting_index.procs));
+	open = calloc(n ? n : 1, sizeof(*open));
+	if (!setting_index.settings || !setting_index.prev ||
+	    !setting_index.names || !setting_index.procs || !open) {
+		/* Lookups fall back to walking the setting list */
+		free(open);
+		stress_free_settings_index();
+		return;
+	}
+	setting_index.n = n;
+	setting_index.mask = size - 1;
+
+	for (i = 0, setting = setting_head; setting; i++, setting = setting->next) {
+		size_t h, j, k;
+
+		setting_index.settings[i] = setting;
+
+		/* Chain the settings of the same name, last one first */
+		h = stress_setting_name_slot(setting->name);
+		setting_index.prev[i] = setting_index.names[h];
+		setting_index.names[h] = i + 1;
+
+		/* A stressor can see up to its first setting */
+		h = stress_setting_proc_slot(setting->proc);
+		if (!setting_index.procs[h].used) {
+			setting_index.procs[h].proc = setting->proc;
+			setting_index.procs[h].end = n;
+			setting_index.procs[h].used = true;
+			open[n_open++] = h;
+		}
+		/* ..and then until the next non-global setting of another stressor */
+		if (setting->global)
+			continue;
+		for (j = 0, k = 0; j < n_open; j++) {
+			stress_setting_proc_t *sp = &setting_index.procs[open[j]];
+
+			if (sp->proc == setting->proc)
+				open[k++] = open[j];
+			else
+				sp->end = i;
+		}
+		n_open = k;
+	}
+	free(open);
+	setting_index.valid = true;
+}
+
 /*
  *  stress_free_settings()
  *	free the saved settings
@@ -50,6 +177,7 @@ void stress_free_settings(void)
 	}
 	setting_head = NULL;
 	setting_tail = NULL;
+	stress_free_settings_index();
 }
 
 
@@ -163,6 +291,7 @@ static int stress_set_setting_generic(
 		break;
 	}
 
+	setting_index.valid = false;
 	if (setting_tail) {
 		setting_tail->next = setting;
 	} else {
@@ -204,122 +333,143 @@ int stress_set_setting_global(
 
 
 /*
- *  stress_get_setting()
- *	get an existing setting;
+ *  stress_find_setting_list()
+ *	walk the setting list to find the setting of name that
+ *	the current stressor sees, this is the last one set
+ *	before the next non-global setting of another stressor
+ *	that follows the first setting of the current stressor
  */
-bool stress_get_setting(const char *name, void *value)
+static stress_setting_t *stress_find_setting_list(const char *name)
 {
-	stress_setting_t *setting;
-	bool set = false;
+	stress_setting_t *setting, *match = NULL;
 	bool found = false;
 
-	DBG("%s: get %s\n", __func__, name);
-
 	for (setting = setting_head; setting; setting = setting->next) {
 		if (setting->proc == g_stressor_current)
 			found = true;
 		if (found && ((setting->proc != g_stressor_current) && (!setting->global)))
 			break;
+		if (!strcmp(setting->name, name))
+			match = setting;
+	}
+	return match;
+}
 
-		if (!strcmp(setting->name, name)) {
-			switch (setting->type_id) {
-			case TYPE_ID_UINT8:
-				set = true;
-				*(uint8_t *)value = setting->u.uint8;
-				DBG("%s: UINT8: %s -> %" PRIu8 "\n", __func__, name, setting->u.uint8);
-				break;
-			case TYPE_ID_INT8:
-				set = true;
-				*(int8_t *)value = setting->u.int8;
-				DBG("%s: INT8: %s -> %" PRId8 "\n", __func__, name, setting->u.int8);
-				break;
-			case TYPE_ID_UINT16:
-				set = true;
-				*(uint16_t *)value = setting->u.uint16;
-				DBG("%s: UINT16: %s -> %" PRIu16 "\n", __func__, name, setting->u.uint16);
-				break;
-			case TYPE_ID_INT16:
-				set = true;
-				*(int16_t *)value = setting->u.int16;
-				DBG("%s: INT16: %s -> %" PRId16 "\n", __func__, name, setting->u.int16);
-				break;
-			case TYPE_ID_UINT32:
-				set = true;
-				*(uint32_t *)value = setting->u.uint32;
-				DBG("%s: UINT32: %s -> %" PRIu32 "\n", __func__, name, setting->u.uint32);
-				break;
-			case TYPE_ID_INT32:
-				set = true;
-				*(int32_t *)value = setting->u.int32;
-				DBG("%s: INT32: %s -> %" PRId32 "\n", __func__, name, setting->u.int32);
-				break;
-			case TYPE_ID_UINT64:
-				set = true;
-				*(uint64_t *)value = setting->u.uint64;
-				DBG("%s: UINT64: %s -> %" PRIu64 "\n", __func__, name, setting->u.uint64);
-				break;
-			case TYPE_ID_INT64:
-				set = true;
-				*(int64_t *)value = setting->u.int64;
-				DBG("%s: INT64: %s -> %" PRId64 "\n", __func__, name, setting->u.int64);
-				break;
-			case TYPE_ID_SIZE_T:
-				set = true;
-				*(size_t *)value = setting->u.size;
-				DBG("%s: SIZE_T: %s -> %zu\n", __func__, name, setting->u.size);
-				break;
-			case TYPE_ID_SSIZE_T:
-				set = true;
-				*(ssize_t *)value = setting->u.ssize;
-				DBG("%s: SSIZE_T: %s -> %zd\n", __func__, name, setting->u.ssize);
-				break;
-			case TYPE_ID_UINT:
-				set = true;
-				*(unsigned int *)value = setting->u.uint;
-				DBG("%s: UINT: %s -> %u\n", __func__, name, setting->u.uint);
-				break;
-			case TYPE_ID_INT:
-				set = true;
-				*(int *)value = setting->u.sint;
-				DBG("%s: UINT: %s -> %d\n", __func__, name, setting->u.sint);
-				break;
-			case TYPE_ID_ULONG:
-				set = true;
-				*(unsigned long  *)value = setting->u.ulong;
-				DBG("%s: ULONG: %s -> %lu\n", __func__, name, setting->u.ulong);
-				break;
-			case TYPE_ID_LONG:
-				set = true;
-				*(long *)value = setting->u.slong;
-				DBG("%s: LONG: %s -> %ld\n", __func__, name, setting->u.slong);
-				break;
-			case TYPE_ID_OFF_T:
-				set = true;
-				*(long  *)value = setting->u.off;
-				DBG("%s: OFF_T: %s -> %lu\n", __func__, name, (unsigned long)setting->u.off);
-				break;
-			case TYPE_ID_STR:
-				set = true;
-				*(const char **)value = setting->u.str;
-				DBG("%s: STR: %s -> %s\n", __func__, name, setting->u.str);
-				break;
-			case TYPE_ID_BOOL:
-				set = true;
-				*(bool *)value = setting->u.boolean;
-				DBG("%s: BOOL: %s -> %d\n", __func__, name, setting->u.boolean);
-				break;
-			case TYPE_ID_UINTPTR_T:
-				set = true;
-				*(uintptr_t *)value = setting->u.uintptr;
-				DBG("%s: UINTPTR_T: %s -> %p\n", __func__, name, (void *)setting->u.uintptr);
-				break;
-			case TYPE_ID_UNDEFINED:
-			default:
-				set = true;
-				DBG("%s: UNDEF: %s -> ?\n", __func__, name);
-				break;
-			}
-		}
+/*
+ *  stress_find_setting()
+ *	find the setting of name that the current stressor sees
+ */
+static stress_setting_t *stress_find_setting(const char *name)
+{
+	size_t i, end, h;
+
+	if (!setting_index.valid)
+		stress_index_settings();
+	if (!setting_index.valid)
+		return stress_find_setting_list(name);
+
+	h = stress_setting_proc_slot(g_stressor_current);
+	end = setting_index.procs[h].used ? setting_index.procs[h].end : setting_index.n;
+
+	h = stress_setting_name_slot(name);
+	for (i = setting_index.names[h]; i; i = setting_index.prev[i - 1]) {
+		if (i - 1 < end)
+			return setting_index.settings[i - 1];
+	}
+	return NULL;
+}
+
+/*
+ *  stress_get_setting()
+ *	get an existing setting;
+ */
+bool stress_get_setting(const char *name, void *value)
+{
+	const stress_setting_t *setting;
+
+	DBG("%s: get %s\n", __func__, name);
+
+	setting = stress_find_setting(name);
+	if (!setting)
+		return false;
+
+	switch (setting->type_id) {
+	case TYPE_ID_UINT8:
+		*(uint8_t *)value = setting->u.uint8;
+		DBG("%s: UINT8: %s -> %" PRIu8 "\n", __func__, name, setting->u.uint8);
+		break;
+	case TYPE_ID_INT8:
+		*(int8_t *)value = setting->u.int8;
+		DBG("%s: INT8: %s -> %" PRId8 "\n", __func__, name, setting->u.int8);
+		break;
+	case TYPE_ID_UINT16:
+		*(uint16_t *)value = setting->u.uint16;
+		DBG("%s: UINT16: %s -> %" PRIu16 "\n", __func__, name, setting->u.uint16);
+		break;
+	case TYPE_ID_INT16:
+		*(int16_t *)value = setting->u.int16;
+		DBG("%s: INT16: %s -> %" PRId16 "\n", __func__, name, setting->u.int16);
+		break;
+	case TYPE_ID_UINT32:
+		*(uint32_t *)value = setting->u.uint32;
+		DBG("%s: UINT32: %s -> %" PRIu32 "\n", __func__, name, setting->u.uint32);
+		break;
+	case TYPE_ID_INT32:
+		*(int32_t *)value = setting->u.int32;
+		DBG("%s: INT32: %s -> %" PRId32 "\n", __func__, name, setting->u.int32);
+		break;
+	case TYPE_ID_UINT64:
+		*(uint64_t *)value = setting->u.uint64;
+		DBG("%s: UINT64: %s -> %" PRIu64 "\n", __func__, name, setting->u.uint64);
+		break;
+	case TYPE_ID_INT64:
+		*(int64_t *)value = setting->u.int64;
+		DBG("%s: INT64: %s -> %" PRId64 "\n", __func__, name, setting->u.int64);
+		break;
+	case TYPE_ID_SIZE_T:
+		*(size_t *)value = setting->u.size;
+		DBG("%s: SIZE_T: %s -> %zu\n", __func__, name, setting->u.size);
+		break;
+	case TYPE_ID_SSIZE_T:
+		*(ssize_t *)value = setting->u.ssize;
+		DBG("%s: SSIZE_T: %s -> %zd\n", __func__, name, setting->u.ssize);
+		break;
+	case TYPE_ID_UINT:
+		*(unsigned int *)value = setting->u.uint;
+		DBG("%s: UINT: %s -> %u\n", __func__, name, setting->u.uint);
+		break;
+	case TYPE_ID_INT:
+		*(int *)value = setting->u.sint;
+		DBG("%s: UINT: %s -> %d\n", __func__, name, setting->u.sint);
+		break;
+	case TYPE_ID_ULONG:
+		*(unsigned long  *)value = setting->u.ulong;
+		DBG("%s: ULONG: %s -> %lu\n", __func__, name, setting->u.ulong);
+		break;
+	case TYPE_ID_LONG:
+		*(long *)value = setting->u.slong;
+		DBG("%s: LONG: %s -> %ld\n", __func__, name, setting->u.slong);
+		break;
+	case TYPE_ID_OFF_T:
+		*(long  *)value = setting->u.off;
+		DBG("%s: OFF_T: %s -> %lu\n", __func__, name, (unsigned long)setting->u.off);
+		break;
+	case TYPE_ID_STR:
+		*(const char **)value = setting->u.str;
+		DBG("%s: STR: %s -> %s\n", __func__, name, setting->u.str);
+		break;
+	case TYPE_ID_BOOL:
+		*(bool *)value = setting->u.boolean;
+		DBG("%s: BOOL: %s -> %d\n", __func__, name, setting->u.boolean);
+		break;
+	case TYPE_ID_UINTPTR_T:
+		*(uintptr_t *)value = setting->u.uintptr;
+		DBG("%s: UINTPTR_T: %s -> %p\n", __func__, name, (void *)setting->u.uintptr);
+		break;
+	case TYPE_ID_UNDEFINED:
+	default:
+		DBG("%s: UNDEF: %s -> ?\n", __func__, name);
+		break;
 	}
-	return set;
+	return true;
 }
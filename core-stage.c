@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2017-2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define STAGES_MAX	(1024)
+
+static const char * const stage_names[] = {
+	"ramp",
+	"hold",
+	"step",
+	"spike",
+	"drain",
+};
+
+/*
+ *  stress_stage_add()
+ *	add a stage to the staged load profile of a stressor
+ */
+static int stress_stage_add(
+	stress_stressor_t *ss,
+	const stress_stage_type_t type,
+	const int32_t from,
+	const int32_t to,
+	const uint64_t duration)
+{
+	stress_stages_t *stages = ss->stages;
+	stress_stage_t *stage;
+
+	if (!stages) {
+		stages = calloc(1, sizeof(*stages));
+		if (!stages)
+			return -1;
+		ss->stages = stages;
+	}
+	if (stages->num >= STAGES_MAX) {
+		(void)fprintf(stderr, "Too many stages, maximum is %d\n", STAGES_MAX);
+		return -1;
+	}
+	stage = realloc(stages->stage, (stages->num + 1) * sizeof(*stage));
+	if (!stage)
+		return -1;
+	stages->stage = stage;
+	stage = &stages->stage[stages->num++];
+	(void)memset(stage, 0, sizeof(*stage));
+	stage->type = type;
+	stage->from = from;
+	stage->to = to;
+	stage->duration = (double)duration;
+
+	/*
+	 *  Each instance started needs its own slot,
+	 *  instances are never restarted
+	 */
+	if (from > stages->level)
+		stages->slots += from - stages->level;
+	if (to > from)
+		stages->slots += to - from;
+	/* A spike returns to the level before the spike */
+	if (type != STRESS_STAGE_SPIKE)
+		stages->level = to;
+
+	return 0;
+}
+
+/*
+ *  stress_stage_parse()
+ *	parse the job file "stage" command that adds a stage
+ *	to the staged load profile of the previous stressor:
+ *
+ *	stage ramp from to time	ramp from..to instances over time
+ *	stage hold time		hold the current instances for time
+ *	stage step n time	step to n instances for time
+ *	stage spike n time	step to n instances for time, then
+ *				return to the previous level
+ *	stage drain time	ramp down to zero instances over time
+ *
+ *	returns 1 if parsed, 0 if not a stage command, -1 on error
+ */
+int stress_stage_parse(const char *jobfile, const int argc, char **argv)
+{
+	stress_stressor_t *ss = g_stressor_current;
+	int32_t from, to;
+	uint64_t duration;
+	int ret;
+
+	if ((argc < 2) || strcmp(argv[1], "stage"))
+		return 0;
+
+	if (!ss) {
+		(void)fprintf(stderr, "A stage must follow a stressor in jobfile %s\n",
+			jobfile);
+		return -1;
+	}
+	if (argc < 3)
+		goto usage;
+
+	from = ss->stages ? ss->stages->level : 0;
+	if (!strcmp(argv[2], "ramp")) {
+		if (argc != 6)
+			goto usage;
+		from = stress_get_int32(argv[3]);
+		stress_check_range("stage ramp", (uint64_t)from, 0, STRESS_PROCS_MAX);
+		to = stress_get_int32(argv[4]);
+		stress_check_range("stage ramp", (uint64_t)to, 0, STRESS_PROCS_MAX);
+		duration = stress_get_uint64_time(argv[5]);
+		ret = stress_stage_add(ss, STRESS_STAGE_RAMP, from, to, duration);
+	} else if (!strcmp(argv[2], "hold")) {
+		if (argc != 4)
+			goto usage;
+		duration = stress_get_uint64_time(argv[3]);
+		ret = stress_stage_add(ss, STRESS_STAGE_HOLD, from, from, duration);
+	} else if (!strcmp(argv[2], "step") ||
+		   !strcmp(argv[2], "spike")) {
+		const stress_stage_type_t type = strcmp(argv[2], "step") ?
+			STRESS_STAGE_SPIKE : STRESS_STAGE_STEP;
+
+		if (argc != 5)
+			goto usage;
+		to = stress_get_int32(argv[3]);
+		stress_check_range("stage step", (uint64_t)to, 0, STRESS_PROCS_MAX);
+		duration = stress_get_uint64_time(argv[4]);
+		ret = stress_stage_add(ss, type, to, to, duration);
+	} else if (!strcmp(argv[2], "drain")) {
+		if (argc != 4)
+			goto usage;
+		duration = stress_get_uint64_time(argv[3]);
+		ret = stress_stage_add(ss, STRESS_STAGE_DRAIN, from, 0, duration);
+	} else {
+		goto usage;
+	}
+	if (ret < 0) {
+		(void)fprintf(stderr, "Cannot add stage in jobfile %s\n", jobfile);
+		return -1;
+	}
+	return 1;
+
+usage:
+	(void)fprintf(stderr, "Invalid stage in jobfile %s, expecting one of: "
+		"ramp from to time, hold time, step n time, "
+		"spike n time or drain time\n", jobfile);
+	return -1;
+}
+
+/*
+ *  stress_stage_free()
+ *	free a staged load profile
+ */
+void stress_stage_free(stress_stages_t *stages)
+{
+	size_t i;
+
+	if (!stages)
+		return;
+
+	for (i = 0; i < stages->num; i++)
+		free(stages->stage[i].latency);
+	free(stages->stage);
+	free(stages->latency);
+	free(stages);
+}
+
+/*
+ *  stress_stage_counters()
+ *	get the total bogo ops and, if latency is being
+ *	measured, the merged latency of all the instances
+ */
+static uint64_t stress_stage_counters(
+	const stress_stressor_t *ss,
+	stress_latency_t *latency)
+{
+	int32_t j;
+	uint64_t ops = 0;
+
+	if (latency)
+		stress_latency_init(latency);
+
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		ops += stats->counter;
+		if (latency && stats->latency)
+			stress_latency_merge(latency, stats->latency);
+	}
+	return ops;
+}
+
+/*
+ *  stress_stage_start()
+ *	start the staged load profile of a stressor
+ */
+void stress_stage_start(stress_stressor_t *ss, const double now)
+{
+	stress_stages_t *stages = ss->stages;
+
+	if (!stages)
+		return;
+
+	stages->current = 0;
+	stages->oldest = 0;
+	stages->time_start = now;
+	stages->stage_start = now;
+	stages->ops_start = 0;
+	if ((g_opt_flags & OPT_FLAGS_LATENCY) && !stages->latency) {
+		stages->latency = malloc(sizeof(*stages->latency));
+		if (stages->latency)
+			stress_latency_init(stages->latency);
+	}
+}
+
+/*
+ *  stress_stage_end()
+ *	gather the metrics of the current stage and move
+ *	on to the next stage
+ */
+static void stress_stage_end(stress_stressor_t *ss, const double now)
+{
+	stress_stages_t *stages = ss->stages;
+	stress_stage_t *stage = &stages->stage[stages->current];
+	stress_latency_t *latency = NULL;
+	uint64_t ops;
+
+	if (stages->latency) {
+		latency = malloc(sizeof(*latency));
+		if (latency)
+			stage->latency = latency;
+	}
+	ops = stress_stage_counters(ss, latency);
+	stage->done = true;
+	stage->start = stages->stage_start - stages->time_start;
+	stage->run_time = now - stages->stage_start;
+	stage->ops = ops - stages->ops_start;
+	if (latency) {
+		/* latency is the total so far, make it the stage delta */
+		stress_latency_sub(latency, stages->latency);
+		stress_latency_merge(stages->latency, latency);
+	}
+	stages->ops_start = ops;
+	stages->stage_start = now;
+	stages->current++;
+
+	pr_inf("%s: stage %zu (%s %" PRId32 " -> %" PRId32 ") %.2fs, "
+		"%" PRIu64 " bogo ops, %.2f bogo ops/s\n",
+		stress_munge_underscore(ss->stressor->name),
+		stages->current, stage_names[stage->type],
+		stage->from, stage->to, stage->run_time, stage->ops,
+		stage->run_time > 0.0 ? (double)stage->ops / stage->run_time : 0.0);
+}
+
+/*
+ *  stress_stage_instances()
+ *	return the number of instances of a stressor that
+ *	should be running now, stages that have completed
+ *	have their metrics gathered
+ */
+int32_t stress_stage_instances(stress_stressor_t *ss, const double now)
+{
+	stress_stages_t *stages = ss->stages;
+	const stress_stage_t *stage;
+	double t;
+
+	if (!stages)
+		return ss->num_instances;
+
+	while (stages->current < stages->num) {
+		stage = &stages->stage[stages->current];
+		if (now < stages->stage_start + stage->duration)
+			break;
+		stress_stage_end(ss, stages->stage_start + stage->duration);
+	}
+	if (stages->current >= stages->num)
+		return 0;
+
+	stage = &stages->stage[stages->current];
+	if ((stage->from == stage->to) || (stage->duration <= 0.0))
+		return stage->to;
+
+	t = (now - stages->stage_start) / stage->duration;
+	return stage->from + (int32_t)floor(((double)(stage->to - stage->from) * t) + 0.5);
+}
+
+/*
+ *  stress_stage_finish()
+ *	the run has ended, gather the metrics of the stage
+ *	that was running if it had not completed
+ */
+void stress_stage_finish(stress_stressor_t *ss, const double now)
+{
+	stress_stages_t *stages = ss->stages;
+
+	if (!stages)
+		return;
+
+	(void)stress_stage_instances(ss, now);
+	if (stages->current < stages->num)
+		stress_stage_end(ss, now);
+}
+
+/*
+ *  stress_stage_pending()
+ *	return true if any stressor has stages that have
+ *	not completed
+ */
+bool stress_stage_pending(const stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (ss->stages && (ss->stages->current < ss->stages->num))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *  stress_stage_dump()
+ *	dump the per stage metrics to the YAML file
+ */
+void stress_stage_dump(FILE *yaml, stress_stressor_t *stressors_list)
+{
+	stress_stressor_t *ss;
+	bool dumped_heading = false;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		const stress_stages_t *stages = ss->stages;
+		size_t i;
+
+		if (!stages)
+			continue;
+		if (!dumped_heading) {
+			pr_yaml(yaml, "stages:\n");
+			dumped_heading = true;
+		}
+		pr_yaml(yaml, "    - stressor: %s\n",
+			stress_munge_underscore(ss->stressor->name));
+		pr_yaml(yaml, "      stages:\n");
+
+		for (i = 0; i < stages->num; i++) {
+			const stress_stage_t *stage = &stages->stage[i];
+
+			if (!stage->done)
+				continue;
+
+			pr_yaml(yaml, "        - stage: %zu\n", i + 1);
+			pr_yaml(yaml, "          type: %s\n", stage_names[stage->type]);
+			pr_yaml(yaml, "          instances-start: %" PRId32 "\n", stage->from);
+			pr_yaml(yaml, "          instances-end: %" PRId32 "\n", stage->to);
+			pr_yaml(yaml, "          start-time: %f\n", stage->start);
+			pr_yaml(yaml, "          duration: %f\n", stage->duration);
+			pr_yaml(yaml, "          run-time: %f\n", stage->run_time);
+			pr_yaml(yaml, "          bogo-ops: %" PRIu64 "\n", stage->ops);
+			pr_yaml(yaml, "          bogo-ops-per-second-real-time: %f\n",
+				stage->run_time > 0.0 ?
+				(double)stage->ops / stage->run_time : 0.0);
+			if (stage->latency && stage->latency->count) {
+				const stress_latency_t *latency = stage->latency;
+
+				pr_yaml(yaml, "          latency-samples: %" PRIu64 "\n",
+					latency->count);
+				pr_yaml(yaml, "          latency-p50-ns: %" PRIu64 "\n",
+					stress_latency_percentile(latency, 50.0));
+				pr_yaml(yaml, "          latency-p90-ns: %" PRIu64 "\n",
+					stress_latency_percentile(latency, 90.0));
+				pr_yaml(yaml, "          latency-p99-ns: %" PRIu64 "\n",
+					stress_latency_percentile(latency, 99.0));
+				pr_yaml(yaml, "          latency-p99.9-ns: %" PRIu64 "\n",
+					stress_latency_percentile(latency, 99.9));
+				pr_yaml(yaml, "          latency-max-ns: %" PRIu64 "\n",
+					latency->max_ns);
+			}
+		}
+		pr_yaml(yaml, "\n");
+	}
+}
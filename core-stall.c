@@ -0,0 +1,423 @@
+/*
+ * Copyright (C) 2020 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#include "stress-ng.h"
+
+#define STALL_CHECK_PERIOD	(0.5)	/* secs between counter checks */
+#define STALL_STACK_FRAMES	(8)	/* kernel stack frames to record */
+
+/* Bogo-op counter progress of a stressor instance */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	int32_t instance;		/* stressor instance number */
+	pid_t pid;			/* pid being watched, 0 = none */
+	uint64_t counter;		/* last bogo-op counter value */
+	double moved;			/* time counter last changed */
+	bool stalled;			/* stall already reported */
+} stress_stall_watch_t;
+
+/* Evidence captured from a stalled instance */
+typedef struct {
+	char name[64];			/* stressor name */
+	int32_t instance;		/* stressor instance number */
+	pid_t pid;			/* process id */
+	double stalled;			/* secs the counter had not moved */
+	uint64_t counter;		/* bogo-op counter when stalled */
+	char state[32];			/* process state */
+	char wchan[64];			/* kernel function it is waiting in */
+	char stack[512];		/* top kernel stack frames */
+	uint64_t run_ns;		/* time spent on the cpu */
+	uint64_t wait_ns;		/* time spent waiting on a run queue */
+	uint64_t slices;		/* timeslices run */
+	uint64_t vcsw;			/* voluntary context switches */
+	uint64_t nvcsw;			/* involuntary context switches */
+	bool killed;			/* killed by --stall-kill */
+} stress_stall_t;
+
+static stress_stall_watch_t *stall_watch;
+static size_t stall_watch_num;
+static stress_stall_t *stalls;
+static size_t stalls_num;
+static double stall_timeout;
+static double stall_time_next;
+static bool stall_running;
+
+/*
+ *  stress_stall_read()
+ *	read the first line of a /proc file into buf,
+ *	returns false if it cannot be read
+ */
+static bool stress_stall_read(const char *path, char *buf, const size_t len)
+{
+	FILE *fp;
+	char *ptr;
+
+	*buf = '\0';
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	ptr = fgets(buf, (int)len, fp);
+	(void)fclose(fp);
+	if (!ptr)
+		return false;
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return true;
+}
+
+/*
+ *  stress_stall_alive()
+ *	true if pid is running or sleeping and not a zombie
+ */
+static bool stress_stall_alive(const pid_t pid)
+{
+	char path[64], buf[256];
+	const char *ptr;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	if (!stress_stall_read(path, buf, sizeof(buf)))
+		return false;
+	/* state follows the command name, which can contain spaces */
+	ptr = strrchr(buf, ')');
+	if (!ptr || (ptr[1] != ' '))
+		return false;
+
+	return (ptr[2] != 'Z') && (ptr[2] != 'X') && (ptr[2] != 'x');
+}
+
+/*
+ *  stress_stall_stack()
+ *	get the top kernel stack frames of pid, /proc/pid/stack
+ *	is only readable with CAP_SYS_ADMIN
+ */
+static void stress_stall_stack(const pid_t pid, char *stack, const size_t len)
+{
+	FILE *fp;
+	char path[64], buf[256];
+	size_t frames = 0;
+
+	*stack = '\0';
+	(void)snprintf(path, sizeof(path), "/proc/%d/stack", (int)pid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	while ((frames < STALL_STACK_FRAMES) && fgets(buf, sizeof(buf), fp)) {
+		/* lines are of the form "[<0>] do_wait+0x1c/0x1e0" */
+		char *func = strchr(buf, ' ');
+
+		if (!func)
+			continue;
+		func++;
+		func[strcspn(func, "+\n")] = '\0';
+		if (!*func)
+			continue;
+		if (frames)
+			(void)shim_strlcat(stack, " < ", len);
+		(void)shim_strlcat(stack, func, len);
+		frames++;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_stall_capture()
+ *	capture where a stalled instance is stuck from /proc
+ */
+static void stress_stall_capture(const pid_t pid, stress_stall_t *stall)
+{
+	FILE *fp;
+	char path[64], buf[256];
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/wchan", (int)pid);
+	if (!stress_stall_read(path, stall->wchan, sizeof(stall->wchan)) ||
+	    !strcmp(stall->wchan, "0"))
+		(void)shim_strlcpy(stall->wchan, "-", sizeof(stall->wchan));
+
+	stress_stall_stack(pid, stall->stack, sizeof(stall->stack));
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/schedstat", (int)pid);
+	if (stress_stall_read(path, buf, sizeof(buf)))
+		(void)sscanf(buf, "%" SCNu64 " %" SCNu64 " %" SCNu64,
+			&stall->run_ns, &stall->wait_ns, &stall->slices);
+
+	(void)shim_strlcpy(stall->state, "-", sizeof(stall->state));
+	(void)snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (!strncmp(buf, "State:", 6)) {
+			const char *ptr = buf + 6;
+
+			while (isspace((int)*ptr))
+				ptr++;
+			(void)shim_strlcpy(stall->state, ptr, sizeof(stall->state));
+			stall->state[strcspn(stall->state, "\n")] = '\0';
+		} else if (!strncmp(buf, "voluntary_ctxt_switches:", 24)) {
+			(void)sscanf(buf + 24, "%" SCNu64, &stall->vcsw);
+		} else if (!strncmp(buf, "nonvoluntary_ctxt_switches:", 27)) {
+			(void)sscanf(buf + 27, "%" SCNu64, &stall->nvcsw);
+		}
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_stall_report()
+ *	capture and report a stalled instance, and kill it
+ *	with --stall-kill
+ */
+static void stress_stall_report(const stress_stall_watch_t *watch, const double now)
+{
+	stress_stall_t *stall, *tmp;
+
+	tmp = realloc(stalls, sizeof(*stalls) * (stalls_num + 1));
+	if (!tmp) {
+		pr_inf("stall-detect: cannot allocate stall record\n");
+		return;
+	}
+	stalls = tmp;
+	stall = &stalls[stalls_num++];
+	(void)memset(stall, 0, sizeof(*stall));
+
+	(void)shim_strlcpy(stall->name,
+		stress_munge_underscore(watch->ss->stressor->name), sizeof(stall->name));
+	stall->instance = watch->instance;
+	stall->pid = watch->pid;
+	stall->stalled = now - watch->moved;
+	stall->counter = watch->counter;
+	stress_stall_capture(watch->pid, stall);
+
+	pr_inf("stall-detect: stress-ng-%s instance %" PRId32 " [%d] "
+		"bogo-ops stalled at %" PRIu64 " for %.1f secs, state %s, wchan %s\n",
+		stall->name, stall->instance, (int)stall->pid,
+		stall->counter, stall->stalled, stall->state, stall->wchan);
+	if (*stall->stack)
+		pr_inf("stall-detect: [%d] kernel stack: %s\n",
+			(int)stall->pid, stall->stack);
+	pr_inf("stall-detect: [%d] on cpu %.3f secs, run queue wait %.3f secs, "
+		"%" PRIu64 " timeslices, %" PRIu64 " voluntary and %" PRIu64
+		" involuntary context switches\n",
+		(int)stall->pid, (double)stall->run_ns / 1000000000.0,
+		(double)stall->wait_ns / 1000000000.0, stall->slices,
+		stall->vcsw, stall->nvcsw);
+
+	if (g_opt_flags & OPT_FLAGS_STALL_KILL) {
+		if (kill(watch->pid, SIGKILL) == 0) {
+			stall->killed = true;
+			pr_inf("stall-detect: killed stress-ng-%s [%d]\n",
+				stall->name, (int)stall->pid);
+		}
+	}
+}
+
+/*
+ *  stress_set_stall_detect()
+ *	set the time a bogo-op counter can stand still
+ *	before the instance is reported as stalled
+ */
+int stress_set_stall_detect(const char *opt)
+{
+	uint64_t stall_detect = stress_get_uint64_time(opt);
+
+	if (stall_detect < 1) {
+		(void)fprintf(stderr, "stall-detect must be at least 1 second\n");
+		return -1;
+	}
+	return stress_set_setting_global("stall-detect", TYPE_ID_UINT64, &stall_detect);
+}
+
+/*
+ *  stress_stall_init()
+ *	enable stall detection if --stall-detect is used
+ */
+void stress_stall_init(void)
+{
+	uint64_t stall_detect = 0;
+
+	(void)stress_get_setting("stall-detect", &stall_detect);
+	stall_timeout = (double)stall_detect;
+	if ((g_opt_flags & OPT_FLAGS_STALL_KILL) && (stall_detect == 0))
+		pr_inf("stall-kill has no effect without --stall-detect\n");
+}
+
+/*
+ *  stress_stall_active()
+ *	true if instances are being watched for stalls
+ */
+bool stress_stall_active(void)
+{
+	return stall_running;
+}
+
+/*
+ *  stress_stall_start()
+ *	start watching the bogo-op counters of all the
+ *	instances of the stressors in a run
+ */
+void stress_stall_start(stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+	size_t n = 0;
+
+	if (stall_timeout <= 0.0)
+		return;
+
+	for (ss = stressors_list; ss; ss = ss->next)
+		n += (size_t)ss->num_instances;
+	if (!n)
+		return;
+
+	stall_watch = calloc(n, sizeof(*stall_watch));
+	if (!stall_watch) {
+		pr_inf("stall-detect: cannot allocate %zu instance watches, "
+			"stall detection disabled\n", n);
+		return;
+	}
+	for (n = 0, ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		for (j = 0; j < ss->num_instances; j++, n++) {
+			stall_watch[n].ss = ss;
+			stall_watch[n].instance = j;
+		}
+	}
+	stall_watch_num = n;
+	stall_time_next = stress_time_now() + STALL_CHECK_PERIOD;
+	stall_running = true;
+}
+
+/*
+ *  stress_stall_tick()
+ *	check for instances whose bogo-op counter has not
+ *	moved for the --stall-detect time while still alive
+ */
+void stress_stall_tick(const double now)
+{
+	size_t i;
+
+	if (!stall_running || (now < stall_time_next))
+		return;
+	stall_time_next = now + STALL_CHECK_PERIOD;
+
+	for (i = 0; i < stall_watch_num; i++) {
+		stress_stall_watch_t *watch = &stall_watch[i];
+		const int32_t j = watch->instance;
+		const pid_t pid = (j < watch->ss->started_instances) ?
+			watch->ss->pids[j] : 0;
+		uint64_t counter;
+
+		/* Instance not started yet, finished or a new instance */
+		if (pid != watch->pid) {
+			watch->pid = pid;
+			watch->counter = pid ? watch->ss->stats[j]->counter : 0;
+			watch->moved = now;
+			watch->stalled = false;
+			continue;
+		}
+		if (!pid)
+			continue;
+
+		counter = watch->ss->stats[j]->counter;
+		if (counter != watch->counter) {
+			watch->counter = counter;
+			watch->moved = now;
+			watch->stalled = false;
+			continue;
+		}
+		if (watch->stalled || (now - watch->moved < stall_timeout))
+			continue;
+		if (!stress_stall_alive(pid))
+			continue;
+		watch->stalled = true;
+		stress_stall_report(watch, now);
+	}
+}
+
+/*
+ *  stress_stall_stop()
+ *	stop watching the instances at the end of a run
+ */
+void stress_stall_stop(void)
+{
+	free(stall_watch);
+	stall_watch = NULL;
+	stall_watch_num = 0;
+	stall_running = false;
+}
+
+/*
+ *  stress_stall_dump()
+ *	summarize the stalled instances and where they were stuck
+ */
+void stress_stall_dump(FILE *yaml)
+{
+	size_t i;
+
+	if (stall_timeout <= 0.0)
+		return;
+	if (!stalls_num) {
+		pr_inf("stall-detect: no bogo-op counter stalls of %.0f secs "
+			"or more detected\n", stall_timeout);
+		return;
+	}
+
+	pr_inf("%-13s %8s %8s %9s %-16s %-24s %s\n", "stressor", "instance",
+		"pid", "stall (s)", "state", "wchan", "killed");
+	stress_report_list(yaml, "stalls");
+	for (i = 0; i < stalls_num; i++) {
+		const stress_stall_t *stall = &stalls[i];
+
+		pr_inf("%-13s %8" PRId32 " %8d %9.1f %-16.16s %-24.24s %s\n",
+			stall->name, stall->instance, (int)stall->pid,
+			stall->stalled, stall->state, stall->wchan,
+			stall->killed ? "yes" : "no");
+		stress_report_item(yaml, "stressor", stall->name);
+		stress_report_uint64(yaml, "instance", (uint64_t)stall->instance);
+		stress_report_int64(yaml, "pid", (int64_t)stall->pid);
+		stress_report_double(yaml, "stall-time", stall->stalled);
+		stress_report_uint64(yaml, "bogo-ops", stall->counter);
+		stress_report_str(yaml, "state", "%s", stall->state);
+		stress_report_str(yaml, "wchan", "%s", stall->wchan);
+		if (*stall->stack)
+			stress_report_str(yaml, "kernel-stack", "%s", stall->stack);
+		stress_report_double(yaml, "cpu-time", (double)stall->run_ns / 1000000000.0);
+		stress_report_double(yaml, "run-queue-wait-time", (double)stall->wait_ns / 1000000000.0);
+		stress_report_uint64(yaml, "timeslices", stall->slices);
+		stress_report_uint64(yaml, "voluntary-context-switches", stall->vcsw);
+		stress_report_uint64(yaml, "involuntary-context-switches", stall->nvcsw);
+		stress_report_str(yaml, "killed", "%s", stall->killed ? "yes" : "no");
+	}
+	stress_report_end(yaml);
+}
+
+/*
+ *  stress_stall_free()
+ *	free the stall records
+ */
+void stress_stall_free(void)
+{
+	stress_stall_stop();
+	free(stalls);
+	stalls = NULL;
+	stalls_num = 0;
+	stall_timeout = 0.0;
+}
@@ -25,6 +25,54 @@
 #include "stress-ng.h"
 
 #if defined(STRESS_THERMAL_ZONES)
+#define TZ_SAMPLE_PERIOD	(1.0)	/* seconds between samples */
+#define TZ_THROTTLE_PERCENT	(95.0)	/* frequency drop threshold, % of cool */
+#define TZ_BUSY_PERCENT		(50.0)	/* non-idle time for a CPU to be busy */
+#define TZ_THROTTLE_WINDOWS_MAX	(64)
+
+/* Temperature statistics of a thermal zone sampled by the parent */
+typedef struct {
+	const stress_tz_info_t *tz_info;/* thermal zone */
+	uint64_t trip;			/* lowest passive trip point, 0 = none */
+	uint64_t min;			/* min temperature, millidegrees C */
+	uint64_t max;			/* max temperature, millidegrees C */
+	double sum;			/* sum of temperatures */
+	uint64_t count;			/* number of samples */
+} stress_tz_series_t;
+
+/* Frequency statistics of a CPU sampled by the parent */
+typedef struct {
+	uint64_t max_freq;		/* cpuinfo_max_freq, kHz, 0 = unknown */
+	uint64_t min;			/* min frequency, kHz */
+	uint64_t max;			/* max frequency, kHz */
+	double sum;			/* sum of frequencies */
+	uint64_t count;			/* number of samples */
+	double cool_sum;		/* sum of busy frequencies when cool */
+	uint64_t cool_count;		/* number of busy samples when cool */
+	uint64_t busy_ticks;		/* previous non-idle time, /proc/stat */
+	uint64_t total_ticks;		/* previous total time, /proc/stat */
+	bool busy;			/* mostly non-idle since last sample */
+} stress_cpufreq_series_t;
+
+/* A window of samples where the CPUs were throttled when hot */
+typedef struct {
+	double start;			/* window start, secs since start */
+	double end;			/* window end, secs since start */
+	double max_temp;		/* hottest zone temperature, C */
+	double min_freq_percent;	/* lowest mean frequency, % of cool */
+} stress_tz_throttle_t;
+
+static stress_tz_series_t *tz_series;
+static size_t tz_series_num;
+static stress_cpufreq_series_t *cpufreq_series;
+static size_t cpufreq_series_num;
+static stress_tz_throttle_t tz_throttle[TZ_THROTTLE_WINDOWS_MAX];
+static size_t tz_throttle_num;
+static bool tz_throttling;		/* last sample was throttled */
+static double tz_sample_start;
+static double tz_sample_next;
+static bool tz_sample_enabled;
+
 /*
  *  stress_tz_init()
  *	gather all thermal zones
@@ -139,6 +187,26 @@ int stress_tz_get_temperatures(stress_tz_info_t **tz_info_list, stress_tz_t *tz)
 	return 0;
 }
 
+/*
+ *  stress_tz_key()
+ *	report key of a thermal zone, the zone type unless
+ *	several zones have the same type when the sysfs zone
+ *	number is appended to keep the keys unique
+ */
+void stress_tz_key(const stress_tz_info_t *tz_info, char *key, const size_t len)
+{
+	const stress_tz_info_t *tz;
+
+	for (tz = g_shared->tz_info; tz; tz = tz->next) {
+		if ((tz != tz_info) && !strcmp(tz->type, tz_info->type)) {
+			(void)snprintf(key, len, "%s-%s", tz_info->type,
+				tz_info->path + 12);
+			return;
+		}
+	}
+	(void)shim_strlcpy(key, tz_info->type, len);
+}
+
 /*
  *  stress_tz_dump()
  *	dump thermal zone temperatures
@@ -148,7 +216,7 @@ void stress_tz_dump(FILE *yaml, stress_stressor_t *stressors_list)
 	bool no_tz_stats = true;
 	stress_stressor_t *ss;
 
-	pr_yaml(yaml, "thermal-zones:\n");
+	stress_report_list(yaml, "thermal-zones");
 
 	for (ss = stressors_list; ss; ss = ss->next) {
 		stress_tz_info_t *tz_info;
@@ -159,8 +227,12 @@ void stress_tz_dump(FILE *yaml, stress_stressor_t *stressors_list)
 
 		for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next) {
 			for (j = 0; j < ss->started_instances; j++) {
-				const uint64_t temp =
-					ss->stats[j]->tz.tz_stat[tz_info->index].temperature;
+				const stress_tz_t *tz = ss->stats[j]->tz;
+				uint64_t temp;
+
+				if (!tz)
+					continue;
+				temp = tz->tz_stat[tz_info->index].temperature;
 				/* Avoid crazy temperatures. e.g. > 250 C */
 				if (temp <= 250000) {
 					total += temp;
@@ -171,26 +243,391 @@ void stress_tz_dump(FILE *yaml, stress_stressor_t *stressors_list)
 			if (total) {
 				const double temp = ((double)total / count) / 1000.0;
 				char *munged = stress_munge_underscore(ss->stressor->name);
+				char key[160];
 
 				if (!dumped_heading) {
 					dumped_heading = true;
 					pr_inf("%s:\n", munged);
-					pr_yaml(yaml, "    - stressor: %s\n",
+					stress_report_item(yaml, "stressor",
 						munged);
 				}
+				stress_tz_key(tz_info, key, sizeof(key));
 				pr_inf("%20s %7.2f C (%.2f K)\n",
 					tz_info->type, temp, temp + 273.15);
-				pr_yaml(yaml, "      %s: %7.2f\n",
-					tz_info->type, temp);
+				stress_report_double_prec(yaml, key, 2, temp);
 				no_tz_stats = false;
 			}
 		}
-		if (total)
-			pr_yaml(yaml, "\n");
 	}
+	stress_report_end(yaml);
 
 	if (no_tz_stats)
 		pr_inf("thermal zone temperatures not available\n");
 }
 
+/*
+ *  stress_tz_read_uint64()
+ *	read an unsigned integer from a sysfs file, false on failure
+ */
+static bool stress_tz_read_uint64(const char *path, uint64_t *val)
+{
+	char buf[64];
+
+	if (system_read(path, buf, sizeof(buf)) <= 0)
+		return false;
+	return sscanf(buf, "%" SCNu64, val) == 1;
+}
+
+/*
+ *  stress_tz_trip_point()
+ *	find the lowest passive trip point of a zone, the
+ *	point where the kernel starts to throttle the CPUs
+ */
+static uint64_t stress_tz_trip_point(const stress_tz_info_t *tz_info)
+{
+	uint64_t trip = 0;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		char path[PATH_MAX], type[32];
+		uint64_t temp;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/trip_point_%d_type",
+			tz_info->path, i);
+		if (system_read(path, type, sizeof(type)) <= 0)
+			break;
+		if (strncmp(type, "passive", 7))
+			continue;
+		(void)snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/trip_point_%d_temp",
+			tz_info->path, i);
+		if (!stress_tz_read_uint64(path, &temp) || (temp == 0))
+			continue;
+		if ((trip == 0) || (temp < trip))
+			trip = temp;
+	}
+	return trip;
+}
+
+/*
+ *  stress_tz_sample_start()
+ *	start parent sampling of the thermal zones gathered
+ *	by stress_tz_init() and of the CPU frequencies
+ */
+int stress_tz_sample_start(void)
+{
+	const stress_tz_info_t *tz_info;
+	const int32_t cpus = stress_get_processors_configured();
+	size_t i;
+
+	for (tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next)
+		tz_series_num++;
+	tz_series = calloc(tz_series_num ? tz_series_num : 1, sizeof(*tz_series));
+	cpufreq_series_num = (cpus > 0) ? (size_t)cpus : 0;
+	cpufreq_series = calloc(cpufreq_series_num ? cpufreq_series_num : 1,
+		sizeof(*cpufreq_series));
+	if (!tz_series || !cpufreq_series) {
+		pr_err("cannot allocate thermal zone sampling data\n");
+		stress_tz_sample_free();
+		return -1;
+	}
+
+	for (i = 0, tz_info = g_shared->tz_info; tz_info; tz_info = tz_info->next, i++) {
+		tz_series[i].tz_info = tz_info;
+		tz_series[i].trip = stress_tz_trip_point(tz_info);
+	}
+	for (i = 0; i < cpufreq_series_num; i++) {
+		char path[PATH_MAX];
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%zu/cpufreq/cpuinfo_max_freq", i);
+		if (!stress_tz_read_uint64(path, &cpufreq_series[i].max_freq))
+			cpufreq_series[i].max_freq = 0;
+	}
+	tz_sample_start = stress_time_now();
+	tz_sample_next = tz_sample_start;
+	tz_sample_enabled = true;
+
+	return 0;
+}
+
+/*
+ *  stress_tz_sample_active()
+ *	true if the parent is sampling the thermal zones
+ */
+bool stress_tz_sample_active(void)
+{
+	return tz_sample_enabled;
+}
+
+/*
+ *  stress_tz_sample_busy()
+ *	flag the CPUs that were mostly non-idle since the
+ *	previous sample, these are the ones running stressors
+ */
+static void stress_tz_sample_busy(void)
+{
+	FILE *fp;
+	char buf[512];
+
+	if ((fp = fopen("/proc/stat", "r")) == NULL)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		stress_cpufreq_series_t *cs;
+		uint64_t user, nice, sys, idle, iowait, irq, softirq, steal;
+		uint64_t busy_ticks, total_ticks;
+		size_t cpu;
+
+		if (sscanf(buf, "cpu%zu %" SCNu64 " %" SCNu64 " %" SCNu64
+			   " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+			   " %" SCNu64, &cpu, &user, &nice, &sys, &idle,
+			   &iowait, &irq, &softirq, &steal) != 9)
+			continue;
+		if (cpu >= cpufreq_series_num)
+			continue;
+		cs = &cpufreq_series[cpu];
+		busy_ticks = user + nice + sys + irq + softirq + steal;
+		total_ticks = busy_ticks + idle + iowait;
+		cs->busy = (total_ticks > cs->total_ticks) &&
+			(cs->total_ticks > 0) &&
+			(100.0 * (double)(busy_ticks - cs->busy_ticks) >=
+			 TZ_BUSY_PERCENT * (double)(total_ticks - cs->total_ticks));
+		cs->busy_ticks = busy_ticks;
+		cs->total_ticks = total_ticks;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_tz_sample_throttle()
+ *	track windows where a zone is at or above a trip point
+ *	and the mean frequency of the busy CPUs has dropped
+ *	below the throttling threshold
+ */
+static void stress_tz_sample_throttle(
+	const double t,
+	const bool hot,
+	const double max_temp,
+	const double freq_percent)
+{
+	stress_tz_throttle_t *window;
+
+	if (!hot || (freq_percent >= TZ_THROTTLE_PERCENT)) {
+		tz_throttling = false;
+		return;
+	}
+	if (!tz_throttling) {
+		if (tz_throttle_num >= TZ_THROTTLE_WINDOWS_MAX)
+			return;
+		window = &tz_throttle[tz_throttle_num++];
+		window->start = t;
+		window->max_temp = max_temp;
+		window->min_freq_percent = freq_percent;
+		tz_throttling = true;
+	}
+	window = &tz_throttle[tz_throttle_num - 1];
+	window->end = t;
+	if (max_temp > window->max_temp)
+		window->max_temp = max_temp;
+	if (freq_percent < window->min_freq_percent)
+		window->min_freq_percent = freq_percent;
+}
+
+/*
+ *  stress_tz_sample_tick()
+ *	sample the thermal zone temperatures and the CPU
+ *	frequencies if a sample is due. The frequency of each
+ *	busy CPU when a zone is hot is compared against its
+ *	mean busy frequency from the samples when no zone was
+ */
+void stress_tz_sample_tick(const double now)
+{
+	size_t i;
+	bool hot = false;
+	double max_temp = 0.0, freq_percent = 0.0;
+	size_t freq_count = 0;
+
+	if (!tz_sample_enabled || (now < tz_sample_next))
+		return;
+
+	stress_tz_sample_busy();
+
+	for (i = 0; i < tz_series_num; i++) {
+		stress_tz_series_t *ts = &tz_series[i];
+		char path[PATH_MAX];
+		uint64_t temp;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/temp", ts->tz_info->path);
+		/* Avoid crazy temperatures. e.g. > 250 C */
+		if (!stress_tz_read_uint64(path, &temp) || (temp > 250000))
+			continue;
+		if (!ts->count || (temp < ts->min))
+			ts->min = temp;
+		if (temp > ts->max)
+			ts->max = temp;
+		ts->sum += (double)temp;
+		ts->count++;
+		if (ts->trip && (temp >= ts->trip))
+			hot = true;
+		if ((double)temp / 1000.0 > max_temp)
+			max_temp = (double)temp / 1000.0;
+	}
+
+	for (i = 0; i < cpufreq_series_num; i++) {
+		stress_cpufreq_series_t *cs = &cpufreq_series[i];
+		char path[PATH_MAX];
+		uint64_t freq;
+
+		(void)snprintf(path, sizeof(path),
+			"/sys/devices/system/cpu/cpu%zu/cpufreq/scaling_cur_freq", i);
+		if (!stress_tz_read_uint64(path, &freq) || (freq == 0))
+			continue;
+		if (!cs->count || (freq < cs->min))
+			cs->min = freq;
+		if (freq > cs->max)
+			cs->max = freq;
+		cs->sum += (double)freq;
+		cs->count++;
+		/* Idle CPUs clock down anyway, so only busy ones count */
+		if (!cs->busy)
+			continue;
+		if (!hot) {
+			cs->cool_sum += (double)freq;
+			cs->cool_count++;
+		} else if (cs->cool_count) {
+			freq_percent += 100.0 * (double)freq /
+				(cs->cool_sum / (double)cs->cool_count);
+			freq_count++;
+		}
+	}
+
+	stress_tz_sample_throttle(now - tz_sample_start, hot, max_temp,
+		freq_count ? freq_percent / (double)freq_count : 100.0);
+
+	tz_sample_next += TZ_SAMPLE_PERIOD;
+	if (tz_sample_next < now)
+		tz_sample_next = now + TZ_SAMPLE_PERIOD;
+}
+
+/*
+ *  stress_tz_sample_dump()
+ *	report the min, mean and max temperature of each zone,
+ *	frequency of each CPU and any throttling windows
+ */
+void stress_tz_sample_dump(FILE *yaml)
+{
+	size_t i;
+	bool heading = false;
+
+	if (!tz_sample_enabled)
+		return;
+
+	for (i = 0; i < tz_series_num; i++) {
+		const stress_tz_series_t *ts = &tz_series[i];
+		char key[160];
+
+		if (!ts->count)
+			continue;
+		if (!heading) {
+			pr_inf("%-20s %9s %9s %9s %9s %8s\n", "thermal zone",
+				"min C", "mean C", "max C", "trip C", "samples");
+			stress_report_list(yaml, "thermal-zone-samples");
+			heading = true;
+		}
+		pr_inf("%-20s %9.2f %9.2f %9.2f %9.2f %8" PRIu64 "\n",
+			ts->tz_info->type, (double)ts->min / 1000.0,
+			ts->sum / (double)ts->count / 1000.0,
+			(double)ts->max / 1000.0, (double)ts->trip / 1000.0,
+			ts->count);
+		stress_tz_key(ts->tz_info, key, sizeof(key));
+		stress_report_item(yaml, "zone", key);
+		stress_report_double(yaml, "min-temperature", (double)ts->min / 1000.0);
+		stress_report_double(yaml, "mean-temperature",
+			ts->sum / (double)ts->count / 1000.0);
+		stress_report_double(yaml, "max-temperature", (double)ts->max / 1000.0);
+		if (ts->trip)
+			stress_report_double(yaml, "trip-point-temperature",
+				(double)ts->trip / 1000.0);
+		stress_report_uint64(yaml, "samples", ts->count);
+	}
+	if (heading)
+		stress_report_end(yaml);
+	else
+		pr_inf("thermal zone temperature samples not available\n");
+
+	heading = false;
+	for (i = 0; i < cpufreq_series_num; i++) {
+		const stress_cpufreq_series_t *cs = &cpufreq_series[i];
+		char cpu[32];
+
+		if (!cs->count)
+			continue;
+		if (!heading) {
+			pr_inf("%-20s %9s %9s %9s %9s %8s\n", "cpu frequency",
+				"min MHz", "mean MHz", "max MHz", "limit MHz",
+				"samples");
+			stress_report_list(yaml, "cpufreq-samples");
+			heading = true;
+		}
+		(void)snprintf(cpu, sizeof(cpu), "%zu", i);
+		pr_inf("cpu%-17zu %9.2f %9.2f %9.2f %9.2f %8" PRIu64 "\n",
+			i, (double)cs->min / 1000.0,
+			cs->sum / (double)cs->count / 1000.0,
+			(double)cs->max / 1000.0, (double)cs->max_freq / 1000.0,
+			cs->count);
+		stress_report_item(yaml, "cpu", cpu);
+		stress_report_double(yaml, "min-frequency-mhz", (double)cs->min / 1000.0);
+		stress_report_double(yaml, "mean-frequency-mhz",
+			cs->sum / (double)cs->count / 1000.0);
+		stress_report_double(yaml, "max-frequency-mhz", (double)cs->max / 1000.0);
+		if (cs->max_freq)
+			stress_report_double(yaml, "limit-frequency-mhz",
+				(double)cs->max_freq / 1000.0);
+		stress_report_uint64(yaml, "samples", cs->count);
+	}
+	if (heading)
+		stress_report_end(yaml);
+	else
+		pr_inf("cpu frequency samples not available\n");
+
+	if (!tz_throttle_num)
+		return;
+	stress_report_list(yaml, "thermal-throttling");
+	for (i = 0; i < tz_throttle_num; i++) {
+		const stress_tz_throttle_t *w = &tz_throttle[i];
+		char window[32];
+
+		pr_inf("thermal throttling from %.2fs to %.2fs, up to %.2f C, "
+			"frequency down to %.2f%% of the cool frequency\n",
+			w->start, w->end, w->max_temp, w->min_freq_percent);
+		(void)snprintf(window, sizeof(window), "%zu", i);
+		stress_report_item(yaml, "window", window);
+		stress_report_double(yaml, "start", w->start);
+		stress_report_double(yaml, "end", w->end);
+		stress_report_double(yaml, "max-temperature", w->max_temp);
+		stress_report_double(yaml, "min-frequency-percent", w->min_freq_percent);
+	}
+	stress_report_end(yaml);
+	if (tz_throttle_num >= TZ_THROTTLE_WINDOWS_MAX)
+		pr_inf("thermal throttling: only the first %d windows are reported\n",
+			TZ_THROTTLE_WINDOWS_MAX);
+}
+
+/*
+ *  stress_tz_sample_free()
+ *	free the sampled thermal zone and frequency data
+ */
+void stress_tz_sample_free(void)
+{
+	free(tz_series);
+	free(cpufreq_series);
+	tz_series = NULL;
+	cpufreq_series = NULL;
+	tz_series_num = 0;
+	cpufreq_series_num = 0;
+	tz_sample_enabled = false;
+}
+
 #endif
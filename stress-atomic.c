@@ -134,13 +134,17 @@ int main(void)
  */
 static int stress_atomic(const stress_args_t *args)
 {
+	stress_counter_batch_t batch;
+
+	stress_counter_batch_init(args, &batch);
 	do {
 		DO_ATOMIC_OPS(uint64_t, &g_shared->atomic.val64);
 		DO_ATOMIC_OPS(uint32_t, &g_shared->atomic.val32);
 		DO_ATOMIC_OPS(uint16_t, &g_shared->atomic.val16);
 		DO_ATOMIC_OPS(uint8_t, &g_shared->atomic.val8);
-		inc_counter(args);
-	} while (keep_stressing());
+		inc_counter_batch(args, &batch);
+	} while (keep_stressing_batch(args, &batch));
+	stress_counter_batch_flush(args, &batch);
 
 	return EXIT_SUCCESS;
 }
@@ -739,7 +739,9 @@ static void NOINLINE stress_funccall_ ## type(const stress_args_t *args)	\
 {									\
 	register int ii;						\
 	type a, b, c, d, e, f, g, h, i;					\
+	stress_counter_batch_t batch;					\
 									\
+	stress_counter_batch_init(args, &batch);			\
 	a = rndfunc();							\
 	b = rndfunc();							\
 	c = rndfunc();							\
@@ -788,8 +790,9 @@ static void NOINLINE stress_funccall_ ## type(const stress_args_t *args)	\
 				c, d, e, f, g, h, i));			\
 			type ## _put(res);				\
 			}						\
-		inc_counter(args);					\
-	} while (keep_stressing());					\
+		inc_counter_batch(args, &batch);			\
+	} while (keep_stressing_batch(args, &batch));			\
+	stress_counter_batch_flush(args, &batch);			\
 }
 
 stress_funccall_type(uint8_t, stress_mwc8)
@@ -35,6 +35,12 @@ static const stress_help_t help[] = {
 
 #define THRESHOLD	(100000)
 
+/* futex shared between the waker and waiter processes */
+typedef struct {
+	uint32_t futex;		/* futex word */
+	uint64_t timeout;	/* futex wait timeouts */
+} stress_futex_t;
+
 /*
  *  stress_futex()
  *	stress system by futex calls. The intention is not to
@@ -43,10 +49,21 @@ static const stress_help_t help[] = {
  */
 static int stress_futex(const stress_args_t *args)
 {
-	uint64_t *timeout = &g_shared->futex.timeout[args->instance];
-	uint32_t *futex = &g_shared->futex.futex[args->instance];
+	stress_futex_t *shared;
+	uint64_t *timeout;
+	uint32_t *futex;
 	pid_t pid;
 
+	shared = (stress_futex_t *)mmap(NULL, args->page_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_inf("%s: cannot mmap futex, errno=%d (%s), skipping stressor\n",
+			args->name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	timeout = &shared->timeout;
+	futex = &shared->futex;
+
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -123,6 +140,7 @@ again:
 			}
 		} while (keep_stressing());
 	}
+	(void)munmap((void *)shared, args->page_size);
 
 	return EXIT_SUCCESS;
 }
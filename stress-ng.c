@@ -57,11 +57,16 @@ bool g_unsupported = false;			/* true if stressors are unsupported */
 static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_abort,		OPT_FLAGS_ABORT },
 	{ OPT_aggressive,	OPT_FLAGS_AGGRESSIVE_MASK },
+	{ OPT_cgroup_per_instance, OPT_FLAGS_CGROUP_INSTANCE },
+	{ OPT_counter_overhead,	OPT_FLAGS_COUNTER_OVERHEAD | OPT_FLAGS_METRICS },
 	{ OPT_cpu_online_all,	OPT_FLAGS_CPU_ONLINE_ALL },
 	{ OPT_dry_run,		OPT_FLAGS_DRY_RUN },
+	{ OPT_energy,		OPT_FLAGS_ENERGY },
 	{ OPT_ftrace,		OPT_FLAGS_FTRACE },
 	{ OPT_ignite_cpu,	OPT_FLAGS_IGNITE_CPU },
 	{ OPT_keep_name, 	OPT_FLAGS_KEEP_NAME },
+	{ OPT_kernel_stats,	OPT_FLAGS_KERNEL_STATS },
+	{ OPT_latency,		OPT_FLAGS_LATENCY | OPT_FLAGS_METRICS },
 	{ OPT_log_brief,	OPT_FLAGS_LOG_BRIEF },
 	{ OPT_maximize,		OPT_FLAGS_MAXIMIZE },
 	{ OPT_metrics,		OPT_FLAGS_METRICS },
@@ -73,8 +78,11 @@ static const stress_opt_flag_t opt_flags[] = {
 	{ OPT_pathological,	OPT_FLAGS_PATHOLOGICAL },
 #if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
 	{ OPT_perf_stats,	OPT_FLAGS_PERF_STATS },
+	{ OPT_perf_sample,	OPT_FLAGS_PERF_SAMPLE | OPT_FLAGS_PERF_STATS },
 #endif
+	{ OPT_psi,		OPT_FLAGS_PSI },
 	{ OPT_sock_nodelay,	OPT_FLAGS_SOCKET_NODELAY },
+	{ OPT_stall_kill,	OPT_FLAGS_STALL_KILL },
 #if defined(HAVE_SYSLOG_H)
 	{ OPT_syslog,		OPT_FLAGS_SYSLOG },
 #endif
@@ -262,6 +270,13 @@ static const struct option long_options[] = {
 	{ "cache-no-affinity",0,0,	OPT_cache_no_affinity },
 	{ "cap",	1,	0, 	OPT_cap },
 	{ "cap-ops",	1,	0, 	OPT_cap_ops },
+	{ "cgroup",	1,	0,	OPT_cgroup },
+	{ "cgroup-cpu-max",1,	0,	OPT_cgroup_cpu_max },
+	{ "cgroup-cpuset",1,	0,	OPT_cgroup_cpuset },
+	{ "cgroup-io-max",1,	0,	OPT_cgroup_io_max },
+	{ "cgroup-memory-high",1,0,	OPT_cgroup_memory_high },
+	{ "cgroup-memory-max",1,0,	OPT_cgroup_memory_max },
+	{ "cgroup-per-instance",0,0,	OPT_cgroup_per_instance },
 	{ "chattr",	1,	0, 	OPT_chattr },
 	{ "chattr-ops",	1,	0,	OPT_chattr_ops },
 	{ "chdir",	1,	0, 	OPT_chdir },
@@ -281,11 +296,14 @@ static const struct option long_options[] = {
 	{ "clone-max",	1,	0,	OPT_clone_max },
 	{ "close",	1,	0,	OPT_close },
 	{ "close-ops",	1,	0,	OPT_close_ops },
+	{ "compare",	1,	0,	OPT_compare },
+	{ "compare-threshold", 1, 0,	OPT_compare_threshold },
 	{ "context",	1,	0,	OPT_context },
 	{ "context-ops",1,	0,	OPT_context_ops },
 	{ "copy-file",	1,	0,	OPT_copy_file },
 	{ "copy-file-ops", 1,	0,	OPT_copy_file_ops },
 	{ "copy-file-bytes", 1, 0,	OPT_copy_file_bytes },
+	{ "counter-overhead", 0, 0,	OPT_counter_overhead },
 	{ "cpu",	1,	0,	OPT_cpu },
 	{ "cpu-ops",	1,	0,	OPT_cpu_ops },
 	{ "cpu-load",	1,	0,	OPT_cpu_load },
@@ -296,6 +314,7 @@ static const struct option long_options[] = {
 	{ "cpu-online-all", 0,	0,	OPT_cpu_online_all },
 	{ "crypt",	1,	0,	OPT_crypt },
 	{ "crypt-ops",	1,	0,	OPT_crypt_ops },
+	{ "csv",	1,	0,	OPT_csv },
 	{ "cyclic",	1,	0,	OPT_cyclic },
 	{ "cyclic-dist",1,	0,	OPT_cyclic_dist },
 	{ "cyclic-method",1,	0,	OPT_cyclic_method },
@@ -335,6 +354,8 @@ static const struct option long_options[] = {
 	{ "dyblib-ops",	1,	0,	OPT_dynlib_ops },
 	{ "efivar",	1,	0,	OPT_efivar },
 	{ "efivar-ops",	1,	0,	OPT_efivar_ops },
+	{ "energy",	0,	0,	OPT_energy },
+	{ "energy-root",1,	0,	OPT_energy_root },
 	{ "enosys",	1,	0,	OPT_enosys },
 	{ "enosys-ops",	1,	0,	OPT_enosys_ops },
 	{ "env",	1,	0,	OPT_env },
@@ -424,6 +445,7 @@ static const struct option long_options[] = {
 	{ "inode-flags-ops",1,	0,	OPT_inode_flags_ops },
 	{ "inotify",	1,	0,	OPT_inotify },
 	{ "inotify-ops",1,	0,	OPT_inotify_ops },
+	{ "interval",	1,	0,	OPT_interval },
 	{ "io",		1,	0,	OPT_io },
 	{ "io-ops",	1,	0,	OPT_io_ops },
 	{ "iomix",	1,	0,	OPT_iomix },
@@ -446,11 +468,13 @@ static const struct option long_options[] = {
 	{ "itimer-freq",1,	0,	OPT_itimer_freq },
 	{ "itimer-rand",0,	0,	OPT_itimer_rand },
 	{ "job",	1,	0,	OPT_job },
+	{ "json",	1,	0,	OPT_json },
 	{ "judy",	1,	0,	OPT_judy },
 	{ "judy-ops",	1,	0,	OPT_judy_ops },
 	{ "judy-size",	1,	0,	OPT_judy_size },
 	{ "kcmp",	1,	0,	OPT_kcmp },
 	{ "kcmp-ops",	1,	0,	OPT_kcmp_ops },
+	{ "kernel-stats",0,	0,	OPT_kernel_stats },
 	{ "key",	1,	0,	OPT_key },
 	{ "key-ops",	1,	0,	OPT_key_ops },
 	{ "keep-name",	0,	0,	OPT_keep_name },
@@ -458,6 +482,7 @@ static const struct option long_options[] = {
 	{ "kill-ops",	1,	0,	OPT_kill_ops },
 	{ "klog",	1,	0,	OPT_klog },
 	{ "klog-ops",	1,	0,	OPT_klog_ops },
+	{ "latency",	0,	0,	OPT_latency },
 	{ "lease",	1,	0,	OPT_lease },
 	{ "lease-ops",	1,	0,	OPT_lease_ops },
 	{ "lease-breakers",1,	0,	OPT_lease_breakers },
@@ -526,6 +551,7 @@ static const struct option long_options[] = {
 	{ "mergesort-size",1,	0,	OPT_mergesort_integers },
 	{ "metrics",	0,	0,	OPT_metrics },
 	{ "metrics-brief",0,	0,	OPT_metrics_brief },
+	{ "metrics-export",1,	0,	OPT_metrics_export },
 	{ "mincore",	1,	0,	OPT_mincore },
 	{ "mincore-ops",1,	0,	OPT_mincore_ops },
 	{ "mincore-random",0,	0,	OPT_mincore_rand },
@@ -590,6 +616,8 @@ static const struct option long_options[] = {
 	{ "opcode",	1,	0,	OPT_opcode },
 	{ "opcode-ops",	1,	0,	OPT_opcode_ops },
 	{ "opcode-method",1,	0,	OPT_opcode_method },
+	{ "ops-per-sec",1,	0,	OPT_ops_per_sec },
+	{ "ops-per-sec-total",1,0,	OPT_ops_per_sec_total },
 	{ "open",	1,	0,	OPT_open },
 	{ "open-fd",	0,	0,	OPT_open_fd },
 	{ "open-ops",	1,	0,	OPT_open_ops },
@@ -598,6 +626,8 @@ static const struct option long_options[] = {
 	{ "pathological",0,	0,	OPT_pathological },
 #if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
 	{ "perf",	0,	0,	OPT_perf_stats },
+	{ "perf-events",1,	0,	OPT_perf_events },
+	{ "perf-sample",0,	0,	OPT_perf_sample },
 #endif
 	{ "personality",1,	0,	OPT_personality },
 	{ "personality-ops",1,	0,	OPT_personality_ops },
@@ -605,6 +635,7 @@ static const struct option long_options[] = {
 	{ "physpage-ops",1,	0,	OPT_physpage_ops },
 	{ "pidfd",	1,	0,	OPT_pidfd },
 	{ "pidfd-ops",	1,	0,	OPT_pidfd_ops },
+	{ "pin",	1,	0,	OPT_pin },
 	{ "pipe",	1,	0,	OPT_pipe },
 	{ "pipe-ops",	1,	0,	OPT_pipe_ops },
 	{ "pipe-data-size",1,	0,	OPT_pipe_data_size },
@@ -622,6 +653,7 @@ static const struct option long_options[] = {
 	{ "prctl-ops",	1,	0,	OPT_prctl_ops },
 	{ "procfs",	1,	0,	OPT_procfs },
 	{ "procfs-ops",	1,	0,	OPT_procfs_ops },
+	{ "psi",	0,	0,	OPT_psi },
 	{ "pthread",	1,	0,	OPT_pthread },
 	{ "pthread-ops",1,	0,	OPT_pthread_ops },
 	{ "pthread-max",1,	0,	OPT_pthread_max },
@@ -661,10 +693,15 @@ static const struct option long_options[] = {
 	{ "readahead-bytes",1,	0,	OPT_readahead_bytes },
 	{ "reboot",	1,	0,	OPT_reboot },
 	{ "reboot-ops",	1,	0,	OPT_reboot_ops },
+	{ "record",	1,	0,	OPT_record },
+	{ "record-extra",1,	0,	OPT_record_extra },
+	{ "record-period",1,	0,	OPT_record_period },
 	{ "remap",	1,	0,	OPT_remap },
 	{ "remap-ops",	1,	0,	OPT_remap_ops },
 	{ "rename",	1,	0,	OPT_rename },
 	{ "rename-ops",	1,	0,	OPT_rename_ops },
+	{ "repeat",	1,	0,	OPT_repeat },
+	{ "replay-report",1,	0,	OPT_replay_report },
 	{ "resources",	1,	0,	OPT_resources },
 	{ "resources-ops",1,	0,	OPT_resources_ops },
 	{ "revio",	1,	0,	OPT_revio },
@@ -677,6 +714,7 @@ static const struct option long_options[] = {
 	{ "rmap-ops",	1,	0,	OPT_rmap_ops },
 	{ "rtc",	1,	0,	OPT_rtc },
 	{ "rtc-ops",	1,	0,	OPT_rtc_ops },
+	{ "scale-sweep",1,	0,	OPT_scale_sweep },
 	{ "sched",	1,	0,	OPT_sched },
 	{ "sched-prio",	1,	0,	OPT_sched_prio },
 	{ "schedpolicy",1,	0,	OPT_schedpolicy },
@@ -786,6 +824,8 @@ static const struct option long_options[] = {
 	{ "stack-ops",	1,	0,	OPT_stack_ops },
 	{ "stackmmap",	1,	0,	OPT_stackmmap },
 	{ "stackmmap-ops",1,	0,	OPT_stackmmap_ops },
+	{ "stall-detect",1,	0,	OPT_stall_detect },
+	{ "stall-kill",	0,	0,	OPT_stall_kill },
 	{ "str",	1,	0,	OPT_str },
 	{ "str-ops",	1,	0,	OPT_str_ops },
 	{ "str-method",	1,	0,	OPT_str_method },
@@ -913,6 +953,7 @@ static const struct option long_options[] = {
 	{ "vm-splice-ops",1,	0,	OPT_vm_splice_ops },
 	{ "wait",	1,	0,	OPT_wait },
 	{ "wait-ops",	1,	0,	OPT_wait_ops },
+	{ "warmup",	1,	0,	OPT_warmup },
 	{ "watchdog",	1,	0,	OPT_watchdog },
 	{ "watchdog-ops",1,	0,	OPT_watchdog_ops },
 	{ "wcs",	1,	0,	OPT_wcs},
@@ -950,31 +991,61 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"aggressive",		"enable all aggressive options" },
 	{ "a N",	"all N",		"start N workers of each stress test" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
+	{ NULL,		"cgroup path",		"run each stressor in its own cgroup v2 under path" },
+	{ NULL,		"cgroup-cpu-max Q[,P]",	"limit stressor cgroup cpu to Q usecs per P usecs" },
+	{ NULL,		"cgroup-cpuset L",	"limit stressor cgroup to the CPUs in list L" },
+	{ NULL,		"cgroup-io-max M:N,K=V","set stressor cgroup io.max, e.g. 8:0,wbps=1048576" },
+	{ NULL,		"cgroup-memory-high N",	"throttle stressor cgroup memory above N bytes" },
+	{ NULL,		"cgroup-memory-max N",	"limit stressor cgroup memory to N bytes" },
+	{ NULL,		"cgroup-per-instance",	"run each stressor instance in its own cgroup" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
+	{ NULL,		"compare file",		"compare throughput against a previous YAML report" },
+	{ NULL,		"compare-threshold P",	"fail if throughput regressed by more than P percent" },
+	{ NULL,		"counter-overhead",	"report bogo ops counter overhead of each stressor" },
+	{ NULL,		"csv file",		"output results to CSV formatted file" },
 	{ "n",		"dry-run",		"do not run" },
+	{ NULL,		"energy",		"report energy use and bogo ops per joule (RAPL)" },
+	{ NULL,		"energy-root path",	"use powercap sysfs tree in path for --energy" },
 	{ "h",		"help",			"show help" },
 	{ NULL,		"ignite-cpu",		"alter kernel controls to make CPU run hot" },
+	{ NULL,		"interval N",		"report bogo-op rates every N seconds" },
 	{ NULL,		"ionice-class C",	"specify ionice class (idle, besteffort, realtime)" },
 	{ NULL,		"ionice-level L",	"specify ionice level (0 max, 7 min)" },
 	{ "j",		"job jobfile",		"run the named jobfile" },
+	{ NULL,		"json file",		"output results to JSON formatted file" },
 	{ "k",		"keep-name",		"keep stress worker names to be 'stress-ng'" },
+	{ NULL,		"kernel-stats",		"report kernel activity per bogo op of each stressor" },
+	{ NULL,		"latency",		"report bogo-op latency percentiles in the metrics" },
 	{ NULL,		"log-brief",		"less verbose log messages" },
 	{ NULL,		"log-file filename",	"log messages to a log file" },
 	{ NULL,		"maximize",		"enable maximum stress options" },
 	{ NULL,		"max-fd",		"set maximum file descriptor limit" },
 	{ "M",		"metrics",		"print pseudo metrics of activity" },
 	{ NULL,		"metrics-brief",	"enable metrics and only show non-zero results" },
+	{ NULL,		"metrics-export file",	"periodically write live metrics to a Prometheus text file" },
 	{ NULL,		"minimize",		"enable minimal stress options" },
 	{ NULL,		"no-madvise",		"don't use random madvise options for each mmap" },
 	{ NULL,		"no-rand-seed",		"seed random numbers with the same constant" },
+	{ NULL,		"ops-per-sec N",	"run each instance open-loop at N bogo ops per second" },
+	{ NULL,		"ops-per-sec-total N",	"run each stressor open-loop at N bogo ops per second" },
 	{ NULL,		"page-in",		"touch allocated pages that are not in core" },
 	{ NULL,		"parallel N",		"synonym for 'all N'" },
 	{ NULL,		"pathological",		"enable stressors that are known to hang a machine" },
 #if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
 	{ NULL,		"perf",			"display perf statistics" },
+	{ NULL,		"perf-events L",	"only gather the perf events in list L" },
+	{ NULL,		"perf-sample",		"sample and report the hottest user and kernel functions" },
 #endif
+	{ NULL,		"pin P",		"pin instances to CPUs using placement policy P" },
+	{ NULL,		"psi",			"report pressure stall information of each stressor" },
 	{ "q",		"quiet",		"quiet output" },
 	{ "r",		"random N",		"start N random workers" },
+	{ NULL,		"record file",		"record instance bogo-op counters to a binary file" },
+	{ NULL,		"record-extra L",	"also record list L of cpu, tz and cpufreq data" },
+	{ NULL,		"record-period N",	"record a sample every N milliseconds" },
+	{ NULL,		"repeat N",		"run the stressors N times and report run to run statistics" },
+	{ NULL,		"replay-report file",	"report per interval stats of a --record file" },
+	{ NULL,		"scale-sweep N|L",	"run stressors at 1, 2, 4 .. N instances or list L" },
 	{ NULL,		"sched type",		"set scheduler type" },
 	{ NULL,		"sched-prio N",		"set scheduler priority level N" },
 	{ NULL,		"sched-period N",	"set period for SCHED_DEADLINE to N nanosecs (Linux only)" },
@@ -982,6 +1053,8 @@ static const stress_help_t help_generic[] = {
 	{ NULL,		"sched-deadline N",	"set deadline for SCHED_DEADLINE to N nanosecs (Liunx only)" },
 	{ NULL,		"sched-reclaim",        "set reclaim cpu bandwidth for deadline schduler (Liunx only)" },
 	{ NULL,		"sequential N",		"run all stressors one by one, invoking N of them" },
+	{ NULL,		"stall-detect T",	"report instances whose bogo-ops have not advanced for T secs" },
+	{ NULL,		"stall-kill",		"kill instances reported by --stall-detect" },
 	{ NULL,		"stressors",		"show available stress tests" },
 #if defined(HAVE_SYSLOG_H)
 	{ NULL,		"syslog",		"log messages to the syslog" },
@@ -999,6 +1072,7 @@ static const stress_help_t help_generic[] = {
 	{ "v",		"verbose",		"verbose output" },
 	{ NULL,		"verify",		"verify results (not available on all tests)" },
 	{ "V",		"version",		"show version" },
+	{ NULL,		"warmup N",		"run N discarded warm-up runs before the --repeat runs" },
 	{ "Y",		"yaml file",		"output results to YAML formatted filed" },
 	{ "x",		"exclude",		"list of stressors to exclude (not run)" },
 	{ NULL,		NULL,			NULL }
@@ -1415,21 +1489,553 @@ static char *stress_exit_status_to_string(const int status)
 	}
 }
 
+static int stress_run_instance(stress_stressor_t *ss, const int32_t j,
+	const int32_t started_instances);
+
+/*
+ *  stress_instance_alive()
+ *	return true if a stressor process has not terminated,
+ *	terminated processes are not reaped
+ */
+static bool MLOCKED_TEXT stress_instance_alive(const pid_t pid)
+{
+#if defined(HAVE_WAITID) &&	\
+    defined(WNOWAIT)
+	siginfo_t info;
+
+	if (!pid)
+		return false;
+	(void)memset(&info, 0, sizeof(info));
+	if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) < 0)
+		return errno == EINTR;
+	return info.si_pid == 0;
+#else
+	(void)pid;
+
+	return false;
+#endif
+}
+
+/*
+ *  stress_stressors_alive()
+ *	return true if any stressor processes are still running;
+ *	terminated processes are not reaped so that the exit
+ *	status can be gathered by stress_wait_stressors()
+ */
+static bool MLOCKED_TEXT stress_stressors_alive(const stress_stressor_t *stressors_list)
+{
+	const stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		int32_t j;
+
+		for (j = 0; j < ss->started_instances; j++) {
+			if (stress_instance_alive(ss->pids[j]))
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ *  stress_stage_adjust()
+ *	start or stop instances of stressors with staged load
+ *	profiles to match the number of instances the current
+ *	stage requires, the oldest instances are stopped first
+ */
+static void MLOCKED_TEXT stress_stage_adjust(
+	stress_stressor_t *stressors_list,
+	const double now)
+{
+	stress_stressor_t *ss;
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stress_stages_t *stages = ss->stages;
+		uint64_t ops_per_sec_total = 0;
+		int32_t instances, live, j;
+
+		if (!stages)
+			continue;
+		/* settings such as ops-per-sec-total are per stressor */
+		g_stressor_current = ss;
+
+		/*
+		 *  Instances before stages->oldest have been stopped,
+		 *  count the later ones that have not terminated as
+		 *  some may have finished on their own
+		 */
+		for (live = 0, j = stages->oldest; j < ss->started_instances; j++) {
+			if (stress_instance_alive(ss->pids[j]))
+				live++;
+		}
+
+		instances = stress_stage_instances(ss, now);
+		while ((live < instances) &&
+		       (ss->started_instances < ss->num_instances)) {
+			const int ret = stress_run_instance(ss,
+				ss->started_instances, 0);
+
+			if (ret < 0) {
+				stress_kill_stressors(SIGALRM);
+				wait_flag = false;
+				return;
+			}
+			if (ret > 0)
+				return;
+			live++;
+		}
+		while ((live > instances) &&
+		       (stages->oldest < ss->started_instances)) {
+			const pid_t pid = ss->pids[stages->oldest++];
+
+			if (stress_instance_alive(pid)) {
+				(void)kill(pid, SIGALRM);
+				live--;
+			}
+		}
+
+		/* Share --ops-per-sec-total between the live instances */
+		if ((live > 0) &&
+		    stress_get_setting("ops-per-sec-total", &ops_per_sec_total)) {
+			for (j = stages->oldest; j < ss->started_instances; j++) {
+				stress_latency_t *latency = ss->stats[j]->latency;
+
+				if (latency && ss->pids[j])
+					stress_latency_set_rate(latency,
+						(double)ops_per_sec_total / (double)live);
+			}
+		}
+	}
+}
+
+/*
+ *  stress_wait_status()
+ *	handle the exit status of a reaped stressor instance
+ */
+static void MLOCKED_TEXT stress_wait_status(
+	stress_stressor_t *ss,
+	const int32_t j,
+	const pid_t ret,
+	const int status,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	bool do_abort = false;
+	const char *stressor_name = stress_munge_underscore(ss->stressor->name);
+
+	if (WIFSIGNALED(status)) {
+#if defined(WTERMSIG)
+#if NEED_GLIBC(2,1,0)
+		const char *signame = strsignal(WTERMSIG(status));
+
+		pr_dbg("process [%d] (stress-ng-%s) terminated on signal: %d (%s)\n",
+			ret, stressor_name,
+			WTERMSIG(status), signame);
+#else
+		pr_dbg("process [%d] (stress-ng-%s) terminated on signal: %d\n",
+			ret, stressor_name,
+			WTERMSIG(status));
+#endif
+#else
+		pr_dbg("process [%d] (stress-ng-%s) terminated on signal\n",
+			ret, stressor_name);
+#endif
+		/*
+		 *  If the stressor got killed by OOM or SIGKILL
+		 *  then somebody outside of our control nuked it
+		 *  so don't necessarily flag that up as a direct
+		 *  failure.
+		 */
+		if (stress_process_oomed(ret)) {
+			pr_dbg("process [%d] (stress-ng-%s) was killed by the OOM killer\n",
+				ret, stressor_name);
+		} else if (WTERMSIG(status) == SIGKILL) {
+			pr_dbg("process [%d] (stress-ng-%s) was possibly killed by the OOM killer\n",
+				ret, stressor_name);
+		} else {
+			*success = false;
+		}
+	}
+	switch (WEXITSTATUS(status)) {
+	case EXIT_SUCCESS:
+		break;
+	case EXIT_NO_RESOURCE:
+		pr_err("process [%d] (stress-ng-%s) aborted early, out of system resources\n",
+			ret, stressor_name);
+		*resource_success = false;
+		do_abort = true;
+		break;
+	case EXIT_NOT_IMPLEMENTED:
+		do_abort = true;
+		break;
+	case EXIT_BY_SYS_EXIT:
+		pr_dbg("process [%d] (stress-ng-%s) aborted via exit() which was not expected\n",
+			ret, stressor_name);
+		do_abort = true;
+		break;
+	case EXIT_METRICS_UNTRUSTWORTHY:
+		*metrics_success = false;
+		break;
+	default:
+		pr_err("process %d (stress-ng-%s) terminated with an error, exit status=%d (%s)\n",
+			ret, stressor_name, WEXITSTATUS(status),
+			stress_exit_status_to_string(WEXITSTATUS(status)));
+		*success = false;
+		do_abort = true;
+		break;
+	}
+	if ((g_opt_flags & OPT_FLAGS_ABORT) && do_abort) {
+		keep_stressing_set_flag(false);
+		wait_flag = false;
+		stress_kill_stressors(SIGALRM);
+	}
+
+	stress_stressor_finished(&ss->pids[j]);
+	pr_dbg("process [%d] terminated\n", ret);
+}
+
+#if defined(HAVE_SYS_EPOLL_H) &&	\
+    defined(HAVE_EPOLL_CREATE1)
+#define STRESS_REAPER
+#endif
+
+/* A stressor instance being waited for with a pidfd */
+typedef struct {
+	stress_stressor_t *ss;		/* stressor the instance belongs to */
+	int32_t instance;		/* stressor instance number */
+	int pidfd;			/* pidfd of the instance, -1 once reaped */
+} stress_reap_t;
+
+/*
+ *  Stressor instances are reaped in the order they terminate
+ *  by waiting on an epoll set of pidfds, one per instance
+ */
+static struct {
+	stress_reap_t *reaps;		/* registered instances */
+	int32_t *registered;		/* instances registered per stressor */
+	size_t num_reaps;		/* number of registered instances */
+	size_t max_reaps;		/* size of reaps */
+	size_t alive;			/* registered instances not yet reaped */
+	int epfd;			/* epoll fd, -1 if not reaping */
+	bool incomplete;		/* some instances could not be registered */
+} reaper = { NULL, NULL, 0, 0, 0, -1, false };
+
+/*
+ *  stress_reap_close()
+ *	close the pidfds and epoll set of the reaper
+ */
+static void stress_reap_close(void)
+{
+	size_t i;
+
+	for (i = 0; i < reaper.num_reaps; i++) {
+		if (reaper.reaps[i].pidfd >= 0)
+			(void)close(reaper.reaps[i].pidfd);
+	}
+	if (reaper.epfd >= 0)
+		(void)close(reaper.epfd);
+	free(reaper.reaps);
+	free(reaper.registered);
+	(void)memset(&reaper, 0, sizeof(reaper));
+	reaper.epfd = -1;
+}
+
+/*
+ *  stress_reap_register()
+ *	add a pidfd to the epoll set for each stressor instance
+ *	started since the last call, staged stressors start
+ *	instances after the initial ones were registered
+ */
+static void stress_reap_register(stress_stressor_t *stressors_list)
+{
+#if defined(STRESS_REAPER)
+	stress_stressor_t *ss;
+	size_t n;
+
+	if (reaper.epfd < 0)
+		return;
+
+	for (n = 0, ss = stressors_list; ss; n++, ss = ss->next) {
+		int32_t j;
+
+		for (j = reaper.registered[n]; j < ss->started_instances; j++) {
+			const pid_t pid = ss->pids[j];
+			struct epoll_event ev;
+			int pidfd;
+
+			reaper.registered[n] = j + 1;
+			if (!pid)
+				continue;
+			if (reaper.num_reaps >= reaper.max_reaps) {
+				reaper.incomplete = true;
+				continue;
+			}
+			pidfd = shim_pidfd_open(pid, 0);
+			if (pidfd < 0) {
+				if ((errno == ENOSYS) && (reaper.num_reaps == 0)) {
+					pr_dbg("pidfd_open not supported, "
+						"reaping stressors with waitpid\n");
+					stress_reap_close();
+					return;
+				}
+				reaper.incomplete = true;
+				continue;
+			}
+			(void)memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.u64 = (uint64_t)reaper.num_reaps;
+			if (epoll_ctl(reaper.epfd, EPOLL_CTL_ADD, pidfd, &ev) < 0) {
+				(void)close(pidfd);
+				reaper.incomplete = true;
+				continue;
+			}
+			reaper.reaps[reaper.num_reaps].ss = ss;
+			reaper.reaps[reaper.num_reaps].instance = j;
+			reaper.reaps[reaper.num_reaps].pidfd = pidfd;
+			reaper.num_reaps++;
+			reaper.alive++;
+		}
+	}
+#else
+	(void)stressors_list;
+#endif
+}
+
+/*
+ *  stress_reap_open()
+ *	create the epoll set of stressor instance pidfds, on
+ *	failure the stressors are reaped with waitpid in order
+ */
+static void stress_reap_open(stress_stressor_t *stressors_list)
+{
+#if defined(STRESS_REAPER)
+	stress_stressor_t *ss;
+	size_t stressors = 0, instances = 0;
+#if defined(RLIMIT_NOFILE)
+	struct rlimit rlim;
+#endif
+
+	for (ss = stressors_list; ss; ss = ss->next) {
+		stressors++;
+		instances += (size_t)ss->num_instances;
+	}
+	if (!instances)
+		return;
+
+#if defined(RLIMIT_NOFILE)
+	/* Need a fd per instance, so try to raise the soft limit */
+	if ((getrlimit(RLIMIT_NOFILE, &rlim) == 0) &&
+	    (rlim.rlim_cur < (rlim_t)instances + 64) &&
+	    (rlim.rlim_cur < rlim.rlim_max)) {
+		rlim.rlim_cur = ((rlim_t)instances + 64 < rlim.rlim_max) ?
+			(rlim_t)instances + 64 : rlim.rlim_max;
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+#endif
+
+	reaper.reaps = calloc(instances, sizeof(*reaper.reaps));
+	reaper.registered = calloc(stressors, sizeof(*reaper.registered));
+	if (!reaper.reaps || !reaper.registered) {
+		stress_reap_close();
+		return;
+	}
+	reaper.max_reaps = instances;
+	reaper.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (reaper.epfd < 0) {
+		pr_dbg("epoll_create1 failed, errno=%d (%s), "
+			"reaping stressors with waitpid\n",
+			errno, strerror(errno));
+		stress_reap_close();
+		return;
+	}
+	stress_reap_register(stressors_list);
+	if (reaper.incomplete)
+		pr_dbg("could not open a pidfd for all %zu stressor instances, "
+			"reaping the remainder with waitpid\n", instances);
+#else
+	(void)stressors_list;
+#endif
+}
+
+/*
+ *  stress_reap_active()
+ *	return true if stressors are being reaped with pidfds
+ */
+static inline bool stress_reap_active(void)
+{
+	return reaper.epfd >= 0;
+}
+
+/*
+ *  stress_reap_alive()
+ *	return true if any stressor processes are still running
+ */
+static bool MLOCKED_TEXT stress_reap_alive(stress_stressor_t *stressors_list)
+{
+	if (!stress_reap_active())
+		return stress_stressors_alive(stressors_list);
+
+	stress_reap_register(stressors_list);
+	if (reaper.incomplete)
+		return stress_stressors_alive(stressors_list);
+	return reaper.alive > 0;
+}
+
+/*
+ *  stress_reap_wait()
+ *	wait up to timeout_ms milliseconds (-1 for ever) for
+ *	stressor instances to terminate and reap them in the
+ *	order they terminated, returns early on a signal
+ */
+static void MLOCKED_TEXT stress_reap_wait(
+	const int timeout_ms,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+#if defined(STRESS_REAPER)
+	struct epoll_event events[64];
+	int i, n;
+
+	if (!stress_reap_active())
+		return;
+
+	n = epoll_wait(reaper.epfd, events, (int)SIZEOF_ARRAY(events), timeout_ms);
+	for (i = 0; i < n; i++) {
+		stress_reap_t *reap = &reaper.reaps[events[i].data.u64];
+		stress_stressor_t *ss = reap->ss;
+		const int32_t j = reap->instance;
+		const pid_t pid = ss->pids[j];
+
+		if (reap->pidfd < 0)
+			continue;
+		if (pid) {
+			int status;
+			const pid_t ret = waitpid(pid, &status, WNOHANG);
+
+			if (ret == 0)
+				continue;
+			if (ret > 0) {
+				stress_wait_status(ss, j, ret, status,
+					success, resource_success, metrics_success);
+			} else if (errno == EINTR) {
+				continue;
+			} else if (errno == ECHILD) {
+				stress_stressor_finished(&ss->pids[j]);
+			}
+		}
+		(void)close(reap->pidfd);
+		reap->pidfd = -1;
+		reaper.alive--;
+	}
+#else
+	(void)timeout_ms;
+	(void)success;
+	(void)resource_success;
+	(void)metrics_success;
+#endif
+}
+
+/*
+ *  stress_wait_periodic()
+ *	while stressors are running wake up periodically
+ *	to sample their progress, to run staged load
+ *	profiles and to export live metrics
+ */
+static void MLOCKED_TEXT stress_wait_periodic(
+	stress_stressor_t *stressors_list,
+	const bool interval,
+	const bool metrics_export,
+	const bool record,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+#if defined(HAVE_WAITID) &&	\
+    defined(WNOWAIT)
+	while (wait_flag &&
+	       (stress_reap_alive(stressors_list) ||
+		stress_stage_pending(stressors_list))) {
+		const double now = stress_time_now();
+		double delay = 0.1;
+
+		stress_stage_adjust(stressors_list, now);
+		if (interval) {
+			stress_interval_tick(stressors_list, now);
+			delay = stress_interval_next() - stress_time_now();
+		}
+		if (metrics_export)
+			stress_export_tick(stressors_head, now);
+#if defined(STRESS_THERMAL_ZONES)
+		stress_tz_sample_tick(now);
+#endif
+		stress_energy_tick(now);
+		stress_psi_tick(now);
+		stress_stall_tick(now);
+		if (record) {
+			double record_delay;
+
+			stress_record_tick(now);
+			record_delay = stress_record_next() - stress_time_now();
+			if (record_delay < delay)
+				delay = record_delay;
+		}
+
+		/*
+		 *  Sleep until the next sample is due, but check
+		 *  for terminated stressors at least every 0.1 secs,
+		 *  when reaping with pidfds wake up and reap them
+		 *  as soon as they terminate
+		 */
+		if (delay > 0.1)
+			delay = 0.1;
+		if (stress_reap_active()) {
+			const int timeout_ms = (delay > 0.0) ?
+				(int)(delay * 1000.0) + 1 : 0;
+
+			stress_reap_wait(timeout_ms, success,
+				resource_success, metrics_success);
+		} else if (delay > 0.0) {
+			(void)shim_usleep_interruptible((uint64_t)(delay * 1000000.0));
+		}
+	}
+#else
+	(void)stressors_list;
+	(void)interval;
+	(void)metrics_export;
+	(void)record;
+	(void)success;
+	(void)resource_success;
+	(void)metrics_success;
+
+	pr_inf("periodic sampling of stressors is not supported\n");
+#endif
+}
+
 /*
  *  stress_wait_stressors()
  * 	wait for stressor child processes
  */
 static void MLOCKED_TEXT stress_wait_stressors(
 	stress_stressor_t *stressors_list,
+	const double time_start,
 	bool *success,
 	bool *resource_success,
 	bool *metrics_success)
 {
 	stress_stressor_t *ss;
+	uint64_t interval = 0;
+	bool staged = false, metrics_export, periodic = false;
 
 	if (g_opt_flags & OPT_FLAGS_IGNITE_CPU)
 		stress_ignite_cpu_start();
 
+	(void)stress_get_setting("interval", &interval);
+	if (interval &&
+	    (stress_interval_start(stressors_list, time_start, (double)interval) < 0))
+		interval = 0;
+
 #if defined(HAVE_SCHED_GETAFFINITY) && NEED_GLIBC(2,3,0)
 	/*
 	 *  On systems that support changing CPU affinity
@@ -1459,6 +2065,8 @@ static void MLOCKED_TEXT stress_wait_stressors(
 				goto do_wait;
 
 			(void)shim_usleep(usec_sleep);
+			if (interval)
+				stress_interval_tick(stressors_list, stress_time_now());
 
 			for (ss = stressors_list; ss; ss = ss->next) {
 				int32_t j;
@@ -1494,6 +2102,37 @@ static void MLOCKED_TEXT stress_wait_stressors(
 	}
 do_wait:
 #endif
+	for (ss = stressors_list; ss; ss = ss->next) {
+		if (ss->stages)
+			staged = true;
+	}
+	metrics_export = stress_export_start(stressors_head,
+		stressors_list, time_start);
+	periodic = stress_energy_active() || stress_psi_active() ||
+		stress_stall_active();
+#if defined(STRESS_THERMAL_ZONES)
+	periodic |= stress_tz_sample_active();
+#endif
+	stress_reap_open(stressors_list);
+	if (interval || staged || metrics_export ||
+	    stress_record_active() || periodic) {
+		stress_wait_periodic(stressors_list, interval != 0,
+			metrics_export, stress_record_active(),
+			success, resource_success, metrics_success);
+		for (ss = stressors_list; ss; ss = ss->next)
+			stress_stage_finish(ss, stress_time_now());
+	}
+
+	/*
+	 *  Reap the instances in the order they terminate,
+	 *  any that could not be waited for with a pidfd
+	 *  are reaped in instance order below
+	 */
+	stress_reap_register(stressors_list);
+	while (stress_reap_active() && (reaper.alive > 0))
+		stress_reap_wait(-1, success, resource_success, metrics_success);
+	stress_reap_close();
+
 	for (ss = stressors_list; ss; ss = ss->next) {
 		int32_t j;
 
@@ -1503,80 +2142,11 @@ redo:
 			pid = ss->pids[j];
 			if (pid) {
 				int status, ret;
-				bool do_abort = false;
-				const char *stressor_name = stress_munge_underscore(ss->stressor->name);
 
 				ret = shim_waitpid(pid, &status, 0);
 				if (ret > 0) {
-					if (WIFSIGNALED(status)) {
-#if defined(WTERMSIG)
-#if NEED_GLIBC(2,1,0)
-						const char *signame = strsignal(WTERMSIG(status));
-
-						pr_dbg("process [%d] (stress-ng-%s) terminated on signal: %d (%s)\n",
-							ret, stressor_name,
-							WTERMSIG(status), signame);
-#else
-						pr_dbg("process [%d] (stress-ng-%s) terminated on signal: %d\n",
-							ret, stressor_name,
-							WTERMSIG(status));
-#endif
-#else
-						pr_dbg("process [%d] (stress-ng-%s) terminated on signal\n",
-							ret, stressor_name);
-#endif
-						/*
-						 *  If the stressor got killed by OOM or SIGKILL
-						 *  then somebody outside of our control nuked it
-						 *  so don't necessarily flag that up as a direct
-						 *  failure.
-						 */
-						if (stress_process_oomed(ret)) {
-							pr_dbg("process [%d] (stress-ng-%s) was killed by the OOM killer\n",
-								ret, stressor_name);
-						} else if (WTERMSIG(status) == SIGKILL) {
-							pr_dbg("process [%d] (stress-ng-%s) was possibly killed by the OOM killer\n",
-								ret, stressor_name);
-						} else {
-							*success = false;
-						}
-					}
-					switch (WEXITSTATUS(status)) {
-					case EXIT_SUCCESS:
-						break;
-					case EXIT_NO_RESOURCE:
-						pr_err("process [%d] (stress-ng-%s) aborted early, out of system resources\n",
-							ret, stressor_name);
-						*resource_success = false;
-						do_abort = true;
-						break;
-					case EXIT_NOT_IMPLEMENTED:
-						do_abort = true;
-						break;
-					case EXIT_BY_SYS_EXIT:
-						pr_dbg("process [%d] (stress-ng-%s) aborted via exit() which was not expected\n",
-							ret, stressor_name);
-						do_abort = true;
-						break;
-					case EXIT_METRICS_UNTRUSTWORTHY:
-						*metrics_success = false;
-						break;
-					default:
-						pr_err("process %d (stress-ng-%s) terminated with an error, exit status=%d (%s)\n",
-							ret, stressor_name, WEXITSTATUS(status),
-							stress_exit_status_to_string(WEXITSTATUS(status)));
-						*success = false;
-						do_abort = true;
-						break;
-					}
-					if ((g_opt_flags & OPT_FLAGS_ABORT) && do_abort) {
-						keep_stressing_set_flag(false);
-						wait_flag = false;
-						stress_kill_stressors(SIGALRM);
-					}
-
-					stress_stressor_finished(&ss->pids[j]);
-					pr_dbg("process [%d] terminated\n", ret);
+					stress_wait_status(ss, j, ret, status,
+						success, resource_success, metrics_success);
 				} else if (ret == -1) {
 					/* Somebody interrupted the wait */
 					if (errno == EINTR)
@@ -1660,6 +2230,7 @@ static void stress_free_stressors(void)
 
 		free(ss->pids);
 		free(ss->stats);
+		stress_stage_free(ss->stages);
 		free(ss);
 
 		ss = next;
@@ -1693,6 +2264,264 @@ static void stress_child_atexit(void)
 	_exit(EXIT_BY_SYS_EXIT);
 }
 
+/*
+ *  stress_start_barrier_reset()
+ *	close the start barrier before a run of stressors
+ */
+static void stress_start_barrier_reset(void)
+{
+	g_shared->start_barrier.waiting = 0;
+	g_shared->start_barrier.time = 0.0;
+	g_shared->start_barrier.released = 0;
+	shim_mb();
+}
+
+/*
+ *  stress_start_barrier_release()
+ *	open the start barrier once all the instances have been
+ *	forked so that they all start their work at the same time
+ */
+static void stress_start_barrier_release(void)
+{
+	if (g_shared->start_barrier.released)
+		return;
+	pr_dbg("releasing %" PRIu32 " instances from the start barrier\n",
+		g_shared->start_barrier.waiting);
+	g_shared->start_barrier.time = stress_time_now();
+	shim_mb();
+	g_shared->start_barrier.released = 1;
+	shim_mb();
+	(void)shim_futex_wake(&g_shared->start_barrier.released, INT_MAX);
+}
+
+/*
+ *  stress_start_barrier_wait()
+ *	wait until the start barrier is released, waiting instances
+ *	sleep so they do not slow down the forking of the remaining
+ *	instances, returns the time the barrier was released
+ */
+static double stress_start_barrier_wait(void)
+{
+	const struct timespec timeout = { 0, 100000000 };
+
+	__sync_fetch_and_add(&g_shared->start_barrier.waiting, 1);
+	shim_mb();
+	while (!g_shared->start_barrier.released && keep_stressing_flag()) {
+		if ((shim_futex_wait(&g_shared->start_barrier.released, 0, &timeout) < 0) &&
+		    (errno == ENOSYS))
+			(void)shim_usleep(1000);
+		shim_mb();
+	}
+	return g_shared->start_barrier.released ?
+		g_shared->start_barrier.time : stress_time_now();
+}
+
+/*
+ *  stress_run_instance()
+ *	fork and run instance j of stressor ss, returns 0 if
+ *	the instance was started, 1 if it was not started because
+ *	stress-ng is stopping and -1 if the stressors should be
+ *	stopped because of a fork failure or an early abort
+ */
+static int MLOCKED_TEXT stress_run_instance(
+	stress_stressor_t *ss,
+	const int32_t j,
+	const int32_t started_instances)
+{
+	int rc = EXIT_SUCCESS;
+	pid_t pid;
+	char name[64];
+	int64_t backoff = DEFAULT_BACKOFF;
+	int32_t ionice_class = UNDEFINED;
+	int32_t ionice_level = UNDEFINED;
+	uint64_t ops_per_sec = 0;
+	uint64_t ops_per_sec_total = 0;
+	stress_stats_t *stats = ss->stats[j];
+	stress_checksum_t *checksum = stats->checksum;
+	double time_released;
+
+	g_stressor_current = ss;
+	(void)stress_get_setting("backoff", &backoff);
+	(void)stress_get_setting("ionice-class", &ionice_class);
+	(void)stress_get_setting("ionice-level", &ionice_level);
+	(void)stress_get_setting("ops-per-sec", &ops_per_sec);
+	(void)stress_get_setting("ops-per-sec-total", &ops_per_sec_total);
+
+	stats->counter_ready = true;
+	stats->counter = 0;
+	stats->counter_flushes = 0;
+	stats->counter_updates = 0;
+	stats->run_ok = false;
+	if (stats->latency) {
+		stress_latency_init(stats->latency);
+		/*
+		 *  Staged stressors have more instance slots than
+		 *  run at once, stress_stage_adjust() shares the
+		 *  total rate between the live instances
+		 */
+		if (ops_per_sec_total)
+			stress_latency_set_rate(stats->latency,
+				(double)ops_per_sec_total /
+				(double)ss->num_instances);
+		else
+			stress_latency_set_rate(stats->latency,
+				(double)ops_per_sec);
+	}
+again:
+	if (!keep_stressing_flag())
+		return 1;
+	pid = fork();
+	switch (pid) {
+	case -1:
+		if (errno == EAGAIN) {
+			(void)shim_usleep(100000);
+			goto again;
+		}
+		pr_err("Cannot fork: errno=%d (%s)\n",
+			errno, strerror(errno));
+		return -1;
+	case 0:
+		/* Child */
+		/* Drop the reaper fds inherited by staged instances */
+		stress_reap_close();
+		(void)snprintf(name, sizeof(name), "%s-%s", g_app_name,
+			stress_munge_underscore(ss->stressor->name));
+
+		(void)sched_settings_apply(true);
+		(void)atexit(stress_child_atexit);
+		(void)setpgid(0, g_pgrp);
+		if (stress_set_handler(name, true) < 0) {
+			rc = EXIT_FAILURE;
+			goto child_exit;
+		}
+		stress_parent_died_alarm();
+		stress_process_dumpable(false);
+		stress_set_timer_slack();
+
+		if (stress_cgroup_join(ss, j) < 0) {
+			rc = EXIT_NO_RESOURCE;
+			goto child_exit;
+		}
+		stress_pin_instance(name, (uint32_t)j);
+		stress_mwc_reseed();
+		stress_set_oom_adjustment(name, false);
+		stress_set_max_limits();
+		stress_set_iopriority(ionice_class, ionice_level);
+		stress_set_proc_name(name);
+		(void)umask(0077);
+
+		pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
+			name, (int)getpid(), j);
+
+#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
+		if (stats->sp)
+			(void)stress_perf_open(stats->sp);
+#endif
+		time_released = stress_start_barrier_wait();
+		if (g_opt_timeout) {
+			/*
+			 *  The run time starts when the barrier is released,
+			 *  instances may be started late in staged runs
+			 */
+			const double remaining = (double)g_opt_timeout -
+				(stress_time_now() - time_released);
+
+			(void)alarm(remaining > 1.0 ? (unsigned int)ceil(remaining) : 1);
+		}
+		/* Don't account the backoff delay as run time */
+		(void)shim_usleep(backoff * started_instances);
+		stats->start = stats->finish = stress_time_now();
+#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
+		if (stats->sp)
+			(void)stress_perf_enable(stats->sp);
+#endif
+		if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
+			const stress_args_t args = {
+				.counter = &stats->counter,
+				.counter_ready = &stats->counter_ready,
+				.counter_flushes = &stats->counter_flushes,
+				.counter_updates = &stats->counter_updates,
+				.latency = stats->latency,
+				.name = name,
+				.max_ops = ss->bogo_ops,
+				.instance = j,
+				.num_instances = ss->num_instances,
+				.pid = getpid(),
+				.ppid = getppid(),
+				.page_size = stress_get_pagesize(),
+				.mapped = &g_shared->mapped
+			};
+
+			(void)memset(checksum, 0, sizeof(*checksum));
+			rc = ss->stressor->info->stressor(&args);
+			pr_fail_check(&rc);
+			if (rc == EXIT_SUCCESS) {
+				stats->run_ok = true;
+				checksum->data.run_ok = true;
+			}
+			/*
+			 *  Bogo ops counter should be OK for reading,
+			 *  if not then flag up that the counter may
+			 *  be untrustyworthy
+			 */
+			if (!stats->counter_ready) {
+				pr_inf("%s: NOTE: bogo-ops counter in non-ready state, metrics are untrustworthy (process may have been terminated prematurely)\n",
+					name);
+				rc = EXIT_METRICS_UNTRUSTWORTHY;
+			}
+			checksum->data.counter = *args.counter;
+			stress_hash_checksum(checksum);
+		}
+#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
+		if (stats->sp) {
+			(void)stress_perf_disable(stats->sp);
+			(void)stress_perf_close(stats->sp);
+		}
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+		if (stats->tz)
+			(void)stress_tz_get_temperatures(&g_shared->tz_info, stats->tz);
+#endif
+		stats->finish = stress_time_now();
+		if (times(&stats->tms) == (clock_t)-1) {
+			pr_dbg("times failed: errno=%d (%s)\n",
+				errno, strerror(errno));
+		}
+		pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
+			name, (int)getpid(), j);
+
+child_exit:
+		stress_free_stressors();
+		stress_cache_free();
+		stress_free_settings();
+		(void)stress_ftrace_free();
+
+		if ((rc != 0) && (g_opt_flags & OPT_FLAGS_ABORT)) {
+			keep_stressing_set_flag(false);
+			wait_flag = false;
+			(void)kill(getppid(), SIGALRM);
+		}
+		if (terminate_signum)
+			rc = EXIT_SIGNALED;
+		_exit(rc);
+	default:
+		if (pid > -1) {
+			(void)setpgid(pid, g_pgrp);
+			ss->pids[j] = pid;
+			ss->started_instances++;
+			stress_ftrace_add_pid(pid);
+		}
+
+		/* Forced early abort during startup? */
+		if (!keep_stressing_flag()) {
+			pr_dbg("abort signal during startup, cleaning up\n");
+			return -1;
+		}
+		break;
+	}
+	return 0;
+}
+
 /*
  *  stress_run ()
  *	kick off and run stressors
@@ -1708,173 +2537,52 @@ static void MLOCKED_TEXT stress_run(
 	double time_start, time_finish;
 	int32_t started_instances = 0;
 
+	if (stress_cgroup_create(stressors_list) < 0) {
+		*resource_success = false;
+		return;
+	}
+
 	wait_flag = true;
+	stress_start_barrier_reset();
 	time_start = stress_time_now();
+	stress_energy_start();
+	stress_kstat_start();
+	stress_psi_start();
+	stress_stall_start(stressors_list);
 	pr_dbg("starting stressors\n");
 
 	/*
 	 *  Work through the list of stressors to run
 	 */
 	for (g_stressor_current = stressors_list; g_stressor_current; g_stressor_current = g_stressor_current->next) {
-		int32_t j;
+		stress_stressor_t *ss = g_stressor_current;
+		int32_t j, instances;
+
+		for (j = 0; j < ss->num_instances; j++, (*checksum)++)
+			ss->stats[j]->checksum = *checksum;
 
 		/*
-		 *  Each stressor has 1 or more instances to run
+		 *  Each stressor has 1 or more instances to run,
+		 *  staged stressors start with the instances of
+		 *  their first stage
 		 */
-		for (j = 0; j < g_stressor_current->num_instances; j++, (*checksum)++) {
-			int rc = EXIT_SUCCESS;
-			pid_t pid;
-			char name[64];
-			int64_t backoff = DEFAULT_BACKOFF;
-			int32_t ionice_class = UNDEFINED;
-			int32_t ionice_level = UNDEFINED;
-			stress_stats_t *stats = g_stressor_current->stats[j];
+		stress_stage_start(ss, time_start);
+		instances = stress_stage_instances(ss, time_start);
+
+		for (j = 0; j < instances; j++) {
+			int ret;
 
 			if (g_opt_timeout && (stress_time_now() - time_start > g_opt_timeout))
 				goto abort;
 
-			(void)stress_get_setting("backoff", &backoff);
-			(void)stress_get_setting("ionice-class", &ionice_class);
-			(void)stress_get_setting("ionice-level", &ionice_level);
-
-			stats->counter_ready = true;
-			stats->counter = 0;
-			stats->checksum = *checksum;
-again:
-			if (!keep_stressing_flag())
-				break;
-			pid = fork();
-			switch (pid) {
-			case -1:
-				if (errno == EAGAIN) {
-					(void)shim_usleep(100000);
-					goto again;
-				}
-				pr_err("Cannot fork: errno=%d (%s)\n",
-					errno, strerror(errno));
+			ret = stress_run_instance(ss, j, started_instances);
+			if (ret < 0) {
 				stress_kill_stressors(SIGALRM);
 				goto wait_for_stressors;
-			case 0:
-				/* Child */
-				(void)snprintf(name, sizeof(name), "%s-%s", g_app_name,
-					stress_munge_underscore(g_stressor_current->stressor->name));
-
-				(void)sched_settings_apply(true);
-				(void)atexit(stress_child_atexit);
-				(void)setpgid(0, g_pgrp);
-				if (stress_set_handler(name, true) < 0) {
-					rc = EXIT_FAILURE;
-					goto child_exit;
-				}
-				stress_parent_died_alarm();
-				stress_process_dumpable(false);
-				stress_set_timer_slack();
-
-				if (g_opt_timeout)
-					(void)alarm(g_opt_timeout);
-				stress_mwc_reseed();
-				stress_set_oom_adjustment(name, false);
-				stress_set_max_limits();
-				stress_set_iopriority(ionice_class, ionice_level);
-				stress_set_proc_name(name);
-				(void)umask(0077);
-
-				pr_dbg("%s: started [%d] (instance %" PRIu32 ")\n",
-					name, (int)getpid(), j);
-
-				stats->start = stats->finish = stress_time_now();
-#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_open(&stats->sp);
-#endif
-				(void)shim_usleep(backoff * started_instances);
-#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS)
-					(void)stress_perf_enable(&stats->sp);
-#endif
-				if (keep_stressing_flag() && !(g_opt_flags & OPT_FLAGS_DRY_RUN)) {
-					const stress_args_t args = {
-						.counter = &stats->counter,
-						.counter_ready = &stats->counter_ready,
-						.name = name,
-						.max_ops = g_stressor_current->bogo_ops,
-						.instance = j,
-						.num_instances = g_stressor_current->num_instances,
-						.pid = getpid(),
-						.ppid = getppid(),
-						.page_size = stress_get_pagesize(),
-						.mapped = &g_shared->mapped
-					};
-
-					(void)memset(*checksum, 0, sizeof(**checksum));
-					rc = g_stressor_current->stressor->info->stressor(&args);
-					pr_fail_check(&rc);
-					if (rc == EXIT_SUCCESS) {
-						stats->run_ok = true;
-						(*checksum)->data.run_ok = true;
-					}
-					/*
-					 *  Bogo ops counter should be OK for reading,
-					 *  if not then flag up that the counter may
-					 *  be untrustyworthy
-					 */
-					if (!stats->counter_ready) {
-						pr_inf("%s: NOTE: bogo-ops counter in non-ready state, metrics are untrustworthy (process may have been terminated prematurely)\n",
-							name);
-						rc = EXIT_METRICS_UNTRUSTWORTHY;
-					}
-					(*checksum)->data.counter = *args.counter;
-					stress_hash_checksum(*checksum);
-				}
-#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
-				if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
-					(void)stress_perf_disable(&stats->sp);
-					(void)stress_perf_close(&stats->sp);
-				}
-#endif
-#if defined(STRESS_THERMAL_ZONES)
-				if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
-					(void)stress_tz_get_temperatures(&g_shared->tz_info, &stats->tz);
-#endif
-				stats->finish = stress_time_now();
-				if (times(&stats->tms) == (clock_t)-1) {
-					pr_dbg("times failed: errno=%d (%s)\n",
-						errno, strerror(errno));
-				}
-				pr_dbg("%s: exited [%d] (instance %" PRIu32 ")\n",
-					name, (int)getpid(), j);
-
-child_exit:
-				stress_free_stressors();
-				stress_cache_free();
-				stress_free_settings();
-				(void)stress_ftrace_free();
-
-				if ((rc != 0) && (g_opt_flags & OPT_FLAGS_ABORT)) {
-					keep_stressing_set_flag(false);
-					wait_flag = false;
-					(void)kill(getppid(), SIGALRM);
-				}
-				if (terminate_signum)
-					rc = EXIT_SIGNALED;
-				_exit(rc);
-			default:
-				if (pid > -1) {
-					(void)setpgid(pid, g_pgrp);
-					g_stressor_current->pids[j] = pid;
-					g_stressor_current->started_instances++;
-					started_instances++;
-					stress_ftrace_add_pid(pid);
-				}
-
-				/* Forced early abort during startup? */
-				if (!keep_stressing_flag()) {
-					pr_dbg("abort signal during startup, cleaning up\n");
-					stress_kill_stressors(SIGALRM);
-					goto wait_for_stressors;
-				}
-				break;
 			}
+			if (ret > 0)
+				break;
+			started_instances++;
 		}
 	}
 	(void)stress_set_handler("stress-ng", false);
@@ -1886,8 +2594,16 @@ abort:
 		 started_instances == 1 ? "" : "s");
 
 wait_for_stressors:
-	stress_wait_stressors(stressors_list, success, resource_success, metrics_success);
+	stress_start_barrier_release();
+	stress_wait_stressors(stressors_list, time_start, success,
+		resource_success, metrics_success);
 	time_finish = stress_time_now();
+	stress_energy_stop(stressors_list);
+	stress_kstat_stop(stressors_list);
+	stress_psi_stop(stressors_list);
+	stress_stall_stop();
+	stress_export_stop(stressors_list);
+	stress_cgroup_collect(stressors_list);
 
 	*duration += time_finish - time_start;
 }
@@ -1993,6 +2709,97 @@ static void metrics_check(bool *success)
 	}
 }
 
+/*
+ *  metrics_latency_merge()
+ *	merge the latency histograms of all the instances
+ *	of a stressor
+ */
+static void metrics_latency_merge(
+	const stress_stressor_t *ss,
+	stress_latency_t *latency)
+{
+	int32_t j;
+
+	stress_latency_init(latency);
+	for (j = 0; j < ss->started_instances; j++) {
+		const stress_stats_t *const stats = ss->stats[j];
+
+		if (stats->latency)
+			stress_latency_merge(latency, stats->latency);
+	}
+}
+
+/*
+ *  metrics_latency_yaml()
+ *	output latency percentiles of a stressor to the YAML file
+ */
+static void metrics_latency_yaml(FILE *yaml, const stress_stressor_t *ss)
+{
+	stress_latency_t latency;
+	int32_t j;
+	double target = 0.0;
+
+	metrics_latency_merge(ss, &latency);
+	if (!latency.count)
+		return;
+
+	/* Instances of staged stressors before stages->oldest were stopped */
+	for (j = ss->stages ? ss->stages->oldest : 0; j < ss->started_instances; j++) {
+		const stress_latency_t *const instance = ss->stats[j]->latency;
+
+		if (instance && instance->interval_ns)
+			target += 1000000000.0 / (double)instance->interval_ns;
+	}
+	if (target > 0.0)
+		stress_report_double(yaml, "target-bogo-ops-per-second", target);
+	stress_report_uint64(yaml, "latency-samples", latency.count);
+	stress_report_double(yaml, "latency-mean-ns",
+		(double)latency.sum_ns / (double)latency.count);
+	stress_report_uint64(yaml, "latency-p50-ns",
+		stress_latency_percentile(&latency, 50.0));
+	stress_report_uint64(yaml, "latency-p90-ns",
+		stress_latency_percentile(&latency, 90.0));
+	stress_report_uint64(yaml, "latency-p99-ns",
+		stress_latency_percentile(&latency, 99.0));
+	stress_report_uint64(yaml, "latency-p99.9-ns",
+		stress_latency_percentile(&latency, 99.9));
+	stress_report_uint64(yaml, "latency-max-ns", latency.max_ns);
+}
+
+/*
+ *  metrics_latency_dump()
+ *	output bogo-op latency percentiles
+ */
+static void metrics_latency_dump(void)
+{
+	stress_stressor_t *ss;
+	bool heading = false;
+
+	for (ss = stressors_head; ss; ss = ss->next) {
+		stress_latency_t latency;
+
+		metrics_latency_merge(ss, &latency);
+		if (!latency.count)
+			continue;
+
+		if (!heading) {
+			pr_inf("%-13s %12s %12s %12s %12s %12s\n",
+				"stressor", "p50 (ns)", "p90 (ns)", "p99 (ns)",
+				"p99.9 (ns)", "max (ns)");
+			heading = true;
+		}
+
+		pr_inf("%-13s %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+			" %12" PRIu64 " %12" PRIu64 "\n",
+			stress_munge_underscore(ss->stressor->name),
+			stress_latency_percentile(&latency, 50.0),
+			stress_latency_percentile(&latency, 90.0),
+			stress_latency_percentile(&latency, 99.0),
+			stress_latency_percentile(&latency, 99.9),
+			latency.max_ns);
+	}
+}
+
 /*
  *  metrics_dump()
  *	output metrics
@@ -2009,7 +2816,7 @@ static void metrics_dump(
 	pr_inf("%-13s %9.9s %9.9s %9.9s %9.9s %12s %12s\n",
 		"", "", "(secs) ", "(secs) ", "(secs) ", "(real time)",
 		"(usr+sys time)");
-	pr_yaml(yaml, "metrics:\n");
+	stress_report_list(yaml, "metrics");
 
 	for (ss = stressors_head; ss; ss = ss->next) {
 		uint64_t c_total = 0, u_total = 0, s_total = 0, us_total;
@@ -2017,10 +2824,12 @@ static void metrics_dump(
 		int32_t  j;
 		const char *munged = stress_munge_underscore(ss->stressor->name);
 		double u_time, s_time, bogo_rate_r_time, bogo_rate;
+		double overlap_start = 0.0, overlap_finish = 0.0, overlap_rate = 0.0;
 		bool run_ok = false;
 
 		for (j = 0; j < ss->started_instances; j++) {
 			const stress_stats_t *const stats = ss->stats[j];
+			const double duration = stats->finish - stats->start;
 
 			run_ok  |= stats->run_ok;
 			c_total += stats->counter;
@@ -2028,7 +2837,15 @@ static void metrics_dump(
 				   stats->tms.tms_cutime;
 			s_total += stats->tms.tms_stime +
 				   stats->tms.tms_cstime;
-			r_total += stats->finish - stats->start;
+			r_total += duration;
+
+			/* Window in which all the instances were running */
+			if ((j == 0) || (stats->start > overlap_start))
+				overlap_start = stats->start;
+			if ((j == 0) || (stats->finish < overlap_finish))
+				overlap_finish = stats->finish;
+			if (duration > 0.0)
+				overlap_rate += (double)stats->counter / duration;
 		}
 		/* Total usr + sys time of all procs */
 		us_total = u_total + s_total;
@@ -2054,15 +2871,35 @@ static void metrics_dump(
 			bogo_rate_r_time, /* bogo ops on wall clock time */
 			bogo_rate);	/* bogo ops per second */
 
-		pr_yaml(yaml, "    - stressor: %s\n", munged);
-		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", c_total);
-		pr_yaml(yaml, "      bogo-ops-per-second-usr-sys-time: %f\n", bogo_rate);
-		pr_yaml(yaml, "      bogo-ops-per-second-real-time: %f\n", bogo_rate_r_time);
-		pr_yaml(yaml, "      wall-clock-time: %f\n", r_total);
-		pr_yaml(yaml, "      user-time: %f\n", u_time);
-		pr_yaml(yaml, "      system-time: %f\n", s_time);
-		pr_yaml(yaml, "\n");
+		stress_report_item(yaml, "stressor", munged);
+		stress_report_uint64(yaml, "bogo-ops", c_total);
+		stress_report_double(yaml, "bogo-ops-per-second-usr-sys-time", bogo_rate);
+		stress_report_double(yaml, "bogo-ops-per-second-real-time", bogo_rate_r_time);
+		stress_report_double(yaml, "wall-clock-time", r_total);
+		stress_report_double(yaml, "user-time", u_time);
+		stress_report_double(yaml, "system-time", s_time);
+		/*
+		 *  Instances are only sampled at their start and finish,
+		 *  so the throughput over the common window is the sum
+		 *  of the mean rates of the instances
+		 */
+		if (overlap_finish > overlap_start) {
+			pr_dbg("%s: all %" PRId32 " instances ran together for %.2f secs, "
+				"%.2f bogo ops/s over this window\n", munged,
+				ss->started_instances, overlap_finish - overlap_start,
+				overlap_rate);
+			stress_report_double(yaml, "overlap-time",
+				overlap_finish - overlap_start);
+			stress_report_double(yaml, "bogo-ops-per-second-overlap",
+				overlap_rate);
+		}
+		if (g_opt_flags & OPT_FLAGS_LATENCY)
+			metrics_latency_yaml(yaml, ss);
 	}
+	stress_report_end(yaml);
+
+	if (g_opt_flags & OPT_FLAGS_LATENCY)
+		metrics_latency_dump();
 }
 
 /*
@@ -2106,20 +2943,21 @@ static void times_dump(
 			min1, min5, min15);
 	}
 
-	pr_yaml(yaml, "times:\n");
-	pr_yaml(yaml, "      run-time: %f\n", duration);
-	pr_yaml(yaml, "      available-cpu-time: %f\n", total_cpu_time);
-	pr_yaml(yaml, "      user-time: %f\n", u_time);
-	pr_yaml(yaml, "      system-time: %f\n", s_time);
-	pr_yaml(yaml, "      total-time: %f\n", t_time);
-	pr_yaml(yaml, "      user-time-percent: %f\n", u_pc);
-	pr_yaml(yaml, "      system-time-percent: %f\n", s_pc);
-	pr_yaml(yaml, "      total-time-percent: %f\n", t_pc);
+	stress_report_map(yaml, "times");
+	stress_report_double(yaml, "run-time", duration);
+	stress_report_double(yaml, "available-cpu-time", total_cpu_time);
+	stress_report_double(yaml, "user-time", u_time);
+	stress_report_double(yaml, "system-time", s_time);
+	stress_report_double(yaml, "total-time", t_time);
+	stress_report_double(yaml, "user-time-percent", u_pc);
+	stress_report_double(yaml, "system-time-percent", s_pc);
+	stress_report_double(yaml, "total-time-percent", t_pc);
 	if (!rc) {
-		pr_yaml(yaml, "      load-average-1-minute: %f\n", min1);
-		pr_yaml(yaml, "      load-average-5-minute: %f\n", min5);
-		pr_yaml(yaml, "      load-average-15-minute: %f\n", min15);
+		stress_report_double(yaml, "load-average-1-minute", min1);
+		stress_report_double(yaml, "load-average-5-minute", min5);
+		stress_report_double(yaml, "load-average-15-minute", min15);
 	}
+	stress_report_end(yaml);
 }
 
 /*
@@ -2215,6 +3053,35 @@ static void *stress_map_page(int prot, char *prot_str, size_t page_size)
 	return ptr;
 }
 
+/*
+ *  stress_map_instances()
+ *	mmap a shared zero filled array of size bytes for
+ *	each of the num_procs stressor instances
+ */
+static void *stress_map_instances(
+	const size_t size,
+	const size_t num_procs,
+	const char *name,
+	size_t *length)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t len = size * (num_procs ? num_procs : 1);
+	const size_t sz = (len + page_size - 1) & ~(page_size - 1);
+	void *ptr;
+
+	ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANON, -1, 0);
+	if (ptr == MAP_FAILED) {
+		pr_err("cannot mmap %s, errno=%d (%s)\n",
+			name, errno, strerror(errno));
+		*length = 0;
+		return NULL;
+	}
+	*length = sz;
+
+	return ptr;
+}
+
 /*
  *  stress_map_shared()
  *	mmap shared region, with an extra page at the end
@@ -2239,8 +3106,11 @@ static inline void stress_map_shared(const size_t num_procs)
 		exit(EXIT_FAILURE);
 	}
 
-	/* Paraniod */
-	(void)memset(g_shared, 0, sz);
+	/*
+	 *  Anonymous mappings are zero filled, so don't memset
+	 *  the segment, this avoids faulting in all the pages
+	 *  of the per instance stats up front
+	 */
 	g_shared->length = sz;
 
 #if defined(HAVE_MPROTECT)
@@ -2272,17 +3142,11 @@ static inline void stress_map_shared(const size_t num_procs)
 	 *  memory segment so that we can sanity check these for
 	 *  any form of corruption
 	 */
-	len = sizeof(stress_checksum_t) * STRESS_PROCS_MAX;
-	sz = (len + page_size) & ~(page_size - 1);
-	g_shared->checksums = (stress_checksum_t *)mmap(NULL, sz,
-		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
-	if (g_shared->checksums == MAP_FAILED) {
-		pr_err("cannot mmap checksums, errno=%d (%s)\n",
-			errno, strerror(errno));
+	g_shared->checksums = (stress_checksum_t *)stress_map_instances(
+		sizeof(stress_checksum_t), num_procs, "checksums",
+		&g_shared->checksums_length);
+	if (!g_shared->checksums)
 		goto err_unmap_shared;
-	}
-	(void)memset(g_shared->checksums, 0, sz);
-	g_shared->checksums_length = sz;
 
 	/*
 	 *  mmap some pages for testing invalid arguments in
@@ -2322,6 +3186,15 @@ void stress_unmap_shared(void)
 {
 	const size_t page_size = stress_get_pagesize();
 
+	stress_latency_unmap();
+#if defined(STRESS_PERF_STATS)
+	if (g_shared->perfs)
+		(void)munmap((void *)g_shared->perfs, g_shared->perfs_length);
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (g_shared->tzs)
+		(void)munmap((void *)g_shared->tzs, g_shared->tzs_length);
+#endif
 	(void)munmap((void *)g_shared->mapped.page_wo, page_size);
 	(void)munmap((void *)g_shared->mapped.page_ro, page_size);
 	(void)munmap((void *)g_shared->mapped.page_none, page_size);
@@ -2517,12 +3390,27 @@ static inline void setup_stats_buffers(void)
 {
 	stress_stressor_t *ss;
 	stress_stats_t *stats = g_shared->stats;
+	stress_latency_t *latency = g_shared->latencies;
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t *sp = g_shared->perfs;
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_t *tz = g_shared->tzs;
+#endif
 
 	for (ss = stressors_head; ss; ss = ss->next) {
 		int32_t j;
 
-		for (j = 0; j < ss->num_instances; j++, stats++)
+		for (j = 0; j < ss->num_instances; j++, stats++) {
 			ss->stats[j] = stats;
+			stats->latency = latency ? latency++ : NULL;
+#if defined(STRESS_PERF_STATS)
+			stats->sp = sp ? sp++ : NULL;
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+			stats->tz = tz ? tz++ : NULL;
+#endif
+		}
 	}
 }
 
@@ -2728,12 +3616,49 @@ next_opt:
 				enable_classes(u32);
 			}
 			break;
+		case OPT_cgroup:
+			stress_set_setting_global("cgroup", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_cgroup_cpu_max:
+			if (stress_set_cgroup_cpu_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_cpuset:
+			stress_set_setting("cgroup-cpuset", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_cgroup_io_max:
+			if (stress_set_cgroup_io_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_cgroup_memory_high:
+			u64 = stress_get_uint64_byte(optarg);
+			stress_set_setting("cgroup-memory-high", TYPE_ID_UINT64, &u64);
+			break;
+		case OPT_cgroup_memory_max:
+			u64 = stress_get_uint64_byte(optarg);
+			stress_set_setting("cgroup-memory-max", TYPE_ID_UINT64, &u64);
+			break;
+		case OPT_compare:
+			stress_set_setting_global("compare", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_compare_threshold:
+			if (stress_set_compare_threshold(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_csv:
+			stress_set_setting_global("csv", TYPE_ID_STR, (void *)optarg);
+			break;
 		case OPT_exclude:
 			stress_set_setting_global("exclude", TYPE_ID_STR, (void *)optarg);
 			break;
 		case OPT_help:
 			stress_usage();
 			break;
+		case OPT_interval:
+			u64 = stress_get_uint64_time(optarg);
+			stress_check_range("interval", u64, 1, 3600 * 24);
+			stress_set_setting_global("interval", TYPE_ID_UINT64, &u64);
+			break;
 		case OPT_ionice_class:
 			i32 = stress_get_opt_ionice_class(optarg);
 			stress_set_setting("ionice-class", TYPE_ID_INT32, &i32);
@@ -2745,6 +3670,9 @@ next_opt:
 		case OPT_job:
 			stress_set_setting_global("job", TYPE_ID_STR, (void *)optarg);
 			break;
+		case OPT_json:
+			stress_set_setting_global("json", TYPE_ID_STR, (void *)optarg);
+			break;
 		case OPT_log_file:
 			stress_set_setting_global("log-file", TYPE_ID_STR, (void *)optarg);
 			break;
@@ -2755,9 +3683,37 @@ next_opt:
 			stress_check_range(optarg, u64, 8, max_fds);
 			stress_set_setting_global("max-fd", TYPE_ID_UINT64, &u64);
 			break;
+		case OPT_energy_root:
+			stress_set_setting_global("energy-root", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_metrics_export:
+			stress_set_setting_global("metrics-export", TYPE_ID_STR, (void *)optarg);
+			break;
 		case OPT_no_madvise:
 			g_opt_flags &= ~OPT_FLAGS_MMAP_MADVISE;
 			break;
+		case OPT_ops_per_sec:
+			u64 = stress_get_uint64(optarg);
+			stress_check_range("ops-per-sec", u64, 1, 1000000000);
+			stress_set_setting("ops-per-sec", TYPE_ID_UINT64, &u64);
+			g_opt_flags |= (OPT_FLAGS_LATENCY | OPT_FLAGS_METRICS);
+			break;
+		case OPT_ops_per_sec_total:
+			u64 = stress_get_uint64(optarg);
+			stress_check_range("ops-per-sec-total", u64, 1, 1000000000);
+			stress_set_setting("ops-per-sec-total", TYPE_ID_UINT64, &u64);
+			g_opt_flags |= (OPT_FLAGS_LATENCY | OPT_FLAGS_METRICS);
+			break;
+#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
+		case OPT_perf_events:
+			if (stress_perf_set_events(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
+		case OPT_pin:
+			if (stress_set_pin(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_query:
 			if (!jobmode) {
 				(void)printf("Try '%s --help' for more information.\n", g_app_name);
@@ -2774,6 +3730,30 @@ next_opt:
 			stress_check_value("random", i32);
 			stress_set_setting("random", TYPE_ID_INT32, &i32);
 			break;
+		case OPT_record:
+			stress_set_setting_global("record", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_record_extra:
+			if (stress_set_record_extra(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_record_period:
+			u32 = stress_get_uint32(optarg);
+			stress_check_range("record-period", (uint64_t)u32, 1, 3600000);
+			stress_set_setting_global("record-period", TYPE_ID_UINT32, &u32);
+			break;
+		case OPT_repeat:
+			u32 = stress_get_uint32(optarg);
+			stress_check_range("repeat", (uint64_t)u32, 1, 1000000);
+			stress_set_setting_global("repeat", TYPE_ID_UINT32, &u32);
+			break;
+		case OPT_replay_report:
+			stress_set_setting_global("replay-report", TYPE_ID_STR, (void *)optarg);
+			break;
+		case OPT_scale_sweep:
+			if (stress_scale_sweep_set(optarg) < 0)
+				return EXIT_FAILURE;
+			break;
 		case OPT_sched:
 			i32 = stress_get_opt_sched(optarg);
 			stress_set_setting_global("sched", TYPE_ID_INT32, &i32);
@@ -2804,6 +3784,10 @@ next_opt:
 			stress_check_range("sequential", g_opt_sequential,
 				MIN_SEQUENTIAL, MAX_SEQUENTIAL);
 			break;
+		case OPT_stall_detect:
+			if (stress_set_stall_detect(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_stressors:
 			stress_show_stressor_names();
 			exit(EXIT_SUCCESS);
@@ -2824,6 +3808,11 @@ next_opt:
 		case OPT_version:
 			stress_version();
 			exit(EXIT_SUCCESS);
+		case OPT_warmup:
+			u32 = stress_get_uint32(optarg);
+			stress_check_range("warmup", (uint64_t)u32, 0, 1000000);
+			stress_set_setting_global("warmup", TYPE_ID_UINT32, &u32);
+			break;
 		case OPT_yaml:
 			stress_set_setting_global("yaml", TYPE_ID_STR, (void *)optarg);
 			break;
@@ -2886,6 +3875,8 @@ static void stress_setup_sequential(const uint32_t class)
 	for (ss = stressors_head; ss; ss = ss->next) {
 		if (ss->stressor->info->class & class)
 			ss->num_instances = g_opt_sequential;
+		if (ss->stages)
+			ss->num_instances = ss->stages->slots;
 		alloc_proc_resources(&ss->pids, &ss->stats, ss->num_instances);
 	}
 }
@@ -2903,6 +3894,8 @@ static void stress_setup_parallel(const uint32_t class)
 	for (ss = stressors_head; ss; ss = ss->next) {
 		if (ss->stressor->info->class & class)
 			ss->num_instances = g_opt_parallel;
+		if (ss->stages)
+			ss->num_instances = ss->stages->slots;
 		/*
 		 * Share bogo ops between processes equally, rounding up
 		 * if nonzero bogo_ops
@@ -2960,6 +3953,94 @@ static inline void stress_run_parallel(
 			metrics_success, &checksum);
 }
 
+/*
+ *  stress_run_scale_sweep()
+ *	run each stressor on its own repeatedly with the number
+ *	of instances of each scale sweep point, so the curve of
+ *	one stressor is not skewed by the load of the others
+ */
+static void stress_run_scale_sweep(
+	double *duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	const int32_t *points;
+	const size_t num_points = stress_scale_sweep_points(&points);
+	stress_stressor_t *ss;
+	stress_checksum_t *checksums = g_shared->checksums;
+	int32_t max = 0;
+	size_t i;
+
+	for (i = 0; i < num_points; i++)
+		max = STRESS_MAXIMUM(max, points[i]);
+
+	/* Each stressor has checksum slots for the largest sweep point */
+	for (ss = stressors_head; ss && keep_stressing_flag();
+	     checksums += max, ss = ss->next) {
+		stress_stressor_t *next = ss->next;
+
+		ss->next = NULL;
+		for (i = 0; (i < num_points) && keep_stressing_flag(); i++) {
+			stress_checksum_t *checksum = checksums;
+
+			(void)memset(ss->pids, 0, sizeof(*ss->pids) * (size_t)ss->num_instances);
+			ss->started_instances = 0;
+			ss->num_instances = points[i];
+			pr_inf("scale sweep: running %" PRId32 " instance%s of %s\n",
+				points[i], points[i] == 1 ? "" : "s",
+				stress_munge_underscore(ss->stressor->name));
+			stress_run(ss, duration, success, resource_success,
+				metrics_success, &checksum);
+			stress_scale_sweep_record(ss, points[i]);
+		}
+		ss->next = next;
+	}
+}
+
+/*
+ *  stress_run_repeat()
+ *	run the stressors repeatedly, the first --warmup runs
+ *	are discarded and the throughput of the remaining runs
+ *	is used for the run to run statistics
+ */
+static void stress_run_repeat(
+	const uint32_t repeat,
+	double *duration,
+	bool *success,
+	bool *resource_success,
+	bool *metrics_success)
+{
+	uint32_t i, warmup = 0;
+
+	(void)stress_get_setting("warmup", &warmup);
+
+	for (i = 0; (i < warmup + repeat) && keep_stressing_flag(); i++) {
+		const bool is_warmup = (i < warmup);
+		stress_stressor_t *ss;
+
+		for (ss = stressors_head; ss; ss = ss->next) {
+			(void)memset(ss->pids, 0, sizeof(*ss->pids) * (size_t)ss->num_instances);
+			ss->started_instances = 0;
+		}
+		if (is_warmup)
+			pr_inf("repeat: warm-up run %" PRIu32 " of %" PRIu32 "\n",
+				i + 1, warmup);
+		else
+			pr_inf("repeat: run %" PRIu32 " of %" PRIu32 "\n",
+				i + 1 - warmup, repeat);
+
+		if (g_opt_flags & OPT_FLAGS_SEQUENTIAL)
+			stress_run_sequential(duration, success,
+				resource_success, metrics_success);
+		else
+			stress_run_parallel(duration, success,
+				resource_success, metrics_success);
+		stress_repeat_record(stressors_head,
+			is_warmup ? i : i - warmup, is_warmup);
+	}
+}
+
 /*
  *  stress_mlock_executable()
  *	try to mlock image into memory so it
@@ -2991,6 +4072,13 @@ int main(int argc, char **argv, char **envp)
 	int32_t ticks_per_sec;			/* clock ticks per second (jiffies) */
 	int32_t ionice_class = UNDEFINED;	/* ionice class */
 	int32_t ionice_level = UNDEFINED;	/* ionice level */
+	const int32_t *scale_points;		/* scale sweep instances */
+	size_t scale_points_num;		/* number of scale sweep points */
+	uint32_t repeat = 0;			/* number of repeated runs */
+	uint32_t warmup = 0;			/* number of discarded warm-up runs */
+	char *compare_filename = NULL;		/* --compare baseline YAML file */
+	char *replay_filename = NULL;		/* --replay-report recording file */
+	bool compare_success = true;
 	size_t i;
 	uint32_t class = 0;
 	const uint32_t cpus_online = stress_get_processors_online();
@@ -3039,6 +4127,11 @@ int main(int argc, char **argv, char **envp)
 	(void)stress_get_setting("job", &job_filename);
 	if (stress_parse_jobfile(argc, argv, job_filename) < 0)
 		exit(EXIT_FAILURE);
+	/*
+	 *  Index the settings once so that the stressors
+	 *  inherit fast setting lookups
+	 */
+	stress_index_settings();
 
 	/*
 	 *  Sanity check minimize/maximize options
@@ -3060,6 +4153,30 @@ int main(int argc, char **argv, char **envp)
 	}
 	(void)stress_get_setting("class", &class);
 
+	if (stress_scale_sweep_points(&scale_points) &&
+	    (g_opt_flags & (OPT_FLAGS_SEQUENTIAL | OPT_FLAGS_ALL | OPT_FLAGS_RANDOM))) {
+		(void)fprintf(stderr, "cannot invoke --scale-sweep with the "
+			"--sequential, --all or --random options\n");
+		exit(EXIT_FAILURE);
+	}
+	(void)stress_get_setting("repeat", &repeat);
+	if (repeat && stress_scale_sweep_points(&scale_points)) {
+		(void)fprintf(stderr, "cannot invoke --repeat with the "
+			"--scale-sweep option\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!repeat && stress_get_setting("warmup", &warmup) && warmup)
+		pr_inf("warmup has no effect without --repeat\n");
+	if (stress_get_setting("compare", &compare_filename) &&
+	    (stress_compare_load(compare_filename) < 0))
+		exit(EXIT_FAILURE);
+
+	/*
+	 *  Report on a recording and don't run any stressors
+	 */
+	if (stress_get_setting("replay-report", &replay_filename))
+		exit(stress_record_replay(replay_filename));
+
 	if (class &&
 	    !(g_opt_flags & (OPT_FLAGS_SEQUENTIAL | OPT_FLAGS_ALL))) {
 		(void)fprintf(stderr, "class option is only used with "
@@ -3151,6 +4268,20 @@ int main(int argc, char **argv, char **envp)
 		(void)ret;	/* We don't care if it fails */
 	}
 
+	/*
+	 *  Scale sweeps need instance slots for the largest sweep point
+	 */
+	scale_points_num = stress_scale_sweep_points(&scale_points);
+	if (scale_points_num) {
+		stress_stressor_t *ss;
+		int32_t max = 0;
+
+		for (i = 0; i < scale_points_num; i++)
+			max = STRESS_MAXIMUM(max, scale_points[i]);
+		for (ss = stressors_head; ss; ss = ss->next)
+			ss->num_instances = max;
+	}
+
 	/*
 	 *  Setup stressor proc info
 	 */
@@ -3203,6 +4334,47 @@ int main(int argc, char **argv, char **envp)
 	shim_pthread_spin_init(&g_shared->warn_once.lock, 0);
 #endif
 
+	/*
+	 *  Optional per instance bogo-op latency histograms
+	 */
+	if ((g_opt_flags & OPT_FLAGS_LATENCY) &&
+	    (stress_latency_map(stress_get_total_num_instances(stressors_head)) < 0)) {
+		stress_unmap_shared();
+		stress_free_stressors();
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 *  Optional per instance perf counters and thermal
+	 *  zone temperatures, only mapped when enabled
+	 */
+#if defined(STRESS_PERF_STATS)
+	if (g_opt_flags & OPT_FLAGS_PERF_STATS) {
+		g_shared->perfs = (stress_perf_t *)stress_map_instances(
+			sizeof(stress_perf_t),
+			stress_get_total_num_instances(stressors_head),
+			"perf counters", &g_shared->perfs_length);
+		if (!g_shared->perfs) {
+			stress_unmap_shared();
+			stress_free_stressors();
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES) {
+		g_shared->tzs = (stress_tz_t *)stress_map_instances(
+			sizeof(stress_tz_t),
+			stress_get_total_num_instances(stressors_head),
+			"thermal zones", &g_shared->tzs_length);
+		if (!g_shared->tzs) {
+			stress_unmap_shared();
+			stress_free_stressors();
+			exit(EXIT_FAILURE);
+		}
+	}
+#endif
+
 	/*
 	 *  Assign procs with shared stats memory
 	 */
@@ -3225,17 +4397,55 @@ int main(int argc, char **argv, char **envp)
 	/*
 	 *  Setup thermal zone data
 	 */
-	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES)
+	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES) {
 		stress_tz_init(&g_shared->tz_info);
+		(void)stress_tz_sample_start();
+	}
 #endif
 
+	/* Find the RAPL energy counters for --energy */
+	(void)stress_energy_init();
+
+	/* Find the pressure stall information files for --psi */
+	(void)stress_psi_init();
+	stress_stall_init();
+
+	/* Work out CPU placement slots for --pin */
+	(void)stress_pin_init();
+
+	/* Check the --cgroup parent and enable its controllers */
+	if (stress_cgroup_init() < 0) {
+		stress_cache_free();
+		stress_unmap_shared();
+		stress_free_stressors();
+		exit(EXIT_FAILURE);
+	}
+
+	/* Create the --record sample recording file */
+	if (stress_record_init(stressors_head) < 0) {
+		stress_cache_free();
+		stress_unmap_shared();
+		stress_free_stressors();
+		exit(EXIT_FAILURE);
+	}
+
 	stressors_init();
 
+	/* Measure counter costs before the system gets busy */
+	if (g_opt_flags & OPT_FLAGS_COUNTER_OVERHEAD)
+		stress_counter_overhead_calibrate();
+
 	/* Start thrasher process if required */
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_start();
 
-	if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
+	if (scale_points_num) {
+		stress_run_scale_sweep(&duration,
+			&success, &resource_success, &metrics_success);
+	} else if (repeat) {
+		stress_run_repeat(repeat, &duration,
+			&success, &resource_success, &metrics_success);
+	} else if (g_opt_flags & OPT_FLAGS_SEQUENTIAL) {
 		stress_run_sequential(&duration,
 			&success, &resource_success, &metrics_success);
 	} else {
@@ -3247,6 +4457,8 @@ int main(int argc, char **argv, char **envp)
 	if (g_opt_flags & OPT_FLAGS_THRASH)
 		stress_thrash_stop();
 
+	stress_record_close();
+
 	pr_inf("%s run completed in %.2fs%s\n",
 		success ? "successful" : "unsuccessful",
 		duration, stress_duration_to_str(duration));
@@ -3260,8 +4472,9 @@ int main(int argc, char **argv, char **envp)
 			pr_err("Cannot output YAML data to %s\n", yaml_filename);
 
 		pr_yaml(yaml, "---\n");
-		pr_yaml_runinfo(yaml);
 	}
+	stress_report_open();
+	pr_yaml_runinfo(yaml);
 
 	/*
 	 *  Dump metrics
@@ -3271,12 +4484,80 @@ int main(int argc, char **argv, char **envp)
 
 	metrics_check(&success);
 
+	/*
+	 *  Dump bogo ops counter overhead
+	 */
+	if (g_opt_flags & OPT_FLAGS_COUNTER_OVERHEAD)
+		stress_counter_overhead_dump(yaml, stressors_head);
+
+	/*
+	 *  Dump interval bogo-op rates
+	 */
+	stress_interval_dump(yaml, stressors_head);
+	stress_interval_free();
+
+	/*
+	 *  Dump staged load profile metrics
+	 */
+	stress_stage_dump(yaml, stressors_head);
+
+	/*
+	 *  Dump scale sweep scalability report
+	 */
+	stress_scale_sweep_dump(yaml, stressors_head);
+	stress_scale_sweep_free();
+
+	/*
+	 *  Dump repeated run statistics
+	 */
+	stress_repeat_dump(yaml, stressors_head);
+
+	/*
+	 *  Compare throughput against the baseline
+	 */
+	compare_success = stress_compare_dump(yaml, stressors_head);
+	stress_compare_free();
+	stress_repeat_free();
+
+	/*
+	 *  Dump energy use
+	 */
+	stress_energy_dump(yaml, stressors_head);
+	stress_energy_free();
+
+	/*
+	 *  Dump kernel activity
+	 */
+	stress_kstat_dump(yaml, stressors_head);
+	stress_kstat_free();
+
+	/*
+	 *  Dump pressure stall information
+	 */
+	stress_psi_dump(yaml, stressors_head);
+	stress_psi_free();
+
+	/*
+	 *  Dump cgroup statistics
+	 */
+	stress_cgroup_dump(yaml, stressors_head);
+	stress_cgroup_free();
+	stress_stall_dump(yaml);
+	stress_stall_free();
+
+	/*
+	 *  Final update of the exported metrics
+	 */
+	stress_export_finish(stressors_head);
+
 #if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
 	/*
 	 *  Dump perf statistics
 	 */
 	if (g_opt_flags & OPT_FLAGS_PERF_STATS)
 		stress_perf_stat_dump(yaml, stressors_head, duration);
+	if (g_opt_flags & OPT_FLAGS_PERF_SAMPLE)
+		stress_perf_sample_dump(yaml, stressors_head);
 #endif
 
 #if defined(STRESS_THERMAL_ZONES)
@@ -3285,6 +4566,8 @@ int main(int argc, char **argv, char **envp)
 	 */
 	if (g_opt_flags & OPT_FLAGS_THERMAL_ZONES) {
 		stress_tz_dump(yaml, stressors_head);
+		stress_tz_sample_dump(yaml);
+		stress_tz_sample_free();
 		stress_tz_free(&g_shared->tz_info);
 	}
 #endif
@@ -3303,6 +4586,10 @@ int main(int argc, char **argv, char **envp)
 	stressors_deinit();
 	stress_free_stressors();
 	stress_cache_free();
+	stress_pin_free();
+#if defined(STRESS_PERF_STATS) && defined(HAVE_LINUX_PERF_EVENT_H)
+	stress_perf_sample_free();
+#endif
 	stress_unmap_shared();
 	stress_free_settings();
 
@@ -3311,6 +4598,7 @@ int main(int argc, char **argv, char **envp)
 	 */
 	shim_closelog();
 	pr_closelog();
+	stress_report_close(yaml);
 	if (yaml) {
 		pr_yaml(yaml, "...\n");
 		(void)fclose(yaml);
@@ -3325,5 +4613,7 @@ int main(int argc, char **argv, char **envp)
 		exit(EXIT_NO_RESOURCE);
 	if (!metrics_success)
 		exit(EXIT_METRICS_UNTRUSTWORTHY);
+	if (!compare_success)
+		exit(EXIT_REGRESSION);
 	exit(EXIT_SUCCESS);
 }
@@ -123,6 +123,10 @@
 #include <crypt.h>
 #endif
 
+#if defined(HAVE_ELF_H)
+#include <elf.h>
+#endif
+
 #if defined(HAVE_FEATURES_H)
 #include <features.h>
 #endif
@@ -802,6 +806,7 @@ typedef unsigned long int __kernel_ulong_t;
 #define EXIT_SIGNALED			(5)
 #define EXIT_BY_SYS_EXIT		(6)
 #define EXIT_METRICS_UNTRUSTWORTHY	(7)
+#define EXIT_REGRESSION			(8)
 
 /*
  * STRESS_ASSERT(test)
@@ -891,6 +896,14 @@ typedef unsigned long int __kernel_ulong_t;
 #define OPT_FLAGS_TIMESTAMP	 (0x00000800000000ULL)	/* --timestamp */
 #define OPT_FLAGS_DEADLINE_GRUB  (0x00001000000000ULL)  /* --sched-reclaim */
 #define OPT_FLAGS_FTRACE	 (0x00002000000000ULL)  /* --ftrace */
+#define OPT_FLAGS_LATENCY	 (0x00004000000000ULL)	/* --latency */
+#define OPT_FLAGS_COUNTER_OVERHEAD (0x00008000000000ULL) /* --counter-overhead */
+#define OPT_FLAGS_PERF_SAMPLE	 (0x00010000000000ULL)	/* --perf-sample */
+#define OPT_FLAGS_ENERGY	 (0x00020000000000ULL)	/* --energy */
+#define OPT_FLAGS_KERNEL_STATS	 (0x00040000000000ULL)	/* --kernel-stats */
+#define OPT_FLAGS_PSI		 (0x00080000000000ULL)	/* --psi */
+#define OPT_FLAGS_CGROUP_INSTANCE (0x00100000000000ULL) /* --cgroup-per-instance */
+#define OPT_FLAGS_STALL_KILL	 (0x00200000000000ULL)	/* --stall-kill */
 
 #define OPT_FLAGS_MINMAX_MASK		\
 	(OPT_FLAGS_MINIMIZE | OPT_FLAGS_MAXIMIZE)
@@ -968,6 +981,31 @@ typedef struct {
 	uint32_t	hash;		/* Hash of data */
 } stress_checksum_t;
 
+/*
+ *  Per stressor instance bogo-op latency histogram. Buckets are
+ *  log-linear (HDR style), values < 2^SUB_BITS ns are stored
+ *  exactly and larger values are stored with SUB_BITS - 1 bits
+ *  of precision, so memory use is fixed no matter how many
+ *  samples are recorded.
+ */
+#define STRESS_LATENCY_SUB_BITS	(6)
+#define STRESS_LATENCY_SUB_HALF	(1U << (STRESS_LATENCY_SUB_BITS - 1))
+#define STRESS_LATENCY_MAX_BITS	(40)	/* ~1099 seconds max */
+#define STRESS_LATENCY_BUCKETS	\
+	((STRESS_LATENCY_MAX_BITS - STRESS_LATENCY_SUB_BITS + 2) * STRESS_LATENCY_SUB_HALF)
+
+typedef struct stress_latency {
+	uint64_t last_ns;		/* time of previous bogo op, 0 = none */
+	uint64_t interval_ns;		/* open-loop op interval, 0 = closed loop */
+	uint64_t next_ns;		/* intended start time of next bogo op */
+	uint64_t count;			/* number of samples */
+	uint64_t sum_ns;		/* sum of samples */
+	uint64_t min_ns;		/* minimum sample */
+	uint64_t max_ns;		/* maximum sample */
+	uint64_t bucket[STRESS_LATENCY_BUCKETS];	/* histogram */
+	uint8_t lock;			/* set while a sample is recorded */
+} stress_latency_t;
+
 /* settings for storing opt arg parsed data */
 typedef struct stress_setting {
 	struct stress_setting *next;	/* next setting in list */
@@ -1033,6 +1071,9 @@ typedef struct {
 typedef struct {
 	uint64_t *counter;		/* stressor counter */
 	bool *counter_ready;		/* counter can be read */
+	uint64_t *counter_flushes;	/* batched counter flushes */
+	uint64_t *counter_updates;	/* shared counter updates */
+	stress_latency_t *latency;	/* latency histogram, NULL = disabled */
 	const char *name;		/* stressor name */
 	uint64_t max_ops;		/* max number of bogo ops */
 	const uint32_t instance;	/* stressor instance # */
@@ -1285,6 +1326,21 @@ extern void pr_err(const char *fmt, ...)  FORMAT(printf, 1, 2);
 extern void pr_fail(const char *fmt, ...) FORMAT(printf, 1, 2);
 extern void pr_tidy(const char *fmt, ...) FORMAT(printf, 1, 2);
 
+/* Structured YAML, JSON and CSV report output */
+extern void stress_report_open(void);
+extern void stress_report_close(FILE *yaml);
+extern void stress_report_map(FILE *yaml, const char *name);
+extern void stress_report_list(FILE *yaml, const char *name);
+extern void stress_report_item(FILE *yaml, const char *key, const char *value);
+extern void stress_report_end(FILE *yaml);
+extern void stress_report_str(FILE *yaml, const char *key,
+	const char *fmt, ...) FORMAT(printf, 3, 4);
+extern void stress_report_uint64(FILE *yaml, const char *key, const uint64_t value);
+extern void stress_report_int64(FILE *yaml, const char *key, const int64_t value);
+extern void stress_report_double(FILE *yaml, const char *key, const double value);
+extern void stress_report_double_prec(FILE *yaml, const char *key,
+	const int precision, const double value);
+
 extern void pr_lock(bool *locked);
 extern void pr_unlock(bool *locked);
 extern void pr_inf_lock(bool *locked, const char *fmt, ...)  FORMAT(printf, 2, 3);
@@ -1832,6 +1888,9 @@ static inline void ALWAYS_INLINE shim_mb(void)
 	asm volatile ("" ::: "memory");
 }
 
+/* timed bogo op accounting, only used with --latency or --ops-per-sec */
+extern void stress_latency_record(stress_latency_t *latency, const uint64_t ops);
+
 /* increment the stessor bogo ops counter */
 static inline void ALWAYS_INLINE inc_counter(const stress_args_t *args)
 {
@@ -1841,6 +1900,9 @@ static inline void ALWAYS_INLINE inc_counter(const stress_args_t *args)
 	shim_mb();
 	*args->counter_ready = true;
 	shim_mb();
+	(*(args->counter_updates))++;
+	if (UNLIKELY(args->latency != NULL))
+		stress_latency_record(args->latency, 1);
 }
 
 static inline uint64_t ALWAYS_INLINE get_counter(const stress_args_t *args)
@@ -1856,6 +1918,7 @@ static inline void ALWAYS_INLINE set_counter(const stress_args_t *args, const ui
 	shim_mb();
 	*args->counter_ready = true;
 	shim_mb();
+	(*(args->counter_updates))++;
 }
 
 static inline void ALWAYS_INLINE add_counter(const stress_args_t *args, const uint64_t inc)
@@ -1866,6 +1929,40 @@ static inline void ALWAYS_INLINE add_counter(const stress_args_t *args, const ui
 	shim_mb();
 	*args->counter_ready = true;
 	shim_mb();
+	(*(args->counter_updates))++;
+	if (UNLIKELY(args->latency != NULL))
+		stress_latency_record(args->latency, inc);
+}
+
+/*
+ *  Locally batched bogo ops counter for stressors with very
+ *  cheap bogo ops where the shared counter update overhead
+ *  is significant. The ops are accumulated locally and added
+ *  to the shared counter every batch ops, the batch size is
+ *  adjusted so that flushes occur about every
+ *  STRESS_COUNTER_BATCH_USEC microseconds.
+ */
+#define STRESS_COUNTER_BATCH_MAX	(65536)	/* max ops per flush */
+#define STRESS_COUNTER_BATCH_USEC	(1000)	/* target time between flushes */
+
+typedef struct {
+	uint64_t pending;		/* ops not flushed to the counter */
+	uint64_t batch;			/* flush when pending reaches this */
+	uint64_t flushes;		/* number of flushes */
+	double flush_time;		/* time of last flush */
+} stress_counter_batch_t;
+
+extern void stress_counter_batch_init(const stress_args_t *args,
+	stress_counter_batch_t *batch);
+extern void stress_counter_batch_flush(const stress_args_t *args,
+	stress_counter_batch_t *batch);
+
+/* increment the locally batched bogo ops counter */
+static inline void ALWAYS_INLINE inc_counter_batch(const stress_args_t *args,
+	stress_counter_batch_t *batch)
+{
+	if (UNLIKELY(++batch->pending >= batch->batch))
+		stress_counter_batch_flush(args, batch);
 }
 
 /* pthread porting shims, spinlock or fallback to mutex */
@@ -2157,16 +2254,32 @@ typedef struct {
 #define STRESS_PERF_INVALID	(~0ULL)
 #define STRESS_PERF_MAX		(128)
 
+#define STRESS_PERF_SAMPLE_TOP	(32)
+
+/* per symbol perf sample count */
+typedef struct {
+	uint32_t sym;			/* symbol table index */
+	uint32_t count;			/* number of samples */
+} stress_perf_sample_t;
+
 /* per perf counter info */
 typedef struct {
 	uint64_t counter;		/* perf counter */
+	uint64_t time_enabled;		/* time counter group was enabled */
+	uint64_t time_running;		/* time counter group was on the PMU */
 	int	 fd;			/* perf per counter fd */
+	int	 leader;		/* index of the group leader counter */
 } stress_perf_stat_t;
 
 /* per stressor perf info */
 typedef struct {
 	stress_perf_stat_t	perf_stat[STRESS_PERF_MAX]; /* perf counters */
 	int			perf_opened;	/* count of opened counters */
+	stress_perf_sample_t	samples[STRESS_PERF_SAMPLE_TOP]; /* hottest symbols */
+	uint64_t		sample_total;	/* total IP samples */
+	uint64_t		sample_lost;	/* IP samples lost */
+	int			sample_fd;	/* IP sampling event fd */
+	void			*sample_buf;	/* IP sampling ring buffer */
 } stress_perf_t;
 #endif
 
@@ -2192,21 +2305,29 @@ typedef struct {
 } stress_tz_t;
 #endif
 
-/* Per stressor statistics and accounting info */
-typedef struct {
+/*
+ *  Per stressor statistics and accounting info, cache line
+ *  aligned so that instances don't false share their counters.
+ *  The optional perf and thermal zone data is in separate
+ *  mappings that only exist when enabled.
+ */
+typedef struct ALIGN64 {
 	uint64_t counter;		/* number of bogo ops */
 	bool counter_ready;		/* counter can be read */
+	bool run_ok;			/* true if stressor exited OK */
+	uint64_t counter_flushes;	/* batched counter flushes, 0 = unbatched */
+	uint64_t counter_updates;	/* shared counter updates */
 	struct tms tms;			/* run time stats of process */
 	double start;			/* wall clock start time */
 	double finish;			/* wall clock stop time */
+	stress_checksum_t *checksum;	/* pointer to checksum data */
+	stress_latency_t *latency;	/* latency histogram, NULL = disabled */
 #if defined(STRESS_PERF_STATS)
-	stress_perf_t sp;		/* perf counters */
+	stress_perf_t *sp;		/* perf counters, NULL = disabled */
 #endif
 #if defined(STRESS_THERMAL_ZONES)
-	stress_tz_t tz;			/* thermal zones */
+	stress_tz_t *tz;		/* thermal zones, NULL = disabled */
 #endif
-	bool run_ok;			/* true if stressor exited OK */
-	stress_checksum_t *checksum;	/* pointer to checksum data */
 } stress_stats_t;
 
 #define	STRESS_WARN_HASH_MAX		(128)
@@ -2235,10 +2356,6 @@ typedef struct {
 		uint8_t	 val8;
 		uint8_t	 padding2;			/* more padding */
 	} atomic;					/* Shared atomic temp vars */
-	struct {
-		uint32_t futex[STRESS_PROCS_MAX];	/* Shared futexes */
-		uint64_t timeout[STRESS_PROCS_MAX];	/* Shared futex timeouts */
-	} futex;
 	struct {
 		key_t key_id;				/* System V semaphore key id */
 		int sem_id;				/* System V semaphore id */
@@ -2261,6 +2378,21 @@ typedef struct {
 	uint8_t  str_shared[STR_SHARED_SIZE];		/* str copying buffer */
 	stress_checksum_t *checksums;			/* per stressor counter checksum */
 	size_t	checksums_length;			/* size of checksums mapping */
+	stress_latency_t *latencies;			/* per stressor latency histograms */
+	size_t	latencies_length;			/* size of latencies mapping */
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t *perfs;				/* per stressor perf counters */
+	size_t	perfs_length;				/* size of perfs mapping */
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_t *tzs;				/* per stressor thermal zones */
+	size_t	tzs_length;				/* size of tzs mapping */
+#endif
+	struct {
+		uint32_t released;			/* futex, non-zero when released */
+		uint32_t waiting;			/* instances that reached the barrier */
+		double time;				/* time the barrier was released */
+	} start_barrier;				/* synchronized start of instances */
 	stress_stats_t stats[0];			/* Shared statistics */
 } stress_shared_t;
 
@@ -2644,6 +2776,14 @@ typedef enum {
 	OPT_cap,
 	OPT_cap_ops,
 
+	OPT_cgroup,
+	OPT_cgroup_cpu_max,
+	OPT_cgroup_cpuset,
+	OPT_cgroup_io_max,
+	OPT_cgroup_memory_high,
+	OPT_cgroup_memory_max,
+	OPT_cgroup_per_instance,
+
 	OPT_chattr,
 	OPT_chattr_ops,
 
@@ -2670,6 +2810,9 @@ typedef enum {
 	OPT_close,
 	OPT_close_ops,
 
+	OPT_compare,
+	OPT_compare_threshold,
+
 	OPT_context,
 	OPT_context_ops,
 
@@ -2677,6 +2820,8 @@ typedef enum {
 	OPT_copy_file_ops,
 	OPT_copy_file_bytes,
 
+	OPT_counter_overhead,
+
 	OPT_cpu_ops,
 	OPT_cpu_method,
 	OPT_cpu_load_slice,
@@ -2688,6 +2833,8 @@ typedef enum {
 	OPT_crypt,
 	OPT_crypt_ops,
 
+	OPT_csv,
+
 	OPT_cyclic,
 	OPT_cyclic_ops,
 	OPT_cyclic_method,
@@ -2737,6 +2884,9 @@ typedef enum {
 	OPT_efivar,
 	OPT_efivar_ops,
 
+	OPT_energy,
+	OPT_energy_root,
+
 	OPT_enosys,
 	OPT_enosys_ops,
 
@@ -2857,6 +3007,8 @@ typedef enum {
 	OPT_inotify,
 	OPT_inotify_ops,
 
+	OPT_interval,
+
 	OPT_iomix,
 	OPT_iomix_bytes,
 	OPT_iomix_ops,
@@ -2885,6 +3037,8 @@ typedef enum {
 	OPT_itimer_freq,
 	OPT_itimer_rand,
 
+	OPT_json,
+
 	OPT_judy,
 	OPT_judy_ops,
 	OPT_judy_size,
@@ -2892,6 +3046,8 @@ typedef enum {
 	OPT_kcmp,
 	OPT_kcmp_ops,
 
+	OPT_kernel_stats,
+
 	OPT_key,
 	OPT_key_ops,
 
@@ -2901,6 +3057,8 @@ typedef enum {
 	OPT_klog,
 	OPT_klog_ops,
 
+	OPT_latency,
+
 	OPT_lease,
 	OPT_lease_ops,
 	OPT_lease_breakers,
@@ -2991,6 +3149,7 @@ typedef enum {
 	OPT_mergesort_integers,
 
 	OPT_metrics_brief,
+	OPT_metrics_export,
 
 	OPT_mincore,
 	OPT_mincore_ops,
@@ -3085,6 +3244,9 @@ typedef enum {
 	OPT_opcode_ops,
 	OPT_opcode_method,
 
+	OPT_ops_per_sec,
+	OPT_ops_per_sec_total,
+
 	OPT_open_ops,
 	OPT_open_fd,
 
@@ -3092,6 +3254,8 @@ typedef enum {
 	OPT_pathological,
 
 	OPT_perf_stats,
+	OPT_perf_events,
+	OPT_perf_sample,
 
 	OPT_personality,
 	OPT_personality_ops,
@@ -3099,6 +3263,8 @@ typedef enum {
 	OPT_pidfd,
 	OPT_pidfd_ops,
 
+	OPT_pin,
+
 	OPT_pipe_ops,
 	OPT_pipe_size,
 	OPT_pipe_data_size,
@@ -3118,6 +3284,8 @@ typedef enum {
 	OPT_procfs,
 	OPT_procfs_ops,
 
+	OPT_psi,
+
 	OPT_pthread,
 	OPT_pthread_ops,
 	OPT_pthread_max,
@@ -3169,11 +3337,18 @@ typedef enum {
 	OPT_reboot,
 	OPT_reboot_ops,
 
+	OPT_record,
+	OPT_record_extra,
+	OPT_record_period,
+
 	OPT_remap,
 	OPT_remap_ops,
 
 	OPT_rename_ops,
 
+	OPT_repeat,
+	OPT_replay_report,
+
 	OPT_resources,
 	OPT_resources_ops,
 
@@ -3191,6 +3366,8 @@ typedef enum {
 	OPT_rtc,
 	OPT_rtc_ops,
 
+	OPT_scale_sweep,
+
 	OPT_sched,
 	OPT_sched_prio,
 
@@ -3346,6 +3523,9 @@ typedef enum {
 	OPT_stackmmap,
 	OPT_stackmmap_ops,
 
+	OPT_stall_detect,
+	OPT_stall_kill,
+
 	OPT_str,
 	OPT_str_ops,
 	OPT_str_method,
@@ -3501,6 +3681,8 @@ typedef enum {
 	OPT_wait,
 	OPT_wait_ops,
 
+	OPT_warmup,
+
 	OPT_watchdog,
 	OPT_watchdog_ops,
 
@@ -3543,6 +3725,53 @@ typedef struct {
 	const char *name;		/* name of stress test */
 } stress_t;
 
+/* Staged load profile stage types */
+typedef enum {
+	STRESS_STAGE_RAMP,		/* ramp instances from one level to another */
+	STRESS_STAGE_HOLD,		/* hold current number of instances */
+	STRESS_STAGE_STEP,		/* step to a new number of instances */
+	STRESS_STAGE_SPIKE,		/* step up, then return to previous level */
+	STRESS_STAGE_DRAIN,		/* ramp down to zero instances */
+} stress_stage_type_t;
+
+/* Staged load profile stage and its metrics */
+typedef struct {
+	stress_stage_type_t type;	/* type of stage */
+	int32_t from;			/* instances at start of stage */
+	int32_t to;			/* instances at end of stage */
+	double duration;		/* stage duration in seconds */
+	bool done;			/* true if stage metrics are valid */
+	double start;			/* start time since start of run */
+	double run_time;		/* actual run time of stage */
+	uint64_t ops;			/* bogo ops done in stage */
+	stress_latency_t *latency;	/* latency of ops done in stage */
+} stress_stage_t;
+
+/* Staged load profile of a stressor */
+typedef struct {
+	stress_stage_t *stage;		/* array of stages */
+	size_t num;			/* number of stages */
+	size_t current;			/* index of current stage */
+	int32_t level;			/* instances after last parsed stage */
+	int32_t slots;			/* instance slots required */
+	int32_t oldest;			/* oldest instance not yet stopped */
+	double time_start;		/* start time of the run */
+	double stage_start;		/* start time of current stage */
+	uint64_t ops_start;		/* bogo ops at start of current stage */
+	stress_latency_t *latency;	/* latency at start of current stage */
+} stress_stages_t;
+
+/* Throughput statistics of repeated runs */
+typedef struct {
+	uint32_t n;			/* number of measured runs */
+	double mean;			/* mean bogo ops per second */
+	double stddev;			/* sample standard deviation */
+	double min;			/* minimum bogo ops per second */
+	double max;			/* maximum bogo ops per second */
+	double cv;			/* coefficient of variation, % */
+	double ci95;			/* 95% confidence interval half width */
+} stress_repeat_stats_t;
+
 /* Per stressor information */
 typedef struct stress_stressor_info {
 	struct stress_stressor_info *next;	/* next proc info struct in list */
@@ -3553,8 +3782,27 @@ typedef struct stress_stressor_info {
 	int32_t started_instances;	/* count of started instances */
 	int32_t num_instances;		/* number of instances per stressor */
 	uint64_t bogo_ops;		/* number of bogo ops */
+	stress_stages_t *stages;	/* staged load profile, NULL = none */
 } stress_stressor_t;
 
+/* A system wide measurement charged to a stressor, over all of its runs */
+typedef struct {
+	const stress_stressor_t *ss;	/* stressor */
+	double duration;		/* wall clock run time */
+	uint64_t ops;			/* bogo ops */
+	uint32_t shared;		/* max stressors run at the same time */
+	void *data;			/* measurement of the stressor */
+} stress_result_t;
+
+/* The per stressor results of a system wide measurement */
+typedef struct {
+	const char *name;		/* measurement name, e.g. psi */
+	const char *what;		/* what is measured, e.g. stalls */
+	size_t data_size;		/* size of the measurement data */
+	stress_result_t *results;	/* results of each stressor */
+	size_t num;			/* number of results */
+} stress_results_t;
+
 /* Pointer to current running stressor proc info */
 extern stress_stressor_t *g_stressor_current;
 
@@ -3628,6 +3876,19 @@ static inline bool HOT OPTIMIZE3 __keep_stressing(const stress_args_t *args)
 
 #define keep_stressing()	__keep_stressing(args)
 
+/*
+ *  keep_stressing_batch()
+ *      returns true if we can keep on running a stressor
+ *	that uses a locally batched bogo ops counter
+ */
+static inline bool HOT OPTIMIZE3 keep_stressing_batch(const stress_args_t *args,
+	const stress_counter_batch_t *batch)
+{
+	return (LIKELY(g_keep_stressing_flag) &&
+		LIKELY(!args->max_ops ||
+		       ((get_counter(args) + batch->pending) < args->max_ops)));
+}
+
 
 /*
  *  stressor option value handling
@@ -3638,6 +3899,7 @@ extern int stress_set_setting_global(const char *name, const stress_type_id_t ty
 	const void *value);
 extern bool stress_get_setting(const char *name, void *value);
 extern void stress_free_settings(void);
+extern void stress_index_settings(void);
 
 /*
  *  externs to force gcc to stash computed values and hence
@@ -3794,7 +4056,12 @@ extern int stress_perf_close(stress_perf_t *sp);
 extern bool stress_perf_stat_succeeded(const stress_perf_t *sp);
 extern void stress_perf_stat_dump(FILE *yaml, stress_stressor_t *procs_head,
 	const double duration);
+extern bool stress_perf_stat_total(const stress_stressor_t *ss, const size_t p,
+	char *label, const size_t label_len, uint64_t *total);
 extern void stress_perf_init(void);
+extern int stress_perf_set_events(const char *arg);
+extern void stress_perf_sample_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_perf_sample_free(void);
 #endif
 
 /* CPU helpers */
@@ -3844,6 +4111,7 @@ extern void stress_check_range(const char *const opt, const uint64_t val,
 extern void stress_check_range_bytes(const char *const opt,
 	const uint64_t val, const uint64_t lo, const uint64_t hi);
 extern WARN_UNUSED int stress_set_cpu_affinity(const char *arg);
+extern WARN_UNUSED int stress_set_pin(const char *arg);
 extern WARN_UNUSED uint32_t stress_get_uint32(const char *const str);
 extern WARN_UNUSED int32_t  stress_get_int32(const char *const str);
 extern WARN_UNUSED int32_t  stress_get_opt_sched(const char *const str);
@@ -3990,10 +4258,149 @@ extern int stress_mincore_touch_pages(void *buf, const size_t buf_len);
 extern int stress_mincore_touch_pages_interruptible(void *buf,
 	const size_t buf_len);
 
+/* Bogo ops counter overhead */
+extern void stress_counter_overhead_calibrate(void);
+extern void stress_counter_overhead_dump(FILE *yaml,
+	stress_stressor_t *stressors_list);
+
+/* cgroup v2 isolation */
+extern int stress_set_cgroup_cpu_max(const char *arg);
+extern int stress_set_cgroup_io_max(const char *arg);
+extern int stress_cgroup_init(void);
+extern int stress_cgroup_create(stress_stressor_t *stressors_list);
+extern int stress_cgroup_join(const stress_stressor_t *ss, const int32_t instance);
+extern void stress_cgroup_collect(stress_stressor_t *stressors_list);
+extern void stress_cgroup_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_cgroup_free(void);
+
+/* Per stressor results of system wide measurements */
+extern stress_result_t *stress_results_find(const stress_results_t *results,
+	const stress_stressor_t *ss);
+extern bool stress_results_charge(stress_results_t *results,
+	stress_stressor_t *stressors_list, const double duration);
+extern void stress_results_report(FILE *yaml, const stress_result_t *result);
+extern void stress_results_shared(const stress_results_t *results);
+extern void stress_results_free(stress_results_t *results,
+	void (*free_data)(void *data));
+
+/* Energy metrics */
+extern int stress_energy_init(void);
+extern bool stress_energy_active(void);
+extern void stress_energy_start(void);
+extern void stress_energy_tick(const double now);
+extern void stress_energy_stop(stress_stressor_t *stressors_list);
+extern void stress_energy_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_energy_free(void);
+
+/* Kernel activity statistics */
+extern void stress_kstat_start(void);
+extern void stress_kstat_stop(stress_stressor_t *stressors_list);
+extern void stress_kstat_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_kstat_free(void);
+
+/* Pressure stall information */
+extern int stress_psi_init(void);
+extern bool stress_psi_active(void);
+extern void stress_psi_start(void);
+extern void stress_psi_tick(const double now);
+extern void stress_psi_stop(stress_stressor_t *stressors_list);
+extern void stress_psi_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_psi_free(void);
+
+/* Stalled stressor instance detection */
+extern int stress_set_stall_detect(const char *opt);
+extern void stress_stall_init(void);
+extern bool stress_stall_active(void);
+extern void stress_stall_start(stress_stressor_t *stressors_list);
+extern void stress_stall_tick(const double now);
+extern void stress_stall_stop(void);
+extern void stress_stall_dump(FILE *yaml);
+extern void stress_stall_free(void);
+
+/* Repeated runs */
+extern double stress_repeat_t_95(const uint32_t df);
+extern double stress_repeat_rate(const stress_stressor_t *ss);
+extern void stress_repeat_record(stress_stressor_t *stressors_list,
+	const uint32_t run, const bool warmup);
+extern bool stress_repeat_stats(const stress_stressor_t *ss,
+	stress_repeat_stats_t *stats);
+extern void stress_repeat_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_repeat_free(void);
+
+/* Live metrics export */
+extern bool stress_export_start(stress_stressor_t *all_list,
+	stress_stressor_t *stressors_list, const double time_start);
+extern void stress_export_tick(stress_stressor_t *all_list, const double now);
+extern void stress_export_stop(stress_stressor_t *stressors_list);
+extern void stress_export_finish(stress_stressor_t *all_list);
+
+/* Binary time series recording */
+extern int stress_set_record_extra(const char *arg);
+extern int stress_record_init(stress_stressor_t *stressors_list);
+extern bool stress_record_active(void);
+extern double stress_record_next(void);
+extern void stress_record_tick(const double now);
+extern void stress_record_close(void);
+extern int stress_record_replay(const char *filename);
+
+/* Baseline comparison */
+extern int stress_set_compare_threshold(const char *arg);
+extern int stress_compare_load(const char *filename);
+extern bool stress_compare_dump(FILE *yaml, stress_stressor_t *stressors_list);
+extern void stress_compare_free(void);
+
+/* Scale sweeps */
+extern int stress_scale_sweep_set(const char *opt);
+extern size_t stress_scale_sweep_points(const int32_t **points);
+extern void stress_scale_sweep_record(stress_stressor_t *stressors_list,
+	const int32_t instances);
+extern void stress_scale_sweep_dump(FILE *yaml,
+	stress_stressor_t *stressors_list);
+extern void stress_scale_sweep_free(void);
+
+/* Staged load profiles */
+extern int stress_stage_parse(const char *jobfile, const int argc,
+	char **argv);
+extern void stress_stage_free(stress_stages_t *stages);
+extern void stress_stage_start(stress_stressor_t *ss, const double now);
+extern int32_t stress_stage_instances(stress_stressor_t *ss,
+	const double now);
+extern void stress_stage_finish(stress_stressor_t *ss, const double now);
+extern bool stress_stage_pending(const stress_stressor_t *stressors_list);
+extern void stress_stage_dump(FILE *yaml, stress_stressor_t *stressors_list);
+
+/* Interval sampling */
+extern int stress_interval_start(stress_stressor_t *stressors_list,
+	const double time_start, const double period);
+extern double stress_interval_next(void);
+extern void stress_interval_tick(stress_stressor_t *stressors_list,
+	const double now);
+extern void stress_interval_dump(FILE *yaml,
+	stress_stressor_t *stressors_list);
+extern void stress_interval_free(void);
+
+/* Bogo-op latency histograms */
+extern int stress_latency_map(const size_t num_procs);
+extern void stress_latency_unmap(void);
+extern void stress_latency_init(stress_latency_t *latency);
+extern void stress_latency_set_rate(stress_latency_t *latency,
+	const double ops_per_sec);
+extern void stress_latency_merge(stress_latency_t *dst,
+	const stress_latency_t *src);
+extern void stress_latency_sub(stress_latency_t *dst,
+	const stress_latency_t *src);
+extern WARN_UNUSED uint64_t stress_latency_percentile(
+	const stress_latency_t *latency, const double percentile);
+
 /* Mounts */
 extern void stress_mount_free(char *mnts[], const int n);
 extern WARN_UNUSED int stress_mount_get(char *mnts[], const int max);
 
+/* Topology aware instance placement */
+extern int stress_pin_init(void);
+extern void stress_pin_instance(const char *name, const uint32_t instance);
+extern void stress_pin_free(void);
+
 /* Thermal Zones */
 #if defined(STRESS_THERMAL_ZONES)
 extern int stress_tz_init(stress_tz_info_t **tz_info_list);
@@ -4001,6 +4408,13 @@ extern void stress_tz_free(stress_tz_info_t **tz_info_list);
 extern int stress_tz_get_temperatures(stress_tz_info_t **tz_info_list,
 	stress_tz_t *tz);
 extern void stress_tz_dump(FILE *yaml, stress_stressor_t *procs_head);
+extern void stress_tz_key(const stress_tz_info_t *tz_info, char *key,
+	const size_t len);
+extern int stress_tz_sample_start(void);
+extern bool stress_tz_sample_active(void);
+extern void stress_tz_sample_tick(const double now);
+extern void stress_tz_sample_dump(FILE *yaml);
+extern void stress_tz_sample_free(void);
 #endif
 
 /* Network helpers */
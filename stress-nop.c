@@ -52,6 +52,9 @@ static const stress_help_t help[] = {
  */
 static int stress_nop(const stress_args_t *args)
 {
+	stress_counter_batch_t batch;
+
+	stress_counter_batch_init(args, &batch);
 	do {
 		register int i = 256;
 
@@ -61,8 +64,9 @@ static int stress_nop(const stress_args_t *args)
 			NOP64
 			NOP64
 		}
-		inc_counter(args);
-	} while (keep_stressing());
+		inc_counter_batch(args, &batch);
+	} while (keep_stressing_batch(args, &batch));
+	stress_counter_batch_flush(args, &batch);
 
 	return EXIT_SUCCESS;
 }